@@ -10,20 +10,23 @@ namespace Learn{
     protected:
         std::unordered_map<int, int> UniformLocations_;
         virtual bool bindUniform(Uniform &uniform) {
-            int hash = uniform.getHash();
-            int location = -1;
-            if (UniformLocations_.find(hash) != UniformLocations_.end()) {
-                location = UniformLocations_[hash];
-            } else {
-                location = uniform.getLocation(*this);
-                UniformLocations_[hash] = location;
-            }
-
+            int location = getLocation(uniform);
             if(location < 0) return false;
             uniform.bindProgram(*this, location);
             return true;
         }
     public: 
+        int getLocation(Uniform &uniform) {
+            int hash = uniform.getHash();
+            auto it = UniformLocations_.find(hash);
+            if (it != UniformLocations_.end()) {
+                return it->second;
+            }
+            int location = uniform.getLocation(*this);
+            UniformLocations_[hash] = location;
+            return location;
+        }
+
         virtual int getId() const = 0;
         virtual void addDefine(const std::string &define) = 0;
         virtual void addDefines(const std::set<std::string> &defines){
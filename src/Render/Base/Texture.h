@@ -97,6 +97,7 @@ namespace Learn
         uint32_t usage = TextureUsage_Sampler;
         bool useMipmaps = false;
         bool multiSample = false;
+        int sampleCount = 4; // samples per pixel when multiSample is set
         std::string tag;
     };
     
@@ -52,7 +52,7 @@ namespace Learn
         return src + dst;
     }
 
-    glm::vec4 calcBlendColor(glm::vec4 &src, glm::vec4 &dst, const BlendParameters &params)
+    inline glm::vec4 calcBlendColor(glm::vec4 &src, glm::vec4 &dst, const BlendParameters &params)
     {
         auto srcRgb = glm::vec3(src);
         auto dstRgb = glm::vec3(dst);
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Utils/Arena.h"
+#include "Utils/ThreadPool.h"
+#include "Render/Base/Renderer.h"
+#include "TextureSoft.h"
+
+namespace Learn
+{
+    enum CommandTypeSoft
+    {
+        Command_BeginRenderPass,
+        Command_SetViewPort,
+        Command_SetVertexArrayObject,
+        Command_SetShaderProgram,
+        Command_SetShaderResources,
+        Command_SetPipelineStates,
+        Command_Draw,
+        Command_EndRenderPass,
+        Command_Present,
+    };
+
+    // one uniform of a recorded setShaderResources, block data is copied when recorded
+    struct UniformBindingSoft
+    {
+        int location = -1;
+        const uint8_t *data = nullptr;
+        size_t size = 0;
+        int samplerId = -1; // sampler uniform id, -1 for blocks
+        int textureIdx = -1; // index into CommandListSoft::textures
+    };
+
+    struct CommandSoft
+    {
+        CommandTypeSoft type = Command_Draw;
+        std::shared_ptr<FrameBuffer> frameBuffer; // attachments snapshot, set on draws when they changed inside the pass
+        std::shared_ptr<VertexArrayObject> vao;
+        std::shared_ptr<ShaderProgram> program;
+        std::shared_ptr<PipelineStates> states;
+        std::shared_ptr<ImageBufferSoft<RGBA>> color;
+        ClearStates clearStates{};
+        glm::ivec4 viewport{0};
+        UniformBindingSoft *bindings = nullptr;
+        int bindingCnt = 0;
+    };
+
+    // recorded commands and the memory they reference, recycled after execution
+    class CommandListSoft
+    {
+    public:
+        std::vector<CommandSoft> commands;
+        std::vector<std::shared_ptr<Texture>> textures;
+        Arena arena{1 << 16};
+        TaskLane lane = TaskLane_Frame;
+
+        inline bool empty() const
+        {
+            return commands.empty();
+        }
+
+        inline CommandSoft &add(CommandTypeSoft type)
+        {
+            commands.emplace_back();
+            commands.back().type = type;
+            return commands.back();
+        }
+
+        void reset()
+        {
+            commands.clear();
+            textures.clear();
+            arena.reset();
+            lane = TaskLane_Frame;
+        }
+    };
+}
@@ -4,7 +4,7 @@
 
 namespace Learn
 {
-    bool DepthTest(float &a, float &b, DepthFunction func)
+    inline bool DepthTest(float &a, float &b, DepthFunction func)
     {
         switch (func)
         {
@@ -27,4 +27,60 @@ namespace Learn
         }
         return a < b ;
     }
-}
\ No newline at end of file
+
+#ifdef SOFTGL_SIMD_OPT
+    // DepthTest of 8 lanes, returns an all bits set lane for passed ones
+    inline __m256 DepthTestSIMD(__m256 a, __m256 b, DepthFunction func)
+    {
+        __m256 epsilon = _mm256_set1_ps(std::numeric_limits<float>::epsilon());
+        __m256 diff = _mm256_andnot_ps(_mm256_set1_ps(-0.f), _mm256_sub_ps(a, b));
+        switch (func)
+        {
+        case ALWAYS:
+            return _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        case EQUAL:
+            return _mm256_cmp_ps(diff, epsilon, _CMP_LE_OQ);
+        case GEQUAL:
+            return _mm256_cmp_ps(a, b, _CMP_GE_OQ);
+        case GREATER:
+            return _mm256_cmp_ps(a, b, _CMP_GT_OQ);
+        case LEQUAL:
+            return _mm256_cmp_ps(a, b, _CMP_LE_OQ);
+        case LESS:
+            return _mm256_cmp_ps(a, b, _CMP_LT_OQ);
+        case NEVER:
+            return _mm256_setzero_ps();
+        case NOTEQUAL:
+            return _mm256_cmp_ps(diff, epsilon, _CMP_GT_OQ);
+        }
+        return _mm256_cmp_ps(a, b, _CMP_LT_OQ);
+    }
+
+    // DepthTest of 4 lanes
+    inline __m128 DepthTestSIMD(__m128 a, __m128 b, DepthFunction func)
+    {
+        __m128 epsilon = _mm_set1_ps(std::numeric_limits<float>::epsilon());
+        __m128 diff = _mm_andnot_ps(_mm_set1_ps(-0.f), _mm_sub_ps(a, b));
+        switch (func)
+        {
+        case ALWAYS:
+            return _mm_castsi128_ps(_mm_set1_epi32(-1));
+        case EQUAL:
+            return _mm_cmp_ps(diff, epsilon, _CMP_LE_OQ);
+        case GEQUAL:
+            return _mm_cmp_ps(a, b, _CMP_GE_OQ);
+        case GREATER:
+            return _mm_cmp_ps(a, b, _CMP_GT_OQ);
+        case LEQUAL:
+            return _mm_cmp_ps(a, b, _CMP_LE_OQ);
+        case LESS:
+            return _mm_cmp_ps(a, b, _CMP_LT_OQ);
+        case NEVER:
+            return _mm_setzero_ps();
+        case NOTEQUAL:
+            return _mm_cmp_ps(diff, epsilon, _CMP_GT_OQ);
+        }
+        return _mm_cmp_ps(a, b, _CMP_LT_OQ);
+    }
+#endif
+}
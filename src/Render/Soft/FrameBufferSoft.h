@@ -32,7 +32,7 @@ namespace Learn
                 return nullptr;
             }
             auto *colorTex = dynamic_cast<TextureSoft<RGBA> *>(colorAttachment_.tex.get());
-            return colorTex->getImage(colorAttachment_.layer).getBuffer(colorAttachment_.level);
+            return colorTex->getImage(colorAttachment_.layer).getAttachmentBuffer(colorAttachment_.level);
         };
 
         std::shared_ptr<ImageBufferSoft<float>> getDepthBuffer() const
@@ -42,7 +42,7 @@ namespace Learn
                 return nullptr;
             }
             auto *depthTex = dynamic_cast<TextureSoft<float> *>(depthAttachment_.tex.get());
-            return depthTex->getImage(depthAttachment_.layer).getBuffer(depthAttachment_.level);
+            return depthTex->getImage(depthAttachment_.layer).getAttachmentBuffer(depthAttachment_.level);
         };
     };
 
@@ -0,0 +1,567 @@
+#pragma once
+
+#include "Render/Base/PipelineStates.h"
+#include "TextureSoft.h"
+#include "BlendSoft.h"
+#include "DepthSoft.h"
+
+namespace Learn
+{
+
+    // attachments of the current draw, depth already clamped to the viewport range by the kernel
+    struct OutputMergerContext
+    {
+        ImageBufferSoft<RGBA> *color = nullptr;
+        ImageBufferSoft<float> *depth = nullptr;
+        const BlendParameters *blendParams = nullptr;
+        float minDepth = 0.f;
+        float maxDepth = 1.f;
+        bool linear = false; // attachment rows are contiguous, required by the quad kernels
+    };
+
+    // depth test, depth write and blending of one pixel, depth has one value per sample
+    using OutputMergerFunc = void (*)(const OutputMergerContext &ctx, int x, int y, const float *depth,
+                                      uint32_t sampleMask, const glm::vec4 &color);
+
+    // the same for a 2x2 quad at even (x, y), depth and lane mask are pixel major with all samples of a pixel
+    using OutputMergerQuadFunc = void (*)(const OutputMergerContext &ctx, int x, int y, const float *depth,
+                                          uint64_t laneMask, const glm::vec4 *color);
+
+    struct OutputMergerKernels
+    {
+        OutputMergerFunc pixel = nullptr;
+        OutputMergerQuadFunc quad = nullptr;
+    };
+
+#ifdef SOFTGL_SIMD_OPT
+    // blend factor of two RGBA values in one register
+    template <BlendFactor Factor>
+    inline __m256 blendFactorSIMD(__m256 src, __m256 dst)
+    {
+        const __m256 one = _mm256_set1_ps(1.f);
+        if constexpr (Factor == BlendFactor::ZERO)
+            return _mm256_setzero_ps();
+        else if constexpr (Factor == BlendFactor::ONE)
+            return one;
+        else if constexpr (Factor == BlendFactor::SRC_COLOR)
+            return src;
+        else if constexpr (Factor == BlendFactor::ONE_MINUS_SRC_COLOR)
+            return _mm256_sub_ps(one, src);
+        else if constexpr (Factor == BlendFactor::DST_COLOR)
+            return dst;
+        else if constexpr (Factor == BlendFactor::ONE_MINUS_DST_COLOR)
+            return _mm256_sub_ps(one, dst);
+        else if constexpr (Factor == BlendFactor::SRC_ALPHA)
+            return _mm256_permute_ps(src, _MM_SHUFFLE(3, 3, 3, 3));
+        else if constexpr (Factor == BlendFactor::ONE_MINUS_SRC_ALPHA)
+            return _mm256_sub_ps(one, _mm256_permute_ps(src, _MM_SHUFFLE(3, 3, 3, 3)));
+        else if constexpr (Factor == BlendFactor::DST_ALPHA)
+            return _mm256_permute_ps(dst, _MM_SHUFFLE(3, 3, 3, 3));
+        else
+            return _mm256_sub_ps(one, _mm256_permute_ps(dst, _MM_SHUFFLE(3, 3, 3, 3)));
+    }
+#endif
+
+    // blend policies, the result is clamped to the range of the RGBA8 target
+    struct BlendDisabled
+    {
+        static constexpr bool Enabled = false;
+        static constexpr bool Vectorized = true;
+
+        static inline RGBA apply(const glm::vec4 &src, const RGBA &dst, const BlendParameters &params)
+        {
+            return RGBA(src * 255.f);
+        }
+
+#ifdef SOFTGL_SIMD_OPT
+        static inline __m256 applySIMD(__m256 src, __m256 dst)
+        {
+            return src;
+        }
+#endif
+    };
+
+    // same factor for rgb and alpha, ADD function
+    template <BlendFactor Src, BlendFactor Dst>
+    struct BlendAdd
+    {
+        static constexpr bool Enabled = true;
+        static constexpr bool Vectorized = true;
+
+        static inline RGBA apply(const glm::vec4 &src, const RGBA &dst, const BlendParameters &params)
+        {
+            glm::vec4 dstColor = glm::vec4(dst) / 255.f;
+            auto srcRgb = glm::vec3(src);
+            auto dstRgb = glm::vec3(dstColor);
+            auto rgb = srcRgb * calcBlendFactor<glm::vec3>(srcRgb, src.a, dstRgb, dstColor.a, Src) +
+                       dstRgb * calcBlendFactor<glm::vec3>(srcRgb, src.a, dstRgb, dstColor.a, Dst);
+            float alpha = src.a * calcBlendFactor<float>(src.a, src.a, dstColor.a, dstColor.a, Src) +
+                          dstColor.a * calcBlendFactor<float>(src.a, src.a, dstColor.a, dstColor.a, Dst);
+            return RGBA(glm::clamp(glm::vec4(rgb, alpha), 0.f, 1.f) * 255.f);
+        }
+
+#ifdef SOFTGL_SIMD_OPT
+        static inline __m256 applySIMD(__m256 src, __m256 dst)
+        {
+            return _mm256_add_ps(_mm256_mul_ps(src, blendFactorSIMD<Src>(src, dst)),
+                                 _mm256_mul_ps(dst, blendFactorSIMD<Dst>(src, dst)));
+        }
+#endif
+    };
+
+    struct BlendGeneric
+    {
+        static constexpr bool Enabled = true;
+        static constexpr bool Vectorized = false;
+
+        static inline RGBA apply(const glm::vec4 &src, const RGBA &dst, const BlendParameters &params)
+        {
+            glm::vec4 srcColor = src;
+            glm::vec4 dstColor = glm::vec4(dst) / 255.f;
+            return RGBA(glm::clamp(calcBlendColor(srcColor, dstColor, params), 0.f, 1.f) * 255.f);
+        }
+    };
+
+    template <bool DepthTestOn, DepthFunction Func, bool DepthWrite, typename Blend, int Samples>
+    void OutputMerger(const OutputMergerContext &ctx, int x, int y, const float *depth, uint32_t sampleMask, const glm::vec4 &color)
+    {
+        constexpr uint32_t allSamples = (1u << Samples) - 1;
+        uint32_t passMask = sampleMask;
+
+        if constexpr (DepthTestOn)
+        {
+            ImageBufferSoft<float> *depthImage = ctx.depth;
+            if (depthImage)
+            {
+                if (x >= depthImage->width || y >= depthImage->height)
+                {
+                    return;
+                }
+
+                float z[Samples];
+                for (int i = 0; i < Samples; i++)
+                {
+                    z[i] = glm::clamp(depth[i], ctx.minDepth, ctx.maxDepth);
+                }
+
+                if constexpr (Samples == 1)
+                {
+                    float *stored = depthImage->buffer->get(x, y);
+                    if (!DepthTest(z[0], *stored, Func))
+                    {
+                        return;
+                    }
+                    if constexpr (DepthWrite)
+                    {
+                        *stored = z[0];
+                    }
+                }
+                else
+                {
+                    // a uniform pixel compares every sample against its first one
+                    float *stored = depthImage->getSamples(x, y);
+                    int stride = depthImage->isUniform(x, y) ? 0 : 1;
+                    for (int i = 0; i < Samples; i++)
+                    {
+                        if (!DepthTest(z[i], stored[i * stride], Func))
+                        {
+                            passMask &= ~(1u << i);
+                        }
+                    }
+                    if (passMask == 0)
+                    {
+                        return;
+                    }
+
+                    if constexpr (DepthWrite)
+                    {
+                        bool uniform = passMask == allSamples;
+                        for (int i = 1; uniform && i < Samples; i++)
+                        {
+                            uniform = z[i] == z[0];
+                        }
+                        if (uniform)
+                        {
+                            depthImage->setUniform(x, y, z[0]);
+                        }
+                        else
+                        {
+                            depthImage->expand(x, y);
+                            for (int i = 0; i < Samples; i++)
+                            {
+                                if ((passMask >> i) & 1)
+                                {
+                                    stored[i] = z[i];
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        ImageBufferSoft<RGBA> *colorImage = ctx.color;
+        if (!colorImage || x >= colorImage->width || y >= colorImage->height)
+        {
+            return;
+        }
+
+        glm::vec4 src = glm::clamp(color, 0.f, 1.f);
+        if constexpr (Samples == 1)
+        {
+            RGBA *dst = colorImage->buffer->get(x, y);
+            *dst = Blend::apply(src, *dst, *ctx.blendParams);
+        }
+        else
+        {
+            // fully written pixels stay uniform, blending is done once against the shared sample
+            RGBA *dst = colorImage->getSamples(x, y);
+            if (passMask == allSamples && (!Blend::Enabled || colorImage->isUniform(x, y)))
+            {
+                colorImage->setUniform(x, y, Blend::apply(src, dst[0], *ctx.blendParams));
+                return;
+            }
+
+            colorImage->expand(x, y);
+            for (int i = 0; i < Samples; i++)
+            {
+                if ((passMask >> i) & 1)
+                {
+                    dst[i] = Blend::apply(src, dst[i], *ctx.blendParams);
+                }
+            }
+        }
+    }
+
+#ifdef SOFTGL_SIMD_OPT
+    // lanes of a 4 bit mask as all bits set 32 bit lanes
+    inline __m128i laneMask4(uint32_t bits)
+    {
+        const __m128i laneBits = _mm_setr_epi32(1, 2, 4, 8);
+        return _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32((int)bits), laneBits), laneBits);
+    }
+
+    // blends 4 RGBA8 destination values with source colors (two per register, already clamped) and packs the result
+    template <typename Blend>
+    inline __m128i blendPackSIMD(__m256 src01, __m256 src23, __m128i dst)
+    {
+        __m256 color01 = src01;
+        __m256 color23 = src23;
+        if constexpr (Blend::Enabled)
+        {
+            const __m256 zero = _mm256_setzero_ps();
+            const __m256 one = _mm256_set1_ps(1.f);
+            const __m256 scale = _mm256_set1_ps(255.f);
+            __m256 dst01 = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(dst)), scale);
+            __m256 dst23 = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(dst, 8))), scale);
+            color01 = _mm256_min_ps(_mm256_max_ps(Blend::applySIMD(src01, dst01), zero), one);
+            color23 = _mm256_min_ps(_mm256_max_ps(Blend::applySIMD(src23, dst23), zero), one);
+        }
+
+        // truncate like the scalar conversion, values are already in range
+        const __m256 scale = _mm256_set1_ps(255.f);
+        __m256i i01 = _mm256_cvttps_epi32(_mm256_mul_ps(color01, scale));
+        __m256i i23 = _mm256_cvttps_epi32(_mm256_mul_ps(color23, scale));
+        __m128i w01 = _mm_packus_epi32(_mm256_castsi256_si128(i01), _mm256_extracti128_si256(i01, 1));
+        __m128i w23 = _mm_packus_epi32(_mm256_castsi256_si128(i23), _mm256_extracti128_si256(i23, 1));
+        return _mm_packus_epi16(w01, w23);
+    }
+
+    inline __m128 loadColorSIMD(const glm::vec4 &color)
+    {
+        return _mm_min_ps(_mm_max_ps(_mm_loadu_ps(&color.x), _mm_setzero_ps()), _mm_set1_ps(1.f));
+    }
+
+    template <bool DepthTestOn, DepthFunction Func, bool DepthWrite, typename Blend>
+    void OutputMergerQuad1x(const OutputMergerContext &ctx, int x, int y, const float *depth, uint32_t laneMask, const glm::vec4 *color)
+    {
+        // one lane per pixel: (x, y), (x + 1, y), (x, y + 1), (x + 1, y + 1)
+        __m128 pass = _mm_castsi128_ps(laneMask4(laneMask));
+        if constexpr (DepthTestOn)
+        {
+            ImageBufferSoft<float> *depthImage = ctx.depth;
+            if (depthImage)
+            {
+                __m128 z = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(depth), _mm_set1_ps(ctx.minDepth)), _mm_set1_ps(ctx.maxDepth));
+                float *row0 = depthImage->buffer->getRawDataPtr() + (size_t)y * depthImage->width + x;
+                float *row1 = row0 + depthImage->width;
+                __m128 stored = _mm_castpd_ps(_mm_loadh_pd(_mm_load_sd((const double *)row0), (const double *)row1));
+                pass = _mm_and_ps(pass, DepthTestSIMD(z, stored, Func));
+                if constexpr (DepthWrite)
+                {
+                    _mm_maskstore_ps(row0, _mm_castps_si128(_mm_movelh_ps(pass, _mm_setzero_ps())), z);
+                    _mm_maskstore_ps(row1, _mm_castps_si128(_mm_movehl_ps(_mm_setzero_ps(), pass)), _mm_movehl_ps(z, z));
+                }
+            }
+        }
+
+        ImageBufferSoft<RGBA> *colorImage = ctx.color;
+        if (!colorImage || _mm_movemask_ps(pass) == 0)
+        {
+            return;
+        }
+
+        RGBA *row0 = colorImage->buffer->getRawDataPtr() + (size_t)y * colorImage->width + x;
+        RGBA *row1 = row0 + colorImage->width;
+        __m128i dst = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)row0), _mm_loadl_epi64((const __m128i *)row1));
+        __m256 src01 = _mm256_set_m128(loadColorSIMD(color[1]), loadColorSIMD(color[0]));
+        __m256 src23 = _mm256_set_m128(loadColorSIMD(color[3]), loadColorSIMD(color[2]));
+        __m128i packed = blendPackSIMD<Blend>(src01, src23, dst);
+
+        __m128i passBits = _mm_castps_si128(pass);
+        _mm_maskstore_epi32((int *)row0, _mm_unpacklo_epi64(passBits, _mm_setzero_si128()), packed);
+        _mm_maskstore_epi32((int *)row1, _mm_unpackhi_epi64(passBits, _mm_setzero_si128()), _mm_unpackhi_epi64(packed, packed));
+    }
+
+    template <bool DepthTestOn, DepthFunction Func, bool DepthWrite, typename Blend, int Samples>
+    void OutputMergerQuadMs(const OutputMergerContext &ctx, int x, int y, const float *depth, uint64_t laneMask, const glm::vec4 *color)
+    {
+        // 4 samples per register, uniform pixels broadcast their shared sample
+        constexpr int Chunks = Samples / 4;
+        constexpr uint32_t allSamples = (1u << Samples) - 1;
+        for (int p = 0; p < 4; p++)
+        {
+            uint32_t passMask = (uint32_t)(laneMask >> (p * Samples)) & allSamples;
+            if (passMask == 0)
+            {
+                continue;
+            }
+            int px = x + (p & 1);
+            int py = y + (p >> 1);
+            __m128i pass[Chunks];
+            for (int c = 0; c < Chunks; c++)
+            {
+                pass[c] = laneMask4(passMask >> (c * 4));
+            }
+
+            if constexpr (DepthTestOn)
+            {
+                ImageBufferSoft<float> *depthImage = ctx.depth;
+                if (depthImage)
+                {
+                    float *stored = depthImage->getSamples(px, py);
+                    bool uniform = depthImage->isUniform(px, py);
+                    __m128 z[Chunks];
+                    passMask = 0;
+                    for (int c = 0; c < Chunks; c++)
+                    {
+                        z[c] = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(depth + p * Samples + c * 4), _mm_set1_ps(ctx.minDepth)),
+                                          _mm_set1_ps(ctx.maxDepth));
+                        __m128 storedZ = uniform ? _mm_set1_ps(stored[0]) : _mm_loadu_ps(stored + c * 4);
+                        __m128 chunkPass = _mm_and_ps(_mm_castsi128_ps(pass[c]), DepthTestSIMD(z[c], storedZ, Func));
+                        pass[c] = _mm_castps_si128(chunkPass);
+                        passMask |= (uint32_t)_mm_movemask_ps(chunkPass) << (c * 4);
+                    }
+                    if (passMask == 0)
+                    {
+                        continue;
+                    }
+
+                    if constexpr (DepthWrite)
+                    {
+                        bool uniformDepth = passMask == allSamples;
+                        __m128 z0 = _mm_set1_ps(_mm_cvtss_f32(z[0]));
+                        for (int c = 0; uniformDepth && c < Chunks; c++)
+                        {
+                            uniformDepth = _mm_movemask_ps(_mm_cmpeq_ps(z[c], z0)) == 0xF;
+                        }
+                        if (uniformDepth)
+                        {
+                            depthImage->setUniform(px, py, _mm_cvtss_f32(z[0]));
+                        }
+                        else
+                        {
+                            depthImage->expand(px, py);
+                            for (int c = 0; c < Chunks; c++)
+                            {
+                                _mm_maskstore_ps(stored + c * 4, pass[c], z[c]);
+                            }
+                        }
+                    }
+                }
+            }
+
+            ImageBufferSoft<RGBA> *colorImage = ctx.color;
+            if (!colorImage)
+            {
+                continue;
+            }
+
+            RGBA *dst = colorImage->getSamples(px, py);
+            if (passMask == allSamples && (!Blend::Enabled || colorImage->isUniform(px, py)))
+            {
+                colorImage->setUniform(px, py, Blend::apply(glm::clamp(color[p], 0.f, 1.f), dst[0], *ctx.blendParams));
+                continue;
+            }
+
+            colorImage->expand(px, py);
+            __m128 src = loadColorSIMD(color[p]);
+            __m256 src2 = _mm256_set_m128(src, src);
+            for (int c = 0; c < Chunks; c++)
+            {
+                __m128i packed = blendPackSIMD<Blend>(src2, src2, _mm_loadu_si128((const __m128i *)(dst + c * 4)));
+                _mm_maskstore_epi32((int *)(dst + c * 4), pass[c], packed);
+            }
+        }
+    }
+#endif
+
+    template <bool DepthTestOn, DepthFunction Func, bool DepthWrite, typename Blend, int Samples>
+    void OutputMergerQuad(const OutputMergerContext &ctx, int x, int y, const float *depth, uint64_t laneMask, const glm::vec4 *color)
+    {
+#ifdef SOFTGL_SIMD_OPT
+        if constexpr (Blend::Vectorized && (Samples == 1 || Samples % 4 == 0))
+        {
+            bool inside = ctx.linear &&
+                          (!ctx.color || (x + 1 < ctx.color->width && y + 1 < ctx.color->height)) &&
+                          (!ctx.depth || (x + 1 < ctx.depth->width && y + 1 < ctx.depth->height));
+            if (inside)
+            {
+                if constexpr (Samples == 1)
+                {
+                    OutputMergerQuad1x<DepthTestOn, Func, DepthWrite, Blend>(ctx, x, y, depth, (uint32_t)laneMask, color);
+                }
+                else
+                {
+                    OutputMergerQuadMs<DepthTestOn, Func, DepthWrite, Blend, Samples>(ctx, x, y, depth, laneMask, color);
+                }
+                return;
+            }
+        }
+#endif
+        // pixel by pixel at the target border, or when the blend setup has no vector form
+        constexpr uint32_t allSamples = (1u << Samples) - 1;
+        for (int p = 0; p < 4; p++)
+        {
+            uint32_t sampleMask = (uint32_t)(laneMask >> (p * Samples)) & allSamples;
+            if (sampleMask)
+            {
+                OutputMerger<DepthTestOn, Func, DepthWrite, Blend, Samples>(ctx, x + (p & 1), y + (p >> 1), depth + p * Samples, sampleMask, color[p]);
+            }
+        }
+    }
+
+    template <bool DepthTestOn, DepthFunction Func, bool DepthWrite, typename Blend, int Samples>
+    OutputMergerKernels outputMergerKernels()
+    {
+        OutputMergerKernels kernels;
+        kernels.pixel = &OutputMerger<DepthTestOn, Func, DepthWrite, Blend, Samples>;
+        kernels.quad = &OutputMergerQuad<DepthTestOn, Func, DepthWrite, Blend, Samples>;
+        return kernels;
+    }
+
+    template <bool DepthTestOn, DepthFunction Func, bool DepthWrite, typename Blend>
+    OutputMergerKernels selectOutputMerger(int sampleCnt)
+    {
+        switch (sampleCnt)
+        {
+        case 2:
+            return outputMergerKernels<DepthTestOn, Func, DepthWrite, Blend, 2>();
+        case 4:
+            return outputMergerKernels<DepthTestOn, Func, DepthWrite, Blend, 4>();
+        case 8:
+            return outputMergerKernels<DepthTestOn, Func, DepthWrite, Blend, 8>();
+        case 16:
+            return outputMergerKernels<DepthTestOn, Func, DepthWrite, Blend, 16>();
+        default:
+            break;
+        }
+        return outputMergerKernels<DepthTestOn, Func, DepthWrite, Blend, 1>();
+    }
+
+    // common blend setups get their own kernel, everything else goes through calcBlendColor
+    template <bool DepthTestOn, DepthFunction Func, bool DepthWrite>
+    OutputMergerKernels selectOutputMerger(const RenderStates &states, int sampleCnt)
+    {
+        const BlendParameters &params = states.blendParams;
+        bool sameFactors = params.Src_RGB == params.Src_Alpha && params.Dst_RGB == params.Dst_Alpha &&
+                           params.Func_RGB == BlendFunction::ADD && params.Func_Alpha == BlendFunction::ADD;
+        auto isFactors = [&](BlendFactor src, BlendFactor dst) -> bool
+        {
+            return sameFactors && params.Src_RGB == src && params.Dst_RGB == dst;
+        };
+
+        if (!states.blend || isFactors(BlendFactor::ONE, BlendFactor::ZERO))
+        {
+            return selectOutputMerger<DepthTestOn, Func, DepthWrite, BlendDisabled>(sampleCnt);
+        }
+        if (isFactors(BlendFactor::SRC_ALPHA, BlendFactor::ONE_MINUS_SRC_ALPHA))
+        {
+            return selectOutputMerger<DepthTestOn, Func, DepthWrite, BlendAdd<BlendFactor::SRC_ALPHA, BlendFactor::ONE_MINUS_SRC_ALPHA>>(sampleCnt);
+        }
+        if (isFactors(BlendFactor::ONE, BlendFactor::ONE_MINUS_SRC_ALPHA))
+        {
+            return selectOutputMerger<DepthTestOn, Func, DepthWrite, BlendAdd<BlendFactor::ONE, BlendFactor::ONE_MINUS_SRC_ALPHA>>(sampleCnt);
+        }
+        if (isFactors(BlendFactor::ONE, BlendFactor::ONE))
+        {
+            return selectOutputMerger<DepthTestOn, Func, DepthWrite, BlendAdd<BlendFactor::ONE, BlendFactor::ONE>>(sampleCnt);
+        }
+        return selectOutputMerger<DepthTestOn, Func, DepthWrite, BlendGeneric>(sampleCnt);
+    }
+
+    template <DepthFunction Func>
+    OutputMergerKernels selectOutputMergerDepth(const RenderStates &states, int sampleCnt)
+    {
+        return states.depthMask ? selectOutputMerger<true, Func, true>(states, sampleCnt)
+                                : selectOutputMerger<true, Func, false>(states, sampleCnt);
+    }
+
+    inline OutputMergerKernels selectOutputMerger(const RenderStates &states, int sampleCnt)
+    {
+        if (!states.depthTest)
+        {
+            return selectOutputMerger<false, LESS, false>(states, sampleCnt);
+        }
+        switch (states.depthFunc)
+        {
+        case LESS:
+            return selectOutputMergerDepth<LESS>(states, sampleCnt);
+        case LEQUAL:
+            return selectOutputMergerDepth<LEQUAL>(states, sampleCnt);
+        case GREATER:
+            return selectOutputMergerDepth<GREATER>(states, sampleCnt);
+        case GEQUAL:
+            return selectOutputMergerDepth<GEQUAL>(states, sampleCnt);
+        case EQUAL:
+            return selectOutputMergerDepth<EQUAL>(states, sampleCnt);
+        case NOTEQUAL:
+            return selectOutputMergerDepth<NOTEQUAL>(states, sampleCnt);
+        case ALWAYS:
+            return selectOutputMergerDepth<ALWAYS>(states, sampleCnt);
+        case NEVER:
+            return selectOutputMergerDepth<NEVER>(states, sampleCnt);
+        }
+        return selectOutputMergerDepth<LESS>(states, sampleCnt);
+    }
+
+    // output merger kernels are resolved once per pipeline, the sample count comes from the render target at draw
+    class PipelineStatesSoft : public PipelineStates
+    {
+    public:
+        static constexpr int SampleCountVariants = 5; // 1x, 2x, 4x, 8x, 16x
+
+        explicit PipelineStatesSoft(const RenderStates &states)
+            : PipelineStates(states)
+        {
+            for (int i = 0; i < SampleCountVariants; i++)
+            {
+                outputMerger_[i] = selectOutputMerger(renderStates, 1 << i);
+            }
+        }
+
+        inline const OutputMergerKernels &getOutputMerger(int sampleCnt) const
+        {
+            int idx = 0;
+            while (idx + 1 < SampleCountVariants && (1 << idx) < sampleCnt)
+            {
+                idx++;
+            }
+            return outputMerger_[idx];
+        }
+
+    private:
+        OutputMergerKernels outputMerger_[SampleCountVariants];
+    };
+
+}
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <unordered_map>
 #include "Utils/AlignedMemory.h"
+#include "Utils/Hash.h"
 #include "ShaderProgramSoft.h"
+#include "UniformSoft.h"
 
 namespace Learn
 {
@@ -17,6 +20,10 @@ namespace Learn
 
         float absMinDepth;
         float absMaxDepth;
+
+        // guard band half extent in NDC units, triangles inside it are scissored by the rasterizer instead of clipped
+        float guardBandX;
+        float guardBandY;
     };
 
     struct VertexHolder
@@ -29,11 +36,9 @@ namespace Learn
         float *varyings = nullptr;
 
         int clipMask = 0;
+        int guardBandMask = 0; // planes that still need geometric clipping in guard band mode
         glm::aligned_vec4 clipPos = glm::vec4(0.f); // clip space position
         glm::aligned_vec4 fragPos = glm::vec4(0.f); // screen space position
-
-        std::shared_ptr<uint8_t> vertexHolder = nullptr;
-        std::shared_ptr<float> varyingsHolder = nullptr;
     };
 
     struct PrimitiveHolder
@@ -43,6 +48,244 @@ namespace Learn
         size_t indices[3] = {0, 0, 0};
     };
 
+    // screen space tile, owns the primitives binned into it (in submission order)
+    struct RasterTile
+    {
+        // set on triangles whose samples all lie in one pixel quad of the tile
+        static constexpr uint32_t MicroTriangleBit = 1u << 31;
+
+        int x = 0;
+        int y = 0;
+        int width = 0;
+        int height = 0;
+        std::vector<uint32_t> primitives;
+    };
+
+    // pixel rect [minX, maxX) * [minY, maxY) of a point sprite
+    struct PointSetup
+    {
+        int minX = 0;
+        int minY = 0;
+        int maxX = 0;
+        int maxY = 0;
+
+        PointSetup(const glm::vec4 &pos, float size)
+        {
+            float left = pos.x - size / 2.f + 0.5f;
+            float top = pos.y - size / 2.f + 0.5f;
+            minX = (int)left;
+            minY = (int)top;
+            maxX = (int)(left + size);
+            maxY = (int)(top + size);
+        }
+    };
+
+    // bresenham line along its major axis x (x and y swapped if steep), from x0 to x1
+    // every step covers a span of spanWidth pixels on the minor axis starting at y + spanOffset
+    struct LineSetup
+    {
+        bool steep = false;
+        int x0 = 0, y0 = 0;
+        int x1 = 0, y1 = 0;
+        int dx = 0;
+        int dy = 0;
+        int stepY = 1;
+        int spanOffset = 0;
+        int spanWidth = 1;
+        float z0 = 0.f, z1 = 0.f;
+        float w0 = 0.f, w1 = 0.f;
+        const float *varyings[2] = {nullptr, nullptr};
+
+        LineSetup(const VertexHolder &v0, const VertexHolder &v1, float lineWidth)
+        {
+            x0 = (int)v0.fragPos.x;
+            y0 = (int)v0.fragPos.y;
+            x1 = (int)v1.fragPos.x;
+            y1 = (int)v1.fragPos.y;
+            z0 = v0.fragPos.z;
+            z1 = v1.fragPos.z;
+            w0 = v0.fragPos.w;
+            w1 = v1.fragPos.w;
+            varyings[0] = v0.varyings;
+            varyings[1] = v1.varyings;
+
+            if (std::abs(x0 - x1) < std::abs(y0 - y1))
+            {
+                std::swap(x0, y0);
+                std::swap(x1, y1);
+                steep = true;
+            }
+            if (x0 > x1)
+            {
+                std::swap(x0, x1);
+                std::swap(y0, y1);
+                std::swap(z0, z1);
+                std::swap(w0, w1);
+                std::swap(varyings[0], varyings[1]);
+            }
+            dx = x1 - x0;
+            dy = y1 - y0;
+            stepY = y1 > y0 ? 1 : -1;
+
+            spanOffset = (int)std::floor(0.5f - lineWidth / 2.f);
+            spanWidth = std::max(1, (int)std::floor(0.5f + lineWidth / 2.f) - spanOffset);
+        }
+    };
+
+    // triangle setup: fixed-point edge equations, computed once per triangle
+    // E(x, y) = a * x + b * y + c, x/y in 1/16 pixel units, edge i is opposite to vertex i
+    struct TriangleSetup
+    {
+        static constexpr int SubPixelBits = 4;
+        static constexpr int SubPixelScale = 1 << SubPixelBits;
+        static constexpr int MaxSpanLanes = 64; // one quad at 16x
+
+        int64_t a[3] = {0, 0, 0};
+        int64_t b[3] = {0, 0, 0};
+        int64_t c[3] = {0, 0, 0};
+        int64_t bias[3] = {0, 0, 0}; // fill rule, 0 for inclusive edges, -1 otherwise
+        float invArea = 0.f;
+        bool swapWinding = false; // vertex 1 and 2 swapped to make the area positive
+
+        // edge values at current span origin
+        int64_t edgeOrigin[3] = {0, 0, 0};
+
+        // per-lane sample offsets (a * dx + b * dy) relative to span origin
+        int laneCnt = 0;
+        alignas(32) int32_t laneOffset[3][MaxSpanLanes] = {};
+        // pixel center offsets, used by multi-sample shading
+        int32_t centerOffset[3][4] = {};
+
+        // screen space depth plane z = zPlane[0] * x + zPlane[1] * y + zPlane[2] (pixel units)
+        double zPlane[3] = {0, 0, 0};
+        float zMin = 0.f;
+        float zMax = 0.f;
+
+        // per-lane depth z = sum(zEdge[i] * E_i) at current span origin, shared by the shaded and depth only paths
+        float zEdge[3] = {0.f, 0.f, 0.f};
+        alignas(32) float laneDepth[MaxSpanLanes] = {};
+
+        enum BlockCoverage
+        {
+            Block_Outside,
+            Block_Partial,
+            Block_Inside,
+        };
+
+        void SetSpanOrigin(int x, int y)
+        {
+            for (int i = 0; i < 3; i++)
+            {
+                edgeOrigin[i] = a[i] * x * SubPixelScale + b[i] * y * SubPixelScale + c[i];
+            }
+        }
+
+        // corner test of the pixel rect [x, x + w) * [y, y + h), conservative for every sample inside it
+        BlockCoverage TestBlock(int x, int y, int w, int h) const
+        {
+            int64_t sizeX = (int64_t)w * SubPixelScale;
+            int64_t sizeY = (int64_t)h * SubPixelScale;
+            bool inside = true;
+            for (int i = 0; i < 3; i++)
+            {
+                int64_t e = a[i] * x * SubPixelScale + b[i] * y * SubPixelScale + c[i] + bias[i];
+                int64_t dx = a[i] * sizeX;
+                int64_t dy = b[i] * sizeY;
+                int64_t eMax = e + std::max(dx, (int64_t)0) + std::max(dy, (int64_t)0);
+                int64_t eMin = e + std::min(dx, (int64_t)0) + std::min(dy, (int64_t)0);
+                if (eMax < 0)
+                {
+                    return Block_Outside;
+                }
+                if (eMin < 0)
+                {
+                    inside = false;
+                }
+            }
+            return inside ? Block_Inside : Block_Partial;
+        }
+
+        // depth range of the triangle inside pixel rect [x, x + w) * [y, y + h)
+        void BlockDepthRange(int x, int y, int w, int h, float &outMin, float &outMax) const
+        {
+            double z00 = zPlane[0] * x + zPlane[1] * y + zPlane[2];
+            double dx = zPlane[0] * w;
+            double dy = zPlane[1] * h;
+            double lo = z00 + std::min(dx, 0.0) + std::min(dy, 0.0);
+            double hi = z00 + std::max(dx, 0.0) + std::max(dy, 0.0);
+            outMin = glm::clamp((float)lo, zMin, zMax);
+            outMax = glm::clamp((float)hi, zMin, zMax);
+        }
+    };
+
+    // draw recorded by visibility buffer mode, keeps what is needed to shade its triangles later
+    struct VisibilityDraw
+    {
+        uint32_t primitiveBase = 0;
+        std::vector<VertexHolder> vertexes;
+        std::vector<PrimitiveHolder> primitives; // vertex varyings stay in the frame arena until the pass ends
+        size_t varyingsCnt = 0;
+        size_t varyingsAlignedCnt = 0;
+
+        // copy of the uniforms bound for this draw, the per worker clones are rebound to it while shading
+        std::shared_ptr<uint8_t> uniforms = nullptr;
+        std::vector<std::shared_ptr<ShaderProgramSoft>> threadPrograms;
+    };
+
+    // copy of a sampler taken when draws were recorded, the recorded uniforms point at it instead
+    struct VisibilitySampler
+    {
+        SamplerSoft *sampler = nullptr;
+        uint32_t version = 0;
+        std::shared_ptr<SamplerSoft> snapshot;
+    };
+
+    // per worker clones of one program, reused by every draw with that program
+    struct ThreadProgramSet
+    {
+        std::vector<std::shared_ptr<ShaderProgramSoft>> programs;
+        uint64_t lastUsePass = 0;
+    };
+
+    // binding tables are cached per (program, resources) pair
+    struct BindingTableKey
+    {
+        int programId = -1;
+        const ShaderResources *resources = nullptr;
+
+        bool operator==(const BindingTableKey &other) const
+        {
+            return programId == other.programId && resources == other.resources;
+        }
+    };
+
+    struct BindingTableKeyHash
+    {
+        size_t operator()(const BindingTableKey &key) const
+        {
+            size_t seed = 0;
+            Hash::hashCombine(seed, key.programId);
+            Hash::hashCombine(seed, key.resources);
+            return seed;
+        }
+    };
+
+    // binding tables of one thread, entries unused for a number of its passes are evicted
+    struct BindingTableCache
+    {
+        std::unordered_map<BindingTableKey, ResourceBindingTableSoft, BindingTableKeyHash> tables;
+        ResourceBindingTableSoft *lastTable = nullptr;
+        BindingTableKey lastKey;
+        uint64_t passCnt = 0;
+    };
+
+    // hierarchical z: conservative depth range of a block of the depth attachment
+    struct HiZTile
+    {
+        float minDepth = 0.f;
+        float maxDepth = 1.f;
+    };
+
     class SampleContext
     {
     public:
@@ -72,6 +315,57 @@ namespace Learn
             };
             return location_4x;
         }
+        // standard sample patterns, all positions on the 1/16 sub-pixel grid
+        inline static glm::vec2 *GetSampleLocation(int sampleCnt)
+        {
+            static glm::vec2 location_1x[1] = {{0.5f, 0.5f}};
+            static glm::vec2 location_2x[2] = {
+                {0.75f, 0.75f},
+                {0.25f, 0.25f},
+            };
+            static glm::vec2 location_8x[8] = {
+                {0.5625f, 0.3125f},
+                {0.4375f, 0.6875f},
+                {0.8125f, 0.5625f},
+                {0.3125f, 0.1875f},
+                {0.1875f, 0.8125f},
+                {0.0625f, 0.4375f},
+                {0.6875f, 0.9375f},
+                {0.9375f, 0.0625f},
+            };
+            static glm::vec2 location_16x[16] = {
+                {0.5625f, 0.5625f},
+                {0.4375f, 0.3125f},
+                {0.3125f, 0.625f},
+                {0.75f, 0.4375f},
+                {0.1875f, 0.375f},
+                {0.625f, 0.8125f},
+                {0.8125f, 0.6875f},
+                {0.6875f, 0.1875f},
+                {0.375f, 0.875f},
+                {0.5f, 0.0625f},
+                {0.25f, 0.125f},
+                {0.125f, 0.75f},
+                {0.f, 0.5f},
+                {0.9375f, 0.25f},
+                {0.875f, 0.9375f},
+                {0.0625f, 0.f},
+            };
+            switch (sampleCnt)
+            {
+            case 2:
+                return location_2x;
+            case 4:
+                return GetSampleLocation4X();
+            case 8:
+                return location_8x;
+            case 16:
+                return location_16x;
+            default:
+                break;
+            }
+            return location_1x;
+        }
         void Init(float x, float y, int sample_cnt = 1)
         {
             inside = false;
@@ -80,18 +374,16 @@ namespace Learn
             if (sampleCount > 1)
             {
                 samples.resize(sampleCount + 1); // 存储中央采样
-                if (sampleCount == 4)
+                glm::vec2 *location = GetSampleLocation(sampleCount);
+                for (int i = 0; i < sampleCount; i++)
                 {
-                    for (int i = 0; i < sampleCount; i++)
-                    {
-                        samples[i].fboCoord = glm::ivec2(x, y);
-                        samples[i].position = glm::vec4(GetSampleLocation4X()[i] + glm::vec2(x, y), 0.f, 0.f);
-                    }
-                    // pixel center
-                    samples[4].fboCoord = glm::ivec2(x, y);
-                    samples[4].position = glm::vec4(x + 0.5f, y + 0.5f, 0.f, 0.f);
-                    sampleShading = &samples[4];
+                    samples[i].fboCoord = glm::ivec2(x, y);
+                    samples[i].position = glm::vec4(location[i] + glm::vec2(x, y), 0.f, 0.f);
                 }
+                // pixel center
+                samples[sampleCount].fboCoord = glm::ivec2(x, y);
+                samples[sampleCount].position = glm::vec4(x + 0.5f, y + 0.5f, 0.f, 0.f);
+                sampleShading = &samples[sampleCount];
             }
             else
             {
@@ -152,7 +444,6 @@ namespace Learn
 
         // triangle vertex screen space position
         glm::aligned_vec4 vertPos[3];
-        glm::aligned_vec4 vertPosFlat[4];
 
         // triangle barycentric correct
         const float *vertZ[3] = {nullptr, nullptr, nullptr};
@@ -164,6 +455,21 @@ namespace Learn
         // triangle Facing
         bool frontFacing = true;
 
+        // triangle edge equations
+        TriangleSetup setup;
+
+        // visibility buffer id (draw primitive base + primitive index + 1)
+        uint32_t primitiveId = 0;
+
+        // micro triangles merged into this quad and not shaded yet, pixel mask and quad origin
+        int mergeMask = 0;
+        int mergeX = 0;
+        int mergeY = 0;
+        bool mergeFrontFacing = true;
+
+        // batch fragment shading input/output
+        FragmentBatch batch;
+
         // shader program
         std::shared_ptr<ShaderProgramSoft> shaderProgram = nullptr;
 
@@ -172,16 +478,20 @@ namespace Learn
         std::shared_ptr<float> varyingsPool_ = nullptr;
 
     public:
+        // the pool only grows, draws with fewer varyings reuse it
         void SetVaryingsSize(size_t size)
         {
-            if (varyingsAlignedCnt_ != size)
+            if (varyingsAlignedCnt_ < size)
             {
                 varyingsAlignedCnt_ = size;
-                varyingsPool_ = AlignedMemory::makeAlignedBuffer<float>(4 * varyingsAlignedCnt_);
+                // per pixel varyings, followed by their SoA copy for batch shading
+                varyingsPool_ = AlignedMemory::makeAlignedBuffer<float>(8 * varyingsAlignedCnt_);
                 for (int i = 0; i < 4; i++)
                 {
                     pixels[i].varyingsFrag = varyingsPool_.get() + i * varyingsAlignedCnt_;
+                    batch.laneVaryings[i] = pixels[i].varyingsFrag;
                 }
+                batch.varyings = varyingsPool_.get() + 4 * varyingsAlignedCnt_;
             }
         }
 
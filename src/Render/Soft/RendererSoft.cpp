@@ -1,4 +1,5 @@
 #include "RendererSoft.h"
+#include <bit>
 #include "Utils/SIMD.h"
 #include "Utils/Hash.h"
 #include "FrameBufferSoft.h"
@@ -14,6 +15,161 @@ namespace Learn
 
 #define RASTER_MULTI_THREAD
 
+    // coverage span: 2x4 pixels (two quads) without multi-sample, or one quad with all its samples
+    struct SpanLayout
+    {
+        int laneCnt = 0;
+        int quadLanes = 0;
+        uint64_t laneMask = 0;
+        uint64_t quadMask = 0; // lanes of the first quad
+        int pixelX[TriangleSetup::MaxSpanLanes] = {};
+        int pixelY[TriangleSetup::MaxSpanLanes] = {};
+        int offsetX[TriangleSetup::MaxSpanLanes] = {}; // sample position in 1/16 pixel units
+        int offsetY[TriangleSetup::MaxSpanLanes] = {};
+    };
+
+    static inline uint64_t lowLanes(int cnt)
+    {
+        return cnt >= 64 ? ~0ull : (1ull << cnt) - 1;
+    }
+
+    static SpanLayout buildSpanLayout(int sampleCnt)
+    {
+        const int scale = TriangleSetup::SubPixelScale;
+        SpanLayout layout;
+        layout.quadLanes = 4 * sampleCnt;
+        layout.laneCnt = std::max(8, layout.quadLanes);
+        layout.laneMask = lowLanes(layout.laneCnt);
+        layout.quadMask = lowLanes(layout.quadLanes);
+        for (int lane = 0; lane < layout.laneCnt; lane++)
+        {
+            int quadIdx = lane / layout.quadLanes;
+            int pixelIdx = (lane % layout.quadLanes) / sampleCnt;
+            layout.pixelX[lane] = quadIdx * 2 + (pixelIdx & 1);
+            layout.pixelY[lane] = pixelIdx >> 1;
+
+            glm::vec2 location = PixelContext::GetSampleLocation(sampleCnt)[lane % sampleCnt];
+            layout.offsetX[lane] = (int)(((float)layout.pixelX[lane] + location.x) * scale);
+            layout.offsetY[lane] = (int)(((float)layout.pixelY[lane] + location.y) * scale);
+        }
+        return layout;
+    }
+
+    static const SpanLayout &getSpanLayout(int sampleCnt)
+    {
+        static const SpanLayout layout1x = buildSpanLayout(1);
+        static const SpanLayout layout2x = buildSpanLayout(2);
+        static const SpanLayout layout4x = buildSpanLayout(4);
+        static const SpanLayout layout8x = buildSpanLayout(8);
+        static const SpanLayout layout16x = buildSpanLayout(16);
+        switch (sampleCnt)
+        {
+        case 2:
+            return layout2x;
+        case 4:
+            return layout4x;
+        case 8:
+            return layout8x;
+        case 16:
+            return layout16x;
+        default:
+            break;
+        }
+        return layout1x;
+    }
+
+    static inline void edgeBarycentric(const TriangleSetup &setup, const int64_t e[3], glm::aligned_vec4 &bc)
+    {
+        bc = {(float)e[0] * setup.invArea, (float)e[1] * setup.invArea, (float)e[2] * setup.invArea, 0.f};
+        if (setup.swapWinding)
+        {
+            std::swap(bc.y, bc.z);
+        }
+    }
+
+    // depth of every lane at the span origin, the same arithmetic for all paths keeps their depth bit exact
+    static inline void edgeSpanDepth(TriangleSetup &setup)
+    {
+#ifdef SOFTGL_SIMD_OPT
+        for (int base = 0; base < setup.laneCnt; base += 8)
+        {
+            __m256 z = _mm256_setzero_ps();
+            for (int i = 0; i < 3; i++)
+            {
+                __m256 offset = _mm256_cvtepi32_ps(_mm256_load_si256((__m256i *)&setup.laneOffset[i][base]));
+                __m256 e = _mm256_add_ps(_mm256_set1_ps((float)setup.edgeOrigin[i]), offset);
+                z = _mm256_fmadd_ps(e, _mm256_set1_ps(setup.zEdge[i]), z);
+            }
+            _mm256_store_ps(&setup.laneDepth[base], z);
+        }
+#else
+        for (int lane = 0; lane < setup.laneCnt; lane++)
+        {
+            float z = 0.f;
+            for (int i = 0; i < 3; i++)
+            {
+                float e = (float)setup.edgeOrigin[i] + (float)setup.laneOffset[i][lane];
+                z = std::fma(e, setup.zEdge[i], z);
+            }
+            setup.laneDepth[lane] = z;
+        }
+#endif
+    }
+
+    // pixels whose samples may lie inside the snapped bounding box, false if the triangle misses every sample
+    static bool triangleSampleBounds(VertexHolder *vert[3], int sampleCnt, int &minX, int &minY, int &maxX, int &maxY)
+    {
+        // same snapping as setupTriangle
+        const float coordLimit = (float)(1 << 17);
+        int64_t lo[2] = {std::numeric_limits<int64_t>::max(), std::numeric_limits<int64_t>::max()};
+        int64_t hi[2] = {std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::min()};
+        for (int i = 0; i < 3; i++)
+        {
+            for (int axis = 0; axis < 2; axis++)
+            {
+                auto v = (int64_t)std::floor(glm::clamp(vert[i]->fragPos[axis], -coordLimit, coordLimit) * TriangleSetup::SubPixelScale + 0.5f);
+                lo[axis] = std::min(lo[axis], v);
+                hi[axis] = std::max(hi[axis], v);
+            }
+        }
+
+        // sample offsets of the first pixel of a span, in sub-pixel units
+        const SpanLayout &layout = getSpanLayout(sampleCnt);
+        int offsetMin[2] = {TriangleSetup::SubPixelScale, TriangleSetup::SubPixelScale};
+        int offsetMax[2] = {0, 0};
+        for (int lane = 0; lane < sampleCnt; lane++)
+        {
+            offsetMin[0] = std::min(offsetMin[0], layout.offsetX[lane]);
+            offsetMax[0] = std::max(offsetMax[0], layout.offsetX[lane]);
+            offsetMin[1] = std::min(offsetMin[1], layout.offsetY[lane]);
+            offsetMax[1] = std::max(offsetMax[1], layout.offsetY[lane]);
+        }
+
+        // first pixel with a sample at or after lo, last pixel with a sample at or before hi
+        int bounds[2][2];
+        for (int axis = 0; axis < 2; axis++)
+        {
+            bounds[axis][0] = (int)-((offsetMax[axis] - lo[axis]) >> TriangleSetup::SubPixelBits);
+            bounds[axis][1] = (int)((hi[axis] - offsetMin[axis]) >> TriangleSetup::SubPixelBits);
+        }
+        minX = bounds[0][0];
+        maxX = bounds[0][1];
+        minY = bounds[1][0];
+        maxY = bounds[1][1];
+        return minX <= maxX && minY <= maxY;
+    }
+
+    // w, depth clipping and perspective correction of a covered sample, z is already the span depth
+    static inline void perspectiveSample(SampleContext &sample, const glm::aligned_vec4 &vertW, float minDepth, float maxDepth)
+    {
+        sample.position.w = glm::dot(sample.barycentric, vertW);
+        if (sample.position.z < minDepth || sample.position.z > maxDepth)
+        {
+            sample.inside = false;
+        }
+        sample.barycentric *= (1.f / sample.position.w * vertW);
+    }
+
     std::shared_ptr<FrameBuffer> RendererSoft::createFrameBuffer(bool offscreen)
     {
         return std::make_shared<FrameBufferSoft>(offscreen);
@@ -43,7 +199,7 @@ namespace Learn
 
     std::shared_ptr<PipelineStates> RendererSoft::createPipelineStates(const RenderStates &renderStates)
     {
-        return std::make_shared<PipelineStates>(renderStates);
+        return std::make_shared<PipelineStatesSoft>(renderStates);
     }
 
     std::shared_ptr<UniformBlock> RendererSoft::createUniformBlock(const std::string &name, int size)
@@ -59,6 +215,25 @@ namespace Learn
     // 渲染管线
     void RendererSoft::beginRenderPass(std::shared_ptr<FrameBuffer> &frameBuffer, const ClearStates &states)
     {
+        if (recordingCommands())
+        {
+            // attachments are captured now, the caller may rebind them before the pass executes
+            recordFbo_ = dynamic_cast<FrameBufferSoft *>(frameBuffer.get());
+            recordFboSnapshot_ = recordFbo_ ? std::make_shared<FrameBufferSoft>(*recordFbo_) : nullptr;
+            auto &cmd = recordList_->add(Command_BeginRenderPass);
+            cmd.frameBuffer = recordFboSnapshot_;
+            cmd.clearStates = states;
+            // the submit thread evicts its own tables when the pass is replayed
+            evictBindingTables(recordBindingTables_);
+            return;
+        }
+
+        // previous pass not ended
+        flushVisibilityBuffer();
+        multiSampleResolve();
+        frameArena_.reset();
+        evictPassCaches();
+
         fbo_ = dynamic_cast<FrameBufferSoft *>(frameBuffer.get());
         if (!fbo_)
             return;
@@ -66,33 +241,45 @@ namespace Learn
         fboColor_ = fbo_->getColorBuffer();
         fboDepth_ = fbo_->getDepthBuffer();
 
+        // clears are recorded per raster tile and written when a tile is first touched
         if (states.colorFlag && fboColor_)
         {
             RGBA color = RGBA(states.clearColor.r * 255.f, states.clearColor.g * 255.f, states.clearColor.b * 255.f, states.clearColor.a * 255.f);
+            fboColor_->clearLazy(color, rasterTileSize_);
             if (fboColor_->multiSample)
             {
-                fboColor_->bufferMs4x->setAll(glm::tvec4<RGBA>(color));
-            }
-            else
-            {
-                fboColor_->buffer->setAll(color);
+                setupResolveTiles(true);
             }
         }
         if (states.depthFlag && fboDepth_)
         {
-            if (fboDepth_->multiSample)
+            fboDepth_->clearLazy(states.clearDepth, rasterTileSize_);
+        }
+
+        if (fboDepth_)
+        {
+            if (states.depthFlag)
             {
-                fboDepth_->bufferMs4x->setAll(glm::tvec4<float>(states.clearDepth));
+                resetHiZ(states.clearDepth);
             }
             else
             {
-                fboDepth_->buffer->setAll(states.clearDepth);
+                rebuildHiZ();
             }
         }
     }
 
     void RendererSoft::setViewPort(int x, int y, int width, int height)
     {
+        if (recordingCommands())
+        {
+            recordList_->add(Command_SetViewPort).viewport = glm::ivec4(x, y, width, height);
+            return;
+        }
+
+        // pending draws are shaded over the tiles of the viewport they were drawn with
+        flushVisibilityBuffer();
+
         viewport_.x = (float)x;
         viewport_.y = (float)y;
         viewport_.width = (float)width;
@@ -115,15 +302,31 @@ namespace Learn
         viewport_.innerP.y = viewport_.height / 2.f;                  // Y 缩放（提前除以 2）
         viewport_.innerP.z = viewport_.maxDepth - viewport_.minDepth; // 深度缩放
         viewport_.innerP.w = 1.f;                                     // 未使用（对齐）
+
+        // guard band keeps screen coordinates far below the snapping limit of setupTriangle
+        const float guardBandPixels = (float)(1 << 15);
+        viewport_.guardBandX = std::max(1.f, guardBandPixels / std::max(viewport_.innerP.x, 1.f));
+        viewport_.guardBandY = std::max(1.f, guardBandPixels / std::max(viewport_.innerP.y, 1.f));
     }
 
     void RendererSoft::setVertexArrayObject(std::shared_ptr<VertexArrayObject> &vao)
     {
+        if (recordingCommands())
+        {
+            recordList_->add(Command_SetVertexArrayObject).vao = vao;
+            return;
+        }
         vao_ = dynamic_cast<VertexArrayObjectSoft *>(vao.get());
     }
 
     void RendererSoft::setShaderProgram(std::shared_ptr<ShaderProgram> &program)
     {
+        if (recordingCommands())
+        {
+            recordProgram_ = dynamic_cast<ShaderProgramSoft *>(program.get());
+            recordList_->add(Command_SetShaderProgram).program = program;
+            return;
+        }
         shaderProgram_ = dynamic_cast<ShaderProgramSoft *>(program.get());
     }
 
@@ -131,17 +334,68 @@ namespace Learn
     {
         if (!resources)
             return;
-        if (shaderProgram_)
-            shaderProgram_->bindUniform(*resources);
+        if (recordingCommands())
+        {
+            recordShaderResources(*resources);
+            return;
+        }
+        if (!shaderProgram_)
+            return;
+
+        // only blocks updated since they were last copied into the program are copied again
+        auto &table = getBindingTable(bindingTables_, *shaderProgram_, *resources);
+        for (auto &binding : table.bindings)
+        {
+            if (binding.block)
+            {
+                auto &data = binding.block->getBuffer();
+                shaderProgram_->bindUniformBlockBuffer((void *)data.data(), data.size(), binding.location,
+                                                       binding.uniformId, binding.block->getVersion());
+            }
+            else if (binding.sampler)
+            {
+                shaderProgram_->bindUniformSampler(binding.sampler->getSampler(), binding.location);
+            }
+        }
+    }
+
+    ResourceBindingTableSoft &RendererSoft::getBindingTable(BindingTableCache &cache, ShaderProgramSoft &program,
+                                                            const ShaderResources &resources)
+    {
+        // consecutive draws mostly reuse the pair of the previous one
+        BindingTableKey key{program.getId(), &resources};
+        if (!(cache.lastTable && cache.lastKey == key))
+        {
+            cache.lastTable = &cache.tables[key];
+            cache.lastKey = key;
+        }
+        auto &table = *cache.lastTable;
+        table.lastUsePass = cache.passCnt;
+        if (!table.matches(resources))
+        {
+            table.build(program, resources);
+        }
+        return table;
     }
 
     void RendererSoft::setPipelineStates(std::shared_ptr<PipelineStates> &states)
     {
+        if (recordingCommands())
+        {
+            recordList_->add(Command_SetPipelineStates).states = states;
+            return;
+        }
+        pipelineStates_ = dynamic_cast<PipelineStatesSoft *>(states.get());
         renderState_ = &states->renderStates;
     }
 
     void RendererSoft::draw()
     {
+        if (recordingCommands())
+        {
+            recordDraw();
+            return;
+        }
         if (!vao_ || !shaderProgram_ || !fbo_)
             return;
 
@@ -149,9 +403,38 @@ namespace Learn
         fboDepth_ = fbo_->getDepthBuffer();
         primitiveType_ = renderState_->primitiveType;
 
+        // tile tasks materialize pending clears on the raster tile grid
+        if (fboColor_ && fboColor_->clearPending && fboColor_->clearTileSize != rasterTileSize_)
+        {
+            fboColor_->materializeAll();
+        }
+        if (fboDepth_ && fboDepth_->clearPending && fboDepth_->clearTileSize != rasterTileSize_)
+        {
+            fboDepth_->materializeAll();
+        }
+
+        // targets of earlier passes keep their untouched tiles pending until something samples them
+        for (auto *sampler : shaderProgram_->getBoundSamplers())
+        {
+            if (sampler)
+            {
+                sampler->materializeClears();
+            }
+        }
+
+        // depth attachment changed after beginRenderPass
+        if (fboDepth_ && fboDepth_.get() != hizDepth_)
+        {
+            rebuildHiZ();
+        }
+
         if (fboColor_)
         {
             rasterSamples_ = fboColor_->sampleCnt;
+            if (fboColor_->multiSample)
+            {
+                setupResolveTiles(false);
+            }
         }
         else if (fboDepth_)
         {
@@ -161,894 +444,2731 @@ namespace Learn
         {
             rasterSamples_ = 1;
         }
+        if (fboDepth_ && fboDepth_->sampleCnt != rasterSamples_)
+        {
+            LOG_ERROR("draw error: color and depth sample count not match");
+            return;
+        }
+
+        // output merger kernel specialized for the pipeline states and sample count
+        outputMerger_ = pipelineStates_ ? pipelineStates_->getOutputMerger(rasterSamples_)
+                                        : selectOutputMerger(*renderState_, rasterSamples_);
+        outputMergerCtx_.color = fboColor_.get();
+        outputMergerCtx_.depth = fboDepth_.get();
+        outputMergerCtx_.blendParams = &renderState_->blendParams;
+        outputMergerCtx_.minDepth = viewport_.absMinDepth;
+        outputMergerCtx_.maxDepth = viewport_.absMaxDepth;
+        outputMergerCtx_.linear = (!fboColor_ || fboColor_->multiSample || fboColor_->buffer->getLayout() == Layout_Linear) &&
+                                  (!fboDepth_ || fboDepth_->multiSample || fboDepth_->buffer->getLayout() == Layout_Linear);
+
+        // draws not suitable for deferred shading keep the submission order with the pending ones
+        visibilityPass_ = visibilityBuffer_ && checkVisibilityEligible();
+        if (!visibilityPass_)
+        {
+            flushVisibilityBuffer();
+        }
+        else
+        {
+            visibilityPrimitiveBase_ = visibilityPrimitiveCnt_;
+            size_t pixelCnt = (size_t)fboColor_->width * fboColor_->height;
+            if (visibilityIds_.size() != pixelCnt)
+            {
+                visibilityIds_.assign(pixelCnt, 0);
+            }
+        }
+
+        // no color attachment and no discard: only depth is rasterized, without fragment shading
+        depthOnlyPass_ = checkDepthOnlyEligible();
+        if (depthOnlyPass_ && !(renderState_->depthTest && renderState_->depthMask))
+        {
+            // nothing can be written
+            return;
+        }
 
+        setupThreadPrograms();
         processVertexShader();
         processPrimitiveAssembly();
         processClipping();
         processPerspectiveDivide();
         processViewportTransform();
-        processFaceCulling();
         processRasterization();
 
-        if (fboColor_ && fboColor_->multiSample)
+        if (visibilityPass_)
         {
-            multiSampleResolve();
+            recordVisibilityDraw();
+            visibilityPass_ = false;
         }
     }
     void RendererSoft::endRenderPass()
     {
-    }
+        if (recordingCommands())
+        {
+            // the pass starts executing while the caller records the next one
+            recordList_->add(Command_EndRenderPass);
+            submitCommands();
+            return;
+        }
 
-    void RendererSoft::waitIdle()
-    {
+        flushVisibilityBuffer();
+        multiSampleResolve();
     }
 
-    void RendererSoft::processVertexShader()
+    void RendererSoft::waitIdle()
     {
-        varyingsCnt_ = shaderProgram_->getShaderVaryingsSize() / sizeof(float);
-        varyingsAlignedSize_ = AlignedMemory::getAlignedSize(varyingsCnt_ * sizeof(float));
-        varyingsAlignedCnt_ = varyingsAlignedSize_ / sizeof(float);
-
-        varyings_ = AlignedMemory::makeAlignedBuffer<float>(vao_->vertexCnt * varyingsAlignedSize_);
-        float *varyingBuffer = varyings_.get();
-
-        uint8_t *vertexPtr = vao_->vertexes.data();
-        vertexes_.reserve(vao_->vertexCnt);
-        for (size_t i = 0; i < vao_->vertexCnt; i++)
+        if (commandList_)
         {
-            VertexHolder &holder = vertexes_[i];
-            holder.discard = false;
-            holder.index = i;
-            holder.vertex = vertexPtr;
-            holder.varyings = (varyingsAlignedSize_ > 0) ? (varyingBuffer + i * varyingsAlignedCnt_) : nullptr;
-            vertexShaderImpl(holder);
-            vertexPtr += vao_->vertexStride;
+            submitCommands();
+            std::unique_lock<std::mutex> lock(submitMutex_);
+            idleCv_.wait(lock, [this]
+                         { return submitQueue_.empty() && !submitBusy_; });
         }
     }
 
-    void RendererSoft::processPrimitiveAssembly()
+    RendererSoft::~RendererSoft()
     {
-        switch (primitiveType_)
-        {
-        case Primitive_POINT:
-            processPointAssembly();
-            break;
-        case Primitive_LINE:
-            processLineAssembly();
-            break;
-        case Primitive_TRIANGLE:
-            processPolygonAssembly();
-            break;
-        }
+        destroy();
     }
 
-    void RendererSoft::processClipping()
+    void RendererSoft::destroy()
     {
-        size_t primitiveCnt = primitives_.size();
-        for (size_t i = 0; i < primitiveCnt; i++)
+        waitIdle();
+        if (submitThread_.joinable())
         {
-            auto &primitive = primitives_[i];
-            if (primitive.discard)
-                continue;
-            switch (primitiveType_)
-            {
-            case Primitive_POINT:
-                clippingPoint(primitive);
-                /* code */
-                break;
-            case Primitive_LINE:
-                clippingLine(primitive);
-                break;
-            case Primitive_TRIANGLE:
             {
-                // skip clipping if draw triangles with point/line mode
-                if (renderState_->polygonMode != PolygonMode::FILL)
-                {
-                    continue;
-                }
-                std::vector<PrimitiveHolder> appendPrimitives;
-                clippingTriangle(primitive, appendPrimitives);
-                primitives_.insert(primitives_.end(), appendPrimitives.begin(), appendPrimitives.end());
-                break;
-            }
+                std::lock_guard<std::mutex> lock(submitMutex_);
+                submitExit_ = true;
             }
+            submitCv_.notify_all();
+            submitThread_.join();
         }
+        commandList_ = false;
+        replaySamplers_.clear();
+    }
 
-        for (auto &vertex : vertexes_)
+    void RendererSoft::setEnableCommandList(bool enable)
+    {
+        if (enable == commandList_)
         {
-            vertex.discard = true;
+            return;
         }
-
-        for (auto &primitive : primitives_)
+        waitIdle();
+        if (enable)
         {
-            if (primitive.discard)
-                continue;
-
-            switch (primitiveType_)
+            if (!submitThread_.joinable())
             {
-            case Primitive_POINT:
-                vertexes_[primitive.indices[0]].discard = false;
-                break;
-            case Primitive_LINE:
-                vertexes_[primitive.indices[0]].discard = false;
-                vertexes_[primitive.indices[1]].discard = false;
-                break;
-            case Primitive_TRIANGLE:
-                vertexes_[primitive.indices[0]].discard = false;
-                vertexes_[primitive.indices[1]].discard = false;
-                vertexes_[primitive.indices[2]].discard = false;
-                break;
+                submitExit_ = false;
+                submitThread_ = std::thread(&RendererSoft::submitLoop, this);
+            }
+            if (!recordList_)
+            {
+                recordList_ = std::make_unique<CommandListSoft>();
             }
+            recordFbo_ = fbo_;
+            recordFboSnapshot_ = nullptr;
+            recordProgram_ = shaderProgram_;
         }
+        commandList_ = enable;
     }
 
-    void RendererSoft::processPerspectiveDivide()
+    void RendererSoft::setPresentBufferCnt(int cnt)
     {
-        for (auto &vertex : vertexes_)
-        {
-            if (vertex.discard)
-                continue;
-            perspectiveDivideImpl(vertex);
-        }
+        waitIdle();
+        std::lock_guard<std::mutex> lock(submitMutex_);
+        presentBufferCnt_ = std::clamp(cnt, 2, 3);
+        presentBuffers_.clear();
+        presentLatest_ = -1;
+        presentAcquired_ = -1;
     }
 
-    void RendererSoft::processViewportTransform()
+    void RendererSoft::present(std::shared_ptr<Texture> &color)
     {
-        for (auto &vertex : vertexes_)
+        auto *tex = dynamic_cast<TextureSoft<RGBA> *>(color.get());
+        if (!tex)
         {
-            if (vertex.discard)
-                continue;
-            viewportTransformImpl(vertex);
+            return;
         }
-    }
-
-    void RendererSoft::processFaceCulling()
-    {
-        if (primitiveType_ != Primitive_TRIANGLE)
+        framesSubmitted_++;
+        if (!recordingCommands())
+        {
+            presentImpl(*tex->getImage().getAttachmentBuffer());
             return;
+        }
 
-        for (auto &triangle : primitives_)
-        {
-            if (triangle.discard)
-                continue;
-            glm::vec4 &v0 = vertexes_[triangle.indices[0]].fragPos;
-            glm::vec4 &v1 = vertexes_[triangle.indices[1]].fragPos;
-            glm::vec4 &v2 = vertexes_[triangle.indices[2]].fragPos;
+        recordList_->add(Command_Present).color = tex->getImage().getAttachmentBuffer();
+        submitCommands();
 
-            glm::vec3 n = glm::cross(glm::vec3(v1 - v0), glm::vec3(v2 - v0));
-            float area = glm::dot(n, glm::vec3(0, 0, 1));
-            triangle.frontFacing = area > 0;
+        // one ring slot is always free for the frame being written
+        std::unique_lock<std::mutex> lock(submitMutex_);
+        idleCv_.wait(lock, [this]
+                     { return framesSubmitted_ - framesPresented_ < (uint64_t)presentBufferCnt_; });
+    }
 
-            if (renderState_->cullFace)
-                triangle.discard = !triangle.frontFacing;
+    std::shared_ptr<Buffer<RGBA>> RendererSoft::acquirePresentBuffer()
+    {
+        std::lock_guard<std::mutex> lock(submitMutex_);
+        if (presentLatest_ >= 0)
+        {
+            presentAcquired_ = presentLatest_;
         }
+        return presentAcquired_ >= 0 ? presentBuffers_[presentAcquired_] : nullptr;
     }
-    void RendererSoft::processRasterization()
+
+    void RendererSoft::presentImpl(ImageBufferSoft<RGBA> &color)
     {
-        switch (primitiveType_)
+        auto src = color.buffer;
+        int slot = -1;
         {
-        case Primitive_POINT:
-            for (auto &primitive : primitives_)
+            std::lock_guard<std::mutex> lock(submitMutex_);
+            if (src)
             {
-                if (primitive.discard)
+                presentBuffers_.resize(presentBufferCnt_);
+                for (int i = 0; i < presentBufferCnt_ && slot < 0; i++)
                 {
-                    continue;
+                    if (i != presentLatest_ && i != presentAcquired_)
+                    {
+                        slot = i;
+                    }
                 }
-                auto *vert0 = &vertexes_[primitive.indices[0]];
-                rasterizationPoint(vert0, pointSize_);
-            }
-            break;
-        case Primitive_LINE:
-            for (auto &primitive : primitives_)
-            {
-                if (primitive.discard)
+                if (slot < 0)
                 {
-                    continue;
+                    // double buffered and the latest frame was never acquired: replace it
+                    slot = presentLatest_;
+                    presentLatest_ = -1;
                 }
-                auto *vert0 = &vertexes_[primitive.indices[0]];
-                auto *vert1 = &vertexes_[primitive.indices[1]];
-                rasterizationLine(vert0, vert1, renderState_->lineWidth);
-            }
-            break;
-        case Primitive_TRIANGLE:
-            threadQuadCtx_.resize(threadPool_.getThreadCnt());
-            for (auto &ctx : threadQuadCtx_)
-            {
-                ctx.SetVaryingsSize(varyingsAlignedCnt_);
-                ctx.shaderProgram = shaderProgram_->clone();
-                ctx.shaderProgram->prepareFragmentShader();
-
-                // setup derivative
-                DerivativeContext &df_ctx = ctx.shaderProgram->getShaderBuiltin().dfCtx;
-                df_ctx.p0 = ctx.pixels[0].varyingsFrag;
-                df_ctx.p1 = ctx.pixels[1].varyingsFrag;
-                df_ctx.p2 = ctx.pixels[2].varyingsFrag;
-                df_ctx.p3 = ctx.pixels[3].varyingsFrag;
             }
-            rasterizationPolygons(primitives_);
-            threadPool_.waitTasksFinish();
-            break;
         }
-    }
 
-    void RendererSoft::processFragmentShader(glm::vec4 &screenPos,
-                                             bool front_facing,
-                                             void *varyings,
-                                             ShaderProgramSoft *shader)
-    {
-        if (!fboColor_)
+        if (src)
         {
-            return;
+            auto &dst = presentBuffers_[slot];
+            int width = (int)src->getWidth();
+            int height = (int)src->getHeight();
+            if (!dst || dst->getWidth() != width || dst->getHeight() != height)
+            {
+                dst = Buffer<RGBA>::makeLayout(width, height, Layout_Linear);
+            }
+            // tiles no draw touched are presented from the clear value, the target itself stays unwritten
+            bool pending = color.clearPending && !color.multiSample;
+            int span = pending ? color.clearTileSize : width;
+            for (int y = 0; y < height; y++)
+            {
+                RGBA *dstRow = dst->getRawDataPtr() + (size_t)y * width;
+                for (int x0 = 0; x0 < width; x0 += span)
+                {
+                    int x1 = std::min(x0 + span, width);
+                    if (pending && color.isClearPending(x0, y))
+                    {
+                        std::fill(dstRow + x0, dstRow + x1, color.clearValue);
+                    }
+                    else if (src->getLayout() == Layout_Linear)
+                    {
+                        memcpy(dstRow + x0, src->getRawDataPtr() + (size_t)y * width + x0, (size_t)(x1 - x0) * sizeof(RGBA));
+                    }
+                    else
+                    {
+                        for (int x = x0; x < x1; x++)
+                        {
+                            dstRow[x] = *src->get(x, y);
+                        }
+                    }
+                }
+            }
         }
 
-        auto &builtin = shader->getShaderBuiltin();
-        builtin.FragCoord = screenPos;
-        builtin.FrontFacing = front_facing;
-
-        shader->bindFragmentShaderVaryings(varyings);
-        shader->execFragmentShader();
+        {
+            std::lock_guard<std::mutex> lock(submitMutex_);
+            if (src)
+            {
+                presentLatest_ = slot;
+            }
+            framesPresented_++;
+        }
+        idleCv_.notify_all();
     }
 
-    void RendererSoft::processPerSampleOperations(int x, int y, float depth, const glm::vec4 &color, int sample)
+    static inline bool sameAttachment(const FrameBufferAttachment &a, const FrameBufferAttachment &b)
     {
-        // depth test
-        if (!processDepthTest(x, y, depth, sample, false))
-        {
-            return;
-        }
+        return a.tex == b.tex && a.layer == b.layer && a.level == b.level;
+    }
 
-        if (!fboColor_)
+    void RendererSoft::recordDraw()
+    {
+        auto &cmd = recordList_->add(Command_Draw);
+        if (recordFbo_ && recordFboSnapshot_ &&
+            (!sameAttachment(recordFbo_->getColorAttachment(), recordFboSnapshot_->getColorAttachment()) ||
+             !sameAttachment(recordFbo_->getDepthAttachment(), recordFboSnapshot_->getDepthAttachment())))
         {
-            return;
+            recordFboSnapshot_ = std::make_shared<FrameBufferSoft>(*recordFbo_);
+            cmd.frameBuffer = recordFboSnapshot_;
         }
-
-        glm::vec4 color_clamp = glm::clamp(color, 0.f, 1.f);
-
-        // color blending
-        processColorBlending(x, y, color_clamp, sample);
-
-        // write final color to fbo
-        setFrameColor(x, y, color_clamp * 255.f, sample);
     }
 
-    bool RendererSoft::processDepthTest(int x, int y, float depth, int sample, bool skipWrite)
+    void RendererSoft::recordShaderResources(ShaderResources &resources)
     {
-        if (!renderState_->depthTest || !fboDepth_)
+        if (!recordProgram_)
         {
-            return true;
+            return;
         }
+        auto &list = *recordList_;
+        auto &table = getBindingTable(recordBindingTables_, *recordProgram_, resources);
+        auto &cmd = list.add(Command_SetShaderResources);
+        cmd.bindings = list.arena.alloc<UniformBindingSoft>(table.bindings.size());
 
-        // depth clamping
-        depth = glm::clamp(depth, viewport_.absMinDepth, viewport_.absMaxDepth);
-
-        // depth comparison
-        float *zPtr = getFrameDepth(x, y, sample);
-        if (zPtr && DepthTest(depth, *zPtr, renderState_->depthFunc))
+        // block contents are copied, the caller updates them between draws.
+        // versions an earlier command of this list already binds are left out
+        for (auto &resource : table.bindings)
         {
-            // depth attachment writes
-            if (!skipWrite && renderState_->depthMask)
+            if (resource.block)
+            {
+                if (!recordProgram_->recordUniformBinding(resource.location, resource.uniformId,
+                                                          resource.block->getVersion(), recordSerial_))
+                {
+                    continue;
+                }
+                auto &data = resource.block->getBuffer();
+                uint8_t *copy = list.arena.alloc<uint8_t>(data.size());
+                memcpy(copy, data.data(), data.size());
+
+                auto &binding = cmd.bindings[cmd.bindingCnt++];
+                binding = UniformBindingSoft();
+                binding.location = resource.location;
+                binding.data = copy;
+                binding.size = data.size();
+            }
+            else if (resource.sampler)
             {
-                *zPtr = depth;
+                if (!recordProgram_->recordUniformBinding(resource.location, resource.uniformId,
+                                                          resource.sampler->getVersion(), recordSerial_))
+                {
+                    continue;
+                }
+                list.textures.push_back(resource.sampler->getTexture());
+
+                auto &binding = cmd.bindings[cmd.bindingCnt++];
+                binding = UniformBindingSoft();
+                binding.location = resource.location;
+                binding.samplerId = resource.uniformId;
+                binding.textureIdx = (int)list.textures.size() - 1;
             }
-            return true;
         }
-        return false;
     }
 
-    void RendererSoft::processColorBlending(int x, int y, glm::vec4 &color, int sample)
+    void RendererSoft::submitCommands()
     {
-        if (renderState_->blend)
+        if (!recordList_ || recordList_->empty())
         {
-            glm::vec4 &srcColor = color;
-            glm::vec4 dstColor = glm::vec4(0.f);
-            auto *ptr = getFrameColor(x, y, sample);
-            if (ptr)
+            return;
+        }
+        // replayed in the lane it was recorded in, e.g. IBL precompute stays behind frame work
+        recordList_->lane = ThreadPool::currentLane();
+        recordSerial_++;
+        {
+            std::lock_guard<std::mutex> lock(submitMutex_);
+            submitQueue_.push_back(std::move(recordList_));
+            if (!freeLists_.empty())
             {
-                dstColor = glm::vec4(*ptr) / 255.f;
+                recordList_ = std::move(freeLists_.back());
+                freeLists_.pop_back();
             }
-            color = calcBlendColor(srcColor, dstColor, renderState_->blendParams);
         }
-    }
-
-    void RendererSoft::processPointAssembly()
-    {
-        primitives_.resize(vao_->indicesCnt);
-        for (int idx = 0; idx < primitives_.size(); idx++)
+        if (!recordList_)
         {
-            auto &point = primitives_[idx];
-            point.indices[0] = vao_->indices[idx];
-            point.discard = false;
+            recordList_ = std::make_unique<CommandListSoft>();
         }
+        submitCv_.notify_one();
     }
 
-    void RendererSoft::processLineAssembly()
+    void RendererSoft::submitLoop()
     {
-        primitives_.resize(vao_->indicesCnt / 2);
-        for (int idx = 0; idx < primitives_.size(); idx++)
+        while (true)
         {
-            auto &line = primitives_[idx];
-            line.indices[0] = vao_->indices[idx * 2];
-            line.indices[1] = vao_->indices[idx * 2 + 1];
-            line.discard = false;
-        }
-    }
+            std::unique_ptr<CommandListSoft> list;
+            {
+                std::unique_lock<std::mutex> lock(submitMutex_);
+                submitCv_.wait(lock, [this]
+                               { return submitExit_ || !submitQueue_.empty(); });
+                if (submitQueue_.empty())
+                {
+                    return;
+                }
+                list = std::move(submitQueue_.front());
+                submitQueue_.pop_front();
+                submitBusy_ = true;
+            }
 
-    void RendererSoft::processPolygonAssembly()
-    {
-        primitives_.resize(vao_->indicesCnt / 3);
-        for (int idx = 0; idx < primitives_.size(); idx++)
-        {
-            auto &triangle = primitives_[idx];
-            triangle.indices[0] = vao_->indices[idx * 3];
-            triangle.indices[1] = vao_->indices[idx * 3 + 1];
-            triangle.indices[2] = vao_->indices[idx * 3 + 2];
-            triangle.discard = false;
-        }
-    }
+            {
+                ThreadPool::LaneScope lane(list->lane);
+                executeCommands(*list);
+            }
+            list->reset();
 
-    void RendererSoft::clippingPoint(PrimitiveHolder &point)
-    {
-        point.discard = (vertexes_[point.indices[0]].clipMask != 0);
+            {
+                std::lock_guard<std::mutex> lock(submitMutex_);
+                freeLists_.push_back(std::move(list));
+                submitBusy_ = false;
+            }
+            idleCv_.notify_all();
+        }
     }
 
-    void RendererSoft::clippingLine(PrimitiveHolder &line, bool postVertexProcess)
+    void RendererSoft::executeCommands(CommandListSoft &list)
     {
-        VertexHolder *v0 = &vertexes_[line.indices[0]];
-        VertexHolder *v1 = &vertexes_[line.indices[1]];
-        auto clipMaskV0 = v0->clipMask;
-        auto clipMaskV1 = v1->clipMask;
-        auto clipPosV0 = v0->clipPos;
-        auto clipPosV1 = v1->clipPos;
-
-        bool fullClip = false;
-        float t0 = 0.f;
-        float t1 = 1.f;
-
-        int mask = clipMaskV0 | clipMaskV1;
-        if (mask != 0)
+        for (auto &cmd : list.commands)
         {
-            for (int i = 0; i < 6; i++)
+            switch (cmd.type)
             {
-                if (mask & FrustumClipMaskArray[i])
+            case Command_BeginRenderPass:
+                boundFbo_ = cmd.frameBuffer;
+                beginRenderPass(cmd.frameBuffer, cmd.clearStates);
+                break;
+            case Command_SetViewPort:
+                setViewPort(cmd.viewport.x, cmd.viewport.y, cmd.viewport.z, cmd.viewport.w);
+                break;
+            case Command_SetVertexArrayObject:
+                boundVao_ = cmd.vao;
+                setVertexArrayObject(cmd.vao);
+                break;
+            case Command_SetShaderProgram:
+                boundProgram_ = cmd.program;
+                setShaderProgram(cmd.program);
+                break;
+            case Command_SetShaderResources:
+                if (!shaderProgram_)
                 {
-                    float d0 = glm::dot(FrustumClipPlane[i], clipPosV0);
-                    float d1 = glm::dot(FrustumClipPlane[i], clipPosV1);
-
-                    if (d0 < 0 && d1 < 0)
+                    break;
+                }
+                for (int i = 0; i < cmd.bindingCnt; i++)
+                {
+                    auto &binding = cmd.bindings[i];
+                    if (binding.samplerId < 0)
                     {
-                        fullClip = true;
-                        break;
+                        shaderProgram_->bindUniformBlockBuffer((void *)binding.data, binding.size, binding.location);
+                        continue;
                     }
-                    else if (d0 < 0)
+                    // the caller keeps retargeting its samplers, replay binds private ones
+                    auto &texture = list.textures[binding.textureIdx];
+                    if (!texture)
                     {
-                        float t = -d0 / (d1 - d0);
-                        t0 = std::max(t0, t);
+                        continue;
                     }
-                    else
+                    auto &sampler = replaySamplers_[binding.samplerId];
+                    if (!sampler || sampler->texType() != texture->type)
                     {
-                        float t = d0 / (d0 - d1);
-                        t1 = std::min(t1, t);
+                        sampler = UniformSamplerSoft::createSampler(texture->type, texture->format);
                     }
+                    sampler->setTexture(texture);
+                    shaderProgram_->bindUniformSampler(sampler, binding.location);
+                }
+                break;
+            case Command_SetPipelineStates:
+                boundStates_ = cmd.states;
+                setPipelineStates(cmd.states);
+                break;
+            case Command_Draw:
+                if (cmd.frameBuffer)
+                {
+                    boundFbo_ = cmd.frameBuffer;
+                    fbo_ = dynamic_cast<FrameBufferSoft *>(boundFbo_.get());
                 }
+                draw();
+                break;
+            case Command_EndRenderPass:
+                endRenderPass();
+                break;
+            case Command_Present:
+                presentImpl(*cmd.color);
+                break;
             }
         }
+    }
 
-        if (fullClip)
+    void RendererSoft::processVertexShader()
+    {
+        // depth only passes consume no varyings, run the position entry if the shader has one
+        positionOnly_ = depthOnlyPass_ && shaderProgram_->hasVertexShaderPosition();
+
+        varyingsCnt_ = positionOnly_ ? 0 : shaderProgram_->getShaderVaryingsSize() / sizeof(float);
+        varyingsAlignedSize_ = AlignedMemory::getAlignedSize(varyingsCnt_ * sizeof(float));
+        varyingsAlignedCnt_ = varyingsAlignedSize_ / sizeof(float);
+
+        varyings_ = frameArena_.alloc<float>(vao_->vertexCnt * varyingsAlignedCnt_);
+        float *varyingBuffer = varyings_;
+
+        size_t vertexCnt = vao_->vertexCnt;
+        vertexes_.resize(vertexCnt);
+
+        // small draws are not worth the task overhead
+        if (vertexCnt <= vertexChunkSize_)
         {
-            line.discard = true;
+            vertexShaderChunk(0, vertexCnt, varyingBuffer, shaderProgram_);
             return;
         }
 
-        if (clipMaskV0)
+        // chunks of at least vertexChunkSize_, every worker shades with its own program clone
+#ifdef RASTER_MULTI_THREAD
+        threadPool_.parallelFor(0, vertexCnt, vertexChunkSize_, [this](size_t begin, size_t end, size_t thread_id)
+                                { vertexShaderChunk(begin, end, varyings_, threadPrograms_[thread_id].get()); });
+#else
+        vertexShaderChunk(0, vertexCnt, varyingBuffer, shaderProgram_);
+#endif
+    }
+
+    void RendererSoft::vertexShaderChunk(size_t begin, size_t end, float *varyingBuffer, ShaderProgramSoft *program)
+    {
+        uint8_t *vertexPtr = vao_->vertexes.data() + begin * vao_->vertexStride;
+        for (size_t i = begin; i < end; i++)
         {
-            line.indices[0] = clippingNewVertex(line.indices[0], line.indices[1], t0, postVertexProcess);
+            VertexHolder &holder = vertexes_[i];
+            holder.discard = false;
+            holder.index = i;
+            holder.vertex = vertexPtr;
+            holder.varyings = (varyingsAlignedSize_ > 0) ? (varyingBuffer + i * varyingsAlignedCnt_) : nullptr;
+            vertexShaderImpl(holder, program);
+            vertexPtr += vao_->vertexStride;
         }
-        if (clipMaskV1)
+
+        // point size of the last vertex, same as serial shading
+        if (end == vao_->vertexCnt)
         {
-            line.indices[1] = clippingNewVertex(line.indices[0], line.indices[1], t1, postVertexProcess);
+            pointSize_ = program->getShaderBuiltin().PointSize;
         }
     }
 
-    void RendererSoft::clippingTriangle(PrimitiveHolder &triangle, std::vector<PrimitiveHolder> &appendPrimitives)
+    void RendererSoft::setupThreadPrograms()
     {
-        auto *v0 = &vertexes_[triangle.indices[0]];
-        auto *v1 = &vertexes_[triangle.indices[1]];
-        auto *v2 = &vertexes_[triangle.indices[2]];
-
-        int mask = v0->clipMask | v1->clipMask | v2->clipMask;
-        if (mask == 0)
+        // clones share uniforms and defines with the bound program, keep them while it stays bound
+        if (threadProgramsId_ == shaderProgram_->getId() && threadPrograms_.size() == threadPool_.getThreadCnt())
         {
             return;
         }
 
-        bool fullClip = false;
-        std::vector<size_t> indicesIn;
-        std::vector<size_t> indicesOut;
-
-        indicesIn.push_back(v0->index);
-        indicesIn.push_back(v1->index);
-        indicesIn.push_back(v2->index);
-
-        for (int planeIdx = 0; planeIdx < 6; planeIdx++)
+        // switching programs reuses the clones made the last time the program was bound
+        auto &set = threadProgramCache_[shaderProgram_->getId()];
+        set.lastUsePass = renderPassCnt_;
+        if (set.programs.size() != threadPool_.getThreadCnt())
         {
-            if (mask & FrustumClipMaskArray[planeIdx])
+            set.programs.resize(threadPool_.getThreadCnt());
+            for (auto &program : set.programs)
             {
-                if (indicesIn.size() < 3)
-                {
-                    fullClip = true;
-                    break;
-                }
-                indicesOut.clear();
-                size_t idxPre = indicesIn[0];
-                float dPre = glm::dot(FrustumClipPlane[planeIdx], vertexes_[idxPre].clipPos);
-
-                indicesIn.push_back(idxPre);
-                for (int i = 1; i < indicesIn.size(); i++)
-                {
-                    size_t idx = indicesIn[i];
-                    float d = glm::dot(FrustumClipPlane[planeIdx], vertexes_[idx].clipPos);
-
-                    if (dPre >= 0)
-                    {
-                        indicesOut.push_back(idxPre);
-                    }
-
-                    if (std::signbit(dPre) != std::signbit(d))
-                    {
-                        float t = d < 0 ? dPre / (dPre - d) : -dPre / (d - dPre);
-                        // create new vertex
-                        auto vertIdx = clippingNewVertex(idxPre, idx, t);
-                        indicesOut.push_back(vertIdx);
-                    }
-
-                    idxPre = idx;
-                    dPre = d;
-                }
-
-                std::swap(indicesIn, indicesOut);
+                program = shaderProgram_->clone();
+                program->prepareFragmentShader();
             }
         }
-
-        if (fullClip || indicesIn.empty())
+        for (auto &program : set.programs)
         {
-            triangle.discard = true;
-            return;
+            program->bindUniformBuffer(shaderProgram_->getUniformBuffer());
         }
+        threadProgramsId_ = shaderProgram_->getId();
+        threadPrograms_ = set.programs;
+    }
 
-        triangle.indices[0] = indicesIn[0];
-        triangle.indices[1] = indicesIn[1];
-        triangle.indices[2] = indicesIn[2];
+    void RendererSoft::evictPassCaches()
+    {
+        // program ids are never reused, entries of destroyed programs and resources only age out
+        renderPassCnt_++;
+        evictBindingTables(bindingTables_);
+        for (auto it = threadProgramCache_.begin(); it != threadProgramCache_.end();)
+        {
+            if (renderPassCnt_ - it->second.lastUsePass > passCacheMaxAge_)
+            {
+                if (it->first == threadProgramsId_)
+                {
+                    threadProgramsId_ = -1;
+                    threadPrograms_.clear();
+                }
+                it = threadProgramCache_.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
 
-        for (int i = 3; i < indicesIn.size(); i++)
+    void RendererSoft::evictBindingTables(BindingTableCache &cache)
+    {
+        cache.passCnt++;
+        for (auto it = cache.tables.begin(); it != cache.tables.end();)
         {
-            appendPrimitives.emplace_back();
-            PrimitiveHolder &ph = appendPrimitives.back();
-            ph.discard = false;
-            ph.indices[0] = indicesIn[0];
-            ph.indices[1] = indicesIn[i - 1];
-            ph.indices[2] = indicesIn[i];
-            ph.frontFacing = triangle.frontFacing;
+            if (cache.passCnt - it->second.lastUsePass > passCacheMaxAge_)
+            {
+                if (&it->second == cache.lastTable)
+                {
+                    cache.lastTable = nullptr;
+                }
+                it = cache.tables.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
         }
     }
 
-    void RendererSoft::rasterizationPolygons(std::vector<PrimitiveHolder> &primitives)
+    void RendererSoft::processPrimitiveAssembly()
     {
-        switch (renderState_->polygonMode)
+        switch (primitiveType_)
         {
-        case PolygonMode::POINT:
-            rasterizationPolygonsPoint(primitives);
+        case Primitive_POINT:
+            processPointAssembly();
             break;
-        case PolygonMode::LINE:
-            rasterizationPolygonsLine(primitives);
+        case Primitive_LINE:
+            processLineAssembly();
             break;
-        case PolygonMode::FILL:
-            rasterizationPolygonsTriangle(primitives);
+        case Primitive_TRIANGLE:
+            processPolygonAssembly();
             break;
         }
     }
 
-    void RendererSoft::rasterizationPolygonsPoint(std::vector<PrimitiveHolder> &primitives)
+    void RendererSoft::processClipping()
     {
+        size_t primitiveCnt = primitives_.size();
+        for (size_t i = 0; i < primitiveCnt; i++)
+        {
+            auto &primitive = primitives_[i];
+            if (primitive.discard)
+                continue;
+            switch (primitiveType_)
+            {
+            case Primitive_POINT:
+                clippingPoint(primitive);
+                /* code */
+                break;
+            case Primitive_LINE:
+                clippingLine(primitive);
+                break;
+            case Primitive_TRIANGLE:
+            {
+                // skip clipping if draw triangles with point/line mode
+                if (renderState_->polygonMode != PolygonMode::FILL)
+                {
+                    continue;
+                }
+                clippedPrimitives_.clear();
+                clippingTriangle(primitive, clippedPrimitives_);
+                primitives_.insert(primitives_.end(), clippedPrimitives_.begin(), clippedPrimitives_.end());
+                break;
+            }
+            }
+        }
+
+        for (auto &vertex : vertexes_)
+        {
+            vertex.discard = true;
+        }
+
+        for (auto &primitive : primitives_)
+        {
+            if (primitive.discard)
+                continue;
+
+            switch (primitiveType_)
+            {
+            case Primitive_POINT:
+                vertexes_[primitive.indices[0]].discard = false;
+                break;
+            case Primitive_LINE:
+                vertexes_[primitive.indices[0]].discard = false;
+                vertexes_[primitive.indices[1]].discard = false;
+                break;
+            case Primitive_TRIANGLE:
+                vertexes_[primitive.indices[0]].discard = false;
+                vertexes_[primitive.indices[1]].discard = false;
+                vertexes_[primitive.indices[2]].discard = false;
+                break;
+            }
+        }
+    }
+
+    void RendererSoft::processPerspectiveDivide()
+    {
+        for (auto &vertex : vertexes_)
+        {
+            if (vertex.discard)
+                continue;
+            perspectiveDivideImpl(vertex);
+        }
+    }
+
+    void RendererSoft::processViewportTransform()
+    {
+        for (auto &vertex : vertexes_)
+        {
+            if (vertex.discard)
+                continue;
+            viewportTransformImpl(vertex);
+        }
+    }
+
+    void RendererSoft::processRasterization()
+    {
+        threadQuadCtx_.resize(threadPool_.getThreadCnt());
+        for (size_t i = 0; i < threadQuadCtx_.size(); i++)
+        {
+            auto &ctx = threadQuadCtx_[i];
+            if (depthOnlyPass_)
+            {
+                continue;
+            }
+            ctx.SetVaryingsSize(varyingsAlignedCnt_);
+            ctx.shaderProgram = threadPrograms_[i];
+
+            // setup derivative
+            DerivativeContext &df_ctx = ctx.shaderProgram->getShaderBuiltin().dfCtx;
+            df_ctx.p0 = ctx.pixels[0].varyingsFrag;
+            df_ctx.p1 = ctx.pixels[1].varyingsFrag;
+            df_ctx.p2 = ctx.pixels[2].varyingsFrag;
+            df_ctx.p3 = ctx.pixels[3].varyingsFrag;
+        }
+
+        switch (primitiveType_)
+        {
+        case Primitive_POINT:
+        case Primitive_LINE:
+            rasterizationTiles(primitives_, primitiveType_);
+            break;
+        case Primitive_TRIANGLE:
+            // merging micro triangles needs single sample shading with color output
+            microMerge_ = rasterSamples_ == 1 && !visibilityPass_ && !depthOnlyPass_;
+            rasterizationPolygons(primitives_);
+            break;
+        }
+    }
+
+    void RendererSoft::processFragmentShader(glm::vec4 &screenPos,
+                                             bool front_facing,
+                                             void *varyings,
+                                             ShaderProgramSoft *shader)
+    {
+        if (!fboColor_)
+        {
+            return;
+        }
+
+        auto &builtin = shader->getShaderBuiltin();
+        builtin.FragCoord = screenPos;
+        builtin.FrontFacing = front_facing;
+
+        shader->bindFragmentShaderVaryings(varyings);
+        shader->execFragmentShader();
+    }
+
+    void RendererSoft::processFragmentShaderBatch(PixelQuadContext &quad, size_t varyingsCnt, ShaderProgramSoft *shader)
+    {
+        if (!fboColor_)
+        {
+            return;
+        }
+
+        FragmentBatch &batch = quad.batch;
+        batch.mask = 0;
+        batch.frontFacing = quad.frontFacing;
+
+        alignas(16) float coord[4][BatchLanes];
+        for (int i = 0; i < BatchLanes; i++)
+        {
+            auto &pixel = quad.pixels[i];
+            if (pixel.inside)
+            {
+                batch.mask |= 1 << i;
+            }
+            for (int c = 0; c < 4; c++)
+            {
+                coord[c][i] = pixel.sampleShading->position[c];
+            }
+        }
+        batch.fragCoord = BatchVec4(BatchFloat::load(coord[0]), BatchFloat::load(coord[1]),
+                                    BatchFloat::load(coord[2]), BatchFloat::load(coord[3]));
+        batch.transposeVaryings(varyingsCnt);
+
+        shader->getShaderBuiltin().FrontFacing = quad.frontFacing;
+        shader->execFragmentShaderBatch(batch);
+    }
+
+    bool RendererSoft::processDepthTest(int x, int y, float depth, int sample, bool skipWrite)
+    {
+        if (!renderState_->depthTest || !fboDepth_)
+        {
+            return true;
+        }
+
+        // depth clamping
+        depth = glm::clamp(depth, viewport_.absMinDepth, viewport_.absMaxDepth);
+
+        // depth comparison, a uniform multi-sample pixel is only expanded by the write
+        float stored;
+        if (readFrameDepth(x, y, sample, stored) && DepthTest(depth, stored, renderState_->depthFunc))
+        {
+            // depth attachment writes
+            if (!skipWrite && renderState_->depthMask)
+            {
+                *getFrameDepth(x, y, sample) = depth;
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void RendererSoft::processPointAssembly()
+    {
+        primitives_.resize(vao_->indicesCnt);
+        for (int idx = 0; idx < primitives_.size(); idx++)
+        {
+            auto &point = primitives_[idx];
+            point.indices[0] = vao_->indices[idx];
+            point.discard = false;
+        }
+    }
+
+    void RendererSoft::processLineAssembly()
+    {
+        primitives_.resize(vao_->indicesCnt / 2);
+        for (int idx = 0; idx < primitives_.size(); idx++)
+        {
+            auto &line = primitives_[idx];
+            line.indices[0] = vao_->indices[idx * 2];
+            line.indices[1] = vao_->indices[idx * 2 + 1];
+            line.discard = false;
+        }
+    }
+
+    void RendererSoft::processPolygonAssembly()
+    {
+        // assembly, trivial frustum reject and face culling in one pass, survivors are packed to the front
+        size_t triangleCnt = vao_->indicesCnt / 3;
+        primitives_.resize(triangleCnt);
+        const int32_t *indices = vao_->indices.data();
+        int cullMask = renderState_->cullFace ? 0 : 0xFF;
+        size_t outCnt = 0;
+        size_t idx = 0;
+
+#ifdef SOFTGL_SIMD_OPT
+        // 8 triangles per iteration, vertex fields are gathered with the VertexHolder stride.
+        // gather offsets are 32 bit, larger vertex buffers take the scalar loop
+        size_t simdTriangleCnt = vertexes_.size() * sizeof(VertexHolder) <= (size_t)INT32_MAX ? triangleCnt : 0;
+        const char *vertexBase = reinterpret_cast<const char *>(vertexes_.data());
+        const int *clipMaskBase = reinterpret_cast<const int *>(vertexBase + offsetof(VertexHolder, clipMask));
+        const float *clipPosBase = reinterpret_cast<const float *>(vertexBase + offsetof(VertexHolder, clipPos));
+        const __m256i stride = _mm256_set1_epi32(sizeof(VertexHolder));
+        const __m256i triangleOffset = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+        const __m256i zero = _mm256_setzero_si256();
+        for (; idx + 8 <= simdTriangleCnt; idx += 8)
+        {
+            __m256i outside = _mm256_set1_epi32(-1);
+            __m256 x[3], y[3], w[3];
+            for (int k = 0; k < 3; k++)
+            {
+                __m256i vertIdx = _mm256_i32gather_epi32(indices + idx * 3 + k, triangleOffset, 4);
+                __m256i offset = _mm256_mullo_epi32(vertIdx, stride);
+                outside = _mm256_and_si256(outside, _mm256_i32gather_epi32(clipMaskBase, offset, 1));
+                x[k] = _mm256_i32gather_ps(clipPosBase, offset, 1);
+                y[k] = _mm256_i32gather_ps(clipPosBase + 1, offset, 1);
+                w[k] = _mm256_i32gather_ps(clipPosBase + 3, offset, 1);
+            }
+
+            // all vertices outside the same plane
+            int rejectBits = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(outside, zero))) ^ 0xFF;
+
+            // homogeneous signed area, same sign as the screen space area of the visible part
+            __m256 det = _mm256_mul_ps(x[0], _mm256_sub_ps(_mm256_mul_ps(y[1], w[2]), _mm256_mul_ps(y[2], w[1])));
+            det = _mm256_add_ps(det, _mm256_mul_ps(x[1], _mm256_sub_ps(_mm256_mul_ps(y[2], w[0]), _mm256_mul_ps(y[0], w[2]))));
+            det = _mm256_add_ps(det, _mm256_mul_ps(x[2], _mm256_sub_ps(_mm256_mul_ps(y[0], w[1]), _mm256_mul_ps(y[1], w[0]))));
+            int frontBits = _mm256_movemask_ps(_mm256_cmp_ps(det, _mm256_setzero_ps(), _CMP_GT_OQ));
+
+            int keepBits = ~rejectBits & (frontBits | cullMask) & 0xFF;
+            while (keepBits)
+            {
+                int lane = std::countr_zero((unsigned)keepBits);
+                keepBits &= keepBits - 1;
+                const int32_t *triIndices = indices + (idx + lane) * 3;
+                auto &triangle = primitives_[outCnt++];
+                triangle.discard = false;
+                triangle.frontFacing = (frontBits >> lane) & 1;
+                triangle.indices[0] = triIndices[0];
+                triangle.indices[1] = triIndices[1];
+                triangle.indices[2] = triIndices[2];
+            }
+        }
+#endif
+
+        for (; idx < triangleCnt; idx++)
+        {
+            const int32_t *triIndices = indices + idx * 3;
+            auto &v0 = vertexes_[triIndices[0]];
+            auto &v1 = vertexes_[triIndices[1]];
+            auto &v2 = vertexes_[triIndices[2]];
+            if (v0.clipMask & v1.clipMask & v2.clipMask)
+            {
+                continue;
+            }
+
+            const glm::vec4 &p0 = v0.clipPos;
+            const glm::vec4 &p1 = v1.clipPos;
+            const glm::vec4 &p2 = v2.clipPos;
+            float det = p0.x * (p1.y * p2.w - p2.y * p1.w);
+            det += p1.x * (p2.y * p0.w - p0.y * p2.w);
+            det += p2.x * (p0.y * p1.w - p1.y * p0.w);
+            bool frontFacing = det > 0;
+            if (!frontFacing && !cullMask)
+            {
+                continue;
+            }
+
+            auto &triangle = primitives_[outCnt++];
+            triangle.discard = false;
+            triangle.frontFacing = frontFacing;
+            triangle.indices[0] = triIndices[0];
+            triangle.indices[1] = triIndices[1];
+            triangle.indices[2] = triIndices[2];
+        }
+
+        primitives_.resize(outCnt);
+    }
+
+    void RendererSoft::clippingPoint(PrimitiveHolder &point)
+    {
+        point.discard = (vertexes_[point.indices[0]].clipMask != 0);
+    }
+
+    void RendererSoft::clippingLine(PrimitiveHolder &line, bool postVertexProcess)
+    {
+        VertexHolder *v0 = &vertexes_[line.indices[0]];
+        VertexHolder *v1 = &vertexes_[line.indices[1]];
+        auto clipMaskV0 = v0->clipMask;
+        auto clipMaskV1 = v1->clipMask;
+        auto clipPosV0 = v0->clipPos;
+        auto clipPosV1 = v1->clipPos;
+
+        bool fullClip = false;
+        float t0 = 0.f;
+        float t1 = 1.f;
+
+        int mask = clipMaskV0 | clipMaskV1;
+        if (mask != 0)
+        {
+            for (int i = 0; i < 6; i++)
+            {
+                if (mask & FrustumClipMaskArray[i])
+                {
+                    float d0 = glm::dot(FrustumClipPlane[i], clipPosV0);
+                    float d1 = glm::dot(FrustumClipPlane[i], clipPosV1);
+
+                    if (d0 < 0 && d1 < 0)
+                    {
+                        fullClip = true;
+                        break;
+                    }
+                    else if (d0 < 0)
+                    {
+                        float t = -d0 / (d1 - d0);
+                        t0 = std::max(t0, t);
+                    }
+                    else
+                    {
+                        float t = d0 / (d0 - d1);
+                        t1 = std::min(t1, t);
+                    }
+                }
+            }
+        }
+
+        if (fullClip)
+        {
+            line.discard = true;
+            return;
+        }
+
+        if (clipMaskV0)
+        {
+            line.indices[0] = clippingNewVertex(line.indices[0], line.indices[1], t0, postVertexProcess);
+        }
+        if (clipMaskV1)
+        {
+            line.indices[1] = clippingNewVertex(line.indices[0], line.indices[1], t1, postVertexProcess);
+        }
+    }
+
+    void RendererSoft::clippingTriangle(PrimitiveHolder &triangle, std::vector<PrimitiveHolder> &appendPrimitives)
+    {
+        auto *v0 = &vertexes_[triangle.indices[0]];
+        auto *v1 = &vertexes_[triangle.indices[1]];
+        auto *v2 = &vertexes_[triangle.indices[2]];
+
+        int mask = v0->clipMask | v1->clipMask | v2->clipMask;
+        if (mask == 0)
+        {
+            return;
+        }
+
+        // inside the guard band the rasterizer only visits pixels of the viewport, no clipping needed
+        glm::vec4 planes[6];
+        for (int i = 0; i < 6; i++)
+        {
+            planes[i] = FrustumClipPlane[i];
+        }
+        if (guardBand_)
+        {
+            mask = v0->guardBandMask | v1->guardBandMask | v2->guardBandMask;
+            if (mask == 0)
+            {
+                return;
+            }
+            planes[0].w = planes[1].w = viewport_.guardBandX;
+            planes[2].w = planes[3].w = viewport_.guardBandY;
+        }
+
+        // every plane adds at most one vertex, plus one slot to close the polygon
+        const int maxClipVertexes = 3 + 6 + 1;
+        bool fullClip = false;
+        size_t indicesBuffer[2][maxClipVertexes];
+        size_t *indicesIn = indicesBuffer[0];
+        size_t *indicesOut = indicesBuffer[1];
+        int inCnt = 3;
+        int outCnt = 0;
+
+        indicesIn[0] = v0->index;
+        indicesIn[1] = v1->index;
+        indicesIn[2] = v2->index;
+
+        for (int planeIdx = 0; planeIdx < 6; planeIdx++)
+        {
+            if (mask & FrustumClipMaskArray[planeIdx])
+            {
+                if (inCnt < 3)
+                {
+                    fullClip = true;
+                    break;
+                }
+                outCnt = 0;
+                size_t idxPre = indicesIn[0];
+                float dPre = glm::dot(planes[planeIdx], vertexes_[idxPre].clipPos);
+
+                indicesIn[inCnt] = idxPre;
+                for (int i = 1; i <= inCnt; i++)
+                {
+                    size_t idx = indicesIn[i];
+                    float d = glm::dot(planes[planeIdx], vertexes_[idx].clipPos);
+
+                    if (dPre >= 0)
+                    {
+                        indicesOut[outCnt++] = idxPre;
+                    }
+
+                    if (std::signbit(dPre) != std::signbit(d))
+                    {
+                        float t = d < 0 ? dPre / (dPre - d) : -dPre / (d - dPre);
+                        // create new vertex
+                        auto vertIdx = clippingNewVertex(idxPre, idx, t);
+                        indicesOut[outCnt++] = vertIdx;
+                    }
+
+                    idxPre = idx;
+                    dPre = d;
+                }
+
+                std::swap(indicesIn, indicesOut);
+                inCnt = outCnt;
+            }
+        }
+
+        if (fullClip || inCnt < 3)
+        {
+            triangle.discard = true;
+            return;
+        }
+
+        triangle.indices[0] = indicesIn[0];
+        triangle.indices[1] = indicesIn[1];
+        triangle.indices[2] = indicesIn[2];
+
+        for (int i = 3; i < inCnt; i++)
+        {
+            appendPrimitives.emplace_back();
+            PrimitiveHolder &ph = appendPrimitives.back();
+            ph.discard = false;
+            ph.indices[0] = indicesIn[0];
+            ph.indices[1] = indicesIn[i - 1];
+            ph.indices[2] = indicesIn[i];
+            ph.frontFacing = triangle.frontFacing;
+        }
+    }
+
+    void RendererSoft::rasterizationPolygons(std::vector<PrimitiveHolder> &primitives)
+    {
+        switch (renderState_->polygonMode)
+        {
+        case PolygonMode::POINT:
+            rasterizationPolygonsPoint(primitives);
+            break;
+        case PolygonMode::LINE:
+            rasterizationPolygonsLine(primitives);
+            break;
+        case PolygonMode::FILL:
+            rasterizationPolygonsTriangle(primitives);
+            break;
+        }
+    }
+
+    void RendererSoft::rasterizationPolygonsPoint(std::vector<PrimitiveHolder> &primitives)
+    {
+        // vertices shared by several triangles are drawn once
+        polygonPrimitives_.clear();
+        vertexDrawn_.assign(vertexes_.size(), 0);
         for (auto &triangle : primitives)
         {
-            if (triangle.discard)
+            if (triangle.discard)
+            {
+                continue;
+            }
+            for (size_t idx : triangle.indices)
+            {
+                if (vertexDrawn_[idx])
+                {
+                    continue;
+                }
+                vertexDrawn_[idx] = 1;
+
+                PrimitiveHolder point;
+                point.discard = false;
+                point.frontFacing = triangle.frontFacing;
+                point.indices[0] = idx;
+
+                // clipping
+                clippingPoint(point);
+                if (!point.discard)
+                {
+                    polygonPrimitives_.push_back(point);
+                }
+            }
+        }
+
+        rasterizationTiles(polygonPrimitives_, Primitive_POINT);
+    }
+
+    void RendererSoft::rasterizationPolygonsLine(std::vector<PrimitiveHolder> &primitives)
+    {
+        // open addressing set of edges (vertex index pairs), shared edges are drawn once
+        size_t tableSize = 64;
+        while (tableSize < primitives.size() * 3 * 2)
+        {
+            tableSize <<= 1;
+        }
+        const uint64_t emptyKey = std::numeric_limits<uint64_t>::max();
+        edgeTable_.assign(tableSize, emptyKey);
+
+        polygonPrimitives_.clear();
+        for (auto &triangle : primitives)
+        {
+            if (triangle.discard)
+            {
+                continue;
+            }
+            for (size_t i = 0; i < 3; i++)
+            {
+                size_t idx0 = triangle.indices[i];
+                size_t idx1 = triangle.indices[(i + 1) % 3];
+                uint64_t key = ((uint64_t)std::min(idx0, idx1) << 32) | (uint64_t)std::max(idx0, idx1);
+                size_t slot = (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & (tableSize - 1);
+                while (edgeTable_[slot] != emptyKey && edgeTable_[slot] != key)
+                {
+                    slot = (slot + 1) & (tableSize - 1);
+                }
+                if (edgeTable_[slot] == key)
+                {
+                    continue;
+                }
+                edgeTable_[slot] = key;
+
+                PrimitiveHolder line;
+                line.discard = false;
+                line.frontFacing = triangle.frontFacing;
+                line.indices[0] = idx0;
+                line.indices[1] = idx1;
+
+                // clipping
+                clippingLine(line, true);
+                if (!line.discard)
+                {
+                    polygonPrimitives_.push_back(line);
+                }
+            }
+        }
+
+        rasterizationTiles(polygonPrimitives_, Primitive_LINE);
+    }
+
+    void RendererSoft::rasterizationPolygonsTriangle(std::vector<PrimitiveHolder> &primitives)
+    {
+        rasterizationTiles(primitives, Primitive_TRIANGLE);
+    }
+
+    void RendererSoft::rasterizationTiles(std::vector<PrimitiveHolder> &primitives, PrimitiveType type)
+    {
+        rasterPrimitives_ = &primitives;
+        rasterPrimitiveType_ = type;
+
+        setupRasterTiles();
+        switch (type)
+        {
+        case Primitive_POINT:
+            binningPoints(primitives);
+            break;
+        case Primitive_LINE:
+            binningLines(primitives);
+            break;
+        case Primitive_TRIANGLE:
+            binningTriangles(primitives);
+            break;
+        }
+
+        for (auto &tile : rasterTiles_)
+        {
+            if (!tile.primitives.empty())
+            {
+                markResolveTile(tile);
+            }
+        }
+
+        // tile cost varies with coverage, single tile leaves keep the stealing fine grained
+        auto rasterize = [this](size_t begin, size_t end, size_t thread_id)
+        {
+            for (size_t idx = begin; idx < end; idx++)
+            {
+                if (!rasterTiles_[idx].primitives.empty())
+                {
+                    rasterizationTile(rasterTiles_[idx], threadQuadCtx_[thread_id]);
+                }
+            }
+        };
+#ifdef RASTER_MULTI_THREAD
+        threadPool_.parallelFor(0, rasterTiles_.size(), 1, rasterize);
+#else
+        rasterize(0, rasterTiles_.size(), 0);
+#endif
+    }
+
+    void RendererSoft::setupRasterTiles()
+    {
+        int tileCntX = ((int)viewport_.width + rasterTileSize_ - 1) / rasterTileSize_;
+        int tileCntY = ((int)viewport_.height + rasterTileSize_ - 1) / rasterTileSize_;
+        if (tileCntX != rasterTileCntX_ || tileCntY != rasterTileCntY_)
+        {
+            rasterTileCntX_ = tileCntX;
+            rasterTileCntY_ = tileCntY;
+            rasterTiles_.resize(tileCntX * tileCntY);
+            for (int ty = 0; ty < tileCntY; ty++)
+            {
+                for (int tx = 0; tx < tileCntX; tx++)
+                {
+                    auto &tile = rasterTiles_[ty * tileCntX + tx];
+                    tile.x = tx * rasterTileSize_;
+                    tile.y = ty * rasterTileSize_;
+                    tile.width = std::min(rasterTileSize_, (int)viewport_.width - tile.x);
+                    tile.height = std::min(rasterTileSize_, (int)viewport_.height - tile.y);
+                }
+            }
+        }
+
+        // keep bin capacity across draws
+        for (auto &tile : rasterTiles_)
+        {
+            tile.primitives.clear();
+        }
+    }
+
+    void RendererSoft::binningTriangles(std::vector<PrimitiveHolder> &primitives)
+    {
+        for (size_t idx = 0; idx < primitives.size(); idx++)
+        {
+            auto &triangle = primitives[idx];
+            if (triangle.discard)
+            {
+                continue;
+            }
+
+            VertexHolder *vert[3] = {&vertexes_[triangle.indices[0]],
+                                     &vertexes_[triangle.indices[1]],
+                                     &vertexes_[triangle.indices[2]]};
+
+            // snapped bounds between sample points, the triangle can not cover anything
+            int minX, minY, maxX, maxY;
+            if (!triangleSampleBounds(vert, rasterSamples_, minX, minY, maxX, maxY))
+            {
+                continue;
+            }
+
+            // all samples in one quad: binned to its tile only and rasterized without block traversal
+            minX = std::max(minX, 0);
+            minY = std::max(minY, 0);
+            maxX = std::min(maxX, (int)viewport_.width - 1);
+            maxY = std::min(maxY, (int)viewport_.height - 1);
+            if (minX > maxX || minY > maxY)
+            {
+                continue;
+            }
+            if (microTriangle_ && (minX & ~1) == (maxX & ~1) && (minY & ~1) == (maxY & ~1))
+            {
+                int tileIdx = (minY / rasterTileSize_) * rasterTileCntX_ + minX / rasterTileSize_;
+                rasterTiles_[tileIdx].primitives.push_back((uint32_t)idx | RasterTile::MicroTriangleBit);
+                continue;
+            }
+
+            glm::vec4 screenPos[3] = {vert[0]->fragPos, vert[1]->fragPos, vert[2]->fragPos};
+            BoundingBox bounds = triangleBoundingBox(screenPos, viewport_.width, viewport_.height);
+            if (bounds.max.x < bounds.min.x || bounds.max.y < bounds.min.y)
+            {
+                continue;
+            }
+
+            int tileMinX = (int)bounds.min.x / rasterTileSize_;
+            int tileMinY = (int)bounds.min.y / rasterTileSize_;
+            int tileMaxX = std::min((int)bounds.max.x / rasterTileSize_, rasterTileCntX_ - 1);
+            int tileMaxY = std::min((int)bounds.max.y / rasterTileSize_, rasterTileCntY_ - 1);
+
+            for (int ty = tileMinY; ty <= tileMaxY; ty++)
+            {
+                for (int tx = tileMinX; tx <= tileMaxX; tx++)
+                {
+                    rasterTiles_[ty * rasterTileCntX_ + tx].primitives.push_back((uint32_t)idx);
+                }
+            }
+        }
+    }
+
+    void RendererSoft::binPixelRect(uint32_t idx, int minX, int minY, int maxX, int maxY)
+    {
+        minX = std::max(minX, 0);
+        minY = std::max(minY, 0);
+        maxX = std::min(maxX, (int)viewport_.width - 1);
+        maxY = std::min(maxY, (int)viewport_.height - 1);
+        if (minX > maxX || minY > maxY)
+        {
+            return;
+        }
+
+        int tileMaxX = std::min(maxX / rasterTileSize_, rasterTileCntX_ - 1);
+        int tileMaxY = std::min(maxY / rasterTileSize_, rasterTileCntY_ - 1);
+        for (int ty = minY / rasterTileSize_; ty <= tileMaxY; ty++)
+        {
+            for (int tx = minX / rasterTileSize_; tx <= tileMaxX; tx++)
+            {
+                rasterTiles_[ty * rasterTileCntX_ + tx].primitives.push_back(idx);
+            }
+        }
+    }
+
+    void RendererSoft::binningPoints(std::vector<PrimitiveHolder> &primitives)
+    {
+        if (!fboColor_)
+        {
+            return;
+        }
+        for (size_t idx = 0; idx < primitives.size(); idx++)
+        {
+            auto &point = primitives[idx];
+            if (point.discard)
+            {
+                continue;
+            }
+            PointSetup setup(vertexes_[point.indices[0]].fragPos, pointSize_);
+            binPixelRect((uint32_t)idx, setup.minX, setup.minY, setup.maxX - 1, setup.maxY - 1);
+        }
+    }
+
+    void RendererSoft::binningLines(std::vector<PrimitiveHolder> &primitives)
+    {
+        if (!fboColor_)
+        {
+            return;
+        }
+        for (size_t idx = 0; idx < primitives.size(); idx++)
+        {
+            auto &line = primitives[idx];
+            if (line.discard)
+            {
+                continue;
+            }
+            LineSetup setup(vertexes_[line.indices[0]], vertexes_[line.indices[1]], renderState_->lineWidth);
+            int minX = std::min(setup.x0, setup.x1);
+            int maxX = std::max(setup.x0, setup.x1);
+            int minY = std::min(setup.y0, setup.y1) + setup.spanOffset;
+            int maxY = std::max(setup.y0, setup.y1) + setup.spanOffset + setup.spanWidth - 1;
+            if (setup.steep)
+            {
+                binPixelRect((uint32_t)idx, minY, minX, maxY, maxX);
+            }
+            else
+            {
+                binPixelRect((uint32_t)idx, minX, minY, maxX, maxY);
+            }
+        }
+    }
+
+    void RendererSoft::rasterizationTile(RasterTile &tile, PixelQuadContext &quad)
+    {
+        materializeClearTile(tile);
+
+        auto &primitives = *rasterPrimitives_;
+        switch (rasterPrimitiveType_)
+        {
+        case Primitive_POINT:
+            for (uint32_t idx : tile.primitives)
+            {
+                rasterizationPoint(&vertexes_[primitives[idx].indices[0]], pointSize_, tile, quad);
+            }
+            return;
+        case Primitive_LINE:
+            for (uint32_t idx : tile.primitives)
+            {
+                auto &line = primitives[idx];
+                rasterizationLine(&vertexes_[line.indices[0]], &vertexes_[line.indices[1]], renderState_->lineWidth, tile, quad);
+            }
+            return;
+        default:
+            break;
+        }
+
+        for (uint32_t entry : tile.primitives)
+        {
+            uint32_t idx = entry & ~RasterTile::MicroTriangleBit;
+            auto &triangle = primitives[idx];
+            quad.primitiveId = visibilityPrimitiveBase_ + idx + 1;
+            if (entry & RasterTile::MicroTriangleBit)
+            {
+                rasterizationMicroTriangle(triangle, tile, quad);
+                continue;
+            }
+
+            // merged micro triangles are shaded before anything drawn after them
+            flushMicroQuad(quad);
+            rasterizationTriangle(&vertexes_[triangle.indices[0]],
+                                  &vertexes_[triangle.indices[1]],
+                                  &vertexes_[triangle.indices[2]],
+                                  triangle.frontFacing,
+                                  tile,
+                                  quad);
+        }
+        flushMicroQuad(quad);
+    }
+
+    void RendererSoft::rasterizationMicroTriangle(const PrimitiveHolder &triangle, const RasterTile &tile, PixelQuadContext &quad)
+    {
+        VertexHolder *vert[3] = {&vertexes_[triangle.indices[0]],
+                                 &vertexes_[triangle.indices[1]],
+                                 &vertexes_[triangle.indices[2]]};
+        int minX, minY, maxX, maxY;
+        triangleSampleBounds(vert, rasterSamples_, minX, minY, maxX, maxY);
+        int quadX = std::max(minX, 0) & ~1;
+        int quadY = std::max(minY, 0) & ~1;
+
+        if (!setupTriangle(quad, vert, triangle.frontFacing))
+        {
+            return;
+        }
+
+        // the quad is one half of a 4x2 span without multi-sample, or the whole span otherwise
+        const SpanLayout &layout = getSpanLayout(rasterSamples_);
+        int spanWidth = layout.laneCnt / layout.quadLanes * 2;
+        int spanX = quadX & ~(spanWidth - 1);
+        int laneBase = (quadX - spanX) / 2 * layout.quadLanes;
+        uint64_t mask = triangleCoverage(quad, spanX, quadY) & (layout.quadMask << laneBase);
+
+        // pixels outside the tile belong to other workers
+        int tileMaxX = tile.x + tile.width - 1;
+        int tileMaxY = tile.y + tile.height - 1;
+        if (quadX + 1 > tileMaxX || quadY + 1 > tileMaxY)
+        {
+            for (int lane = laneBase; lane < laneBase + layout.quadLanes; lane++)
+            {
+                if (spanX + layout.pixelX[lane] > tileMaxX || quadY + layout.pixelY[lane] > tileMaxY)
+                {
+                    mask &= ~(1ull << lane);
+                }
+            }
+        }
+        if (mask == 0)
+        {
+            return;
+        }
+
+        // triangle depth range is tight enough for a quad
+        bool hizTest = earlyZ_ && renderState_->depthTest && fboDepth_;
+        bool hizWrite = renderState_->depthTest && renderState_->depthMask && fboDepth_;
+        const float hizEpsilon = 1e-5f;
+        float zMin = quad.setup.zMin - hizEpsilon;
+        float zMax = quad.setup.zMax + hizEpsilon;
+        if (hizTest && hiZReject(quadX, quadY, zMin, zMax))
+        {
+            return;
+        }
+
+        edgeSpanDepth(quad.setup);
+        if (depthOnlyPass_)
+        {
+            rasterizationDepthSpan(quad.setup, spanX, quadY, mask);
+        }
+        else if (microMerge_)
+        {
+            mergeMicroQuad(quad, quadX, quadY, mask, laneBase);
+        }
+        else
+        {
+            quad.Init((float)quadX, (float)quadY, rasterSamples_);
+            initQuadCoverage(quad, mask, laneBase);
+            rasterizationPixelQuad(quad);
+        }
+
+        if (hizWrite)
+        {
+            updateHiZ(quadX, quadY, zMin, zMax, false);
+        }
+    }
+
+    void RendererSoft::mergeMicroQuad(PixelQuadContext &quad, int x, int y, uint64_t mask, int laneBase)
+    {
+        // consecutive micro triangles covering disjoint pixels of the same quad are shaded together,
+        // the first one also provides the helper pixels used by derivatives
+        int pixelMask = (int)(mask >> laneBase) & 0xF;
+        bool frontFacing = quad.frontFacing;
+        bool first = quad.mergeMask == 0 || quad.mergeX != x || quad.mergeY != y ||
+                     quad.mergeFrontFacing != frontFacing || (quad.mergeMask & pixelMask) != 0;
+        if (first)
+        {
+            flushMicroQuad(quad);
+            quad.frontFacing = frontFacing;
+            quad.Init((float)x, (float)y, 1);
+            quad.mergeX = x;
+            quad.mergeY = y;
+            quad.mergeFrontFacing = frontFacing;
+        }
+
+        TriangleSetup &setup = quad.setup;
+        int64_t e[3];
+        for (int p = 0; p < 4; p++)
+        {
+            bool inside = (pixelMask >> p) & 1;
+            if (!inside && !first)
+            {
+                continue;
+            }
+
+            int lane = laneBase + p;
+            PixelContext &pixel = quad.pixels[p];
+            auto &sample = pixel.samples[0];
+            sample.inside = inside;
+            for (int i = 0; i < 3; i++)
+            {
+                e[i] = setup.edgeOrigin[i] + setup.laneOffset[i][lane];
+            }
+            edgeBarycentric(setup, e, sample.barycentric);
+            sample.position.z = setup.laneDepth[lane];
+            perspectiveSample(sample, quad.vertW, viewport_.absMinDepth, viewport_.absMaxDepth);
+            pixel.InitCoverage();
+            interpolateBarycentric((float *)pixel.varyingsFrag, quad.vertVaryings, varyingsCnt_, sample.barycentric);
+        }
+        quad.mergeMask |= pixelMask;
+    }
+
+    void RendererSoft::flushMicroQuad(PixelQuadContext &quad)
+    {
+        if (quad.mergeMask == 0)
+        {
+            return;
+        }
+        quad.mergeMask = 0;
+        quad.frontFacing = quad.mergeFrontFacing;
+        if (!quad.CheckInside())
+        {
+            return;
+        }
+        if (earlyZ_ && renderState_->depthTest && !earlyZTest(quad))
+        {
+            return;
+        }
+        shadePixelQuad(quad);
+    }
+
+    void RendererSoft::rasterizationPoint(VertexHolder *v, float pointSize, const RasterTile &tile, PixelQuadContext &quad)
+    {
+        PointSetup setup(v->fragPos, pointSize);
+        int minX = std::max(setup.minX, tile.x);
+        int minY = std::max(setup.minY, tile.y);
+        int maxX = std::min(setup.maxX, tile.x + tile.width);
+        int maxY = std::min(setup.maxY, tile.y + tile.height);
+
+        glm::vec4 screenPos = v->fragPos;
+        for (int x = minX; x < maxX; x++)
+        {
+            for (int y = minY; y < maxY; y++)
+            {
+                screenPos.x = (float)x;
+                screenPos.y = (float)y;
+                rasterizationPointPixel(screenPos, v->varyings, quad.shaderProgram.get());
+            }
+        }
+    }
+
+    void RendererSoft::rasterizationPointPixel(glm::vec4 &screenPos, void *varyings, ShaderProgramSoft *program)
+    {
+        processFragmentShader(screenPos, true, varyings, program);
+        auto &builtIn = program->getShaderBuiltin();
+        if (!builtIn.discard)
+        {
+            // TODO MSAA
+            float depth[16];
+            std::fill(depth, depth + rasterSamples_, screenPos.z);
+            outputMerger_.pixel(outputMergerCtx_, (int)screenPos.x, (int)screenPos.y, depth, (1u << rasterSamples_) - 1, builtIn.FragColor);
+        }
+    }
+
+    void RendererSoft::rasterizationLine(VertexHolder *v0, VertexHolder *v1, float lineWidth, const RasterTile &tile, PixelQuadContext &quad)
+    {
+        // TODO diamond-exit rule
+        LineSetup setup(*v0, *v1, lineWidth);
+
+        // tile range on the major and minor axes
+        int majorMin = setup.steep ? tile.y : tile.x;
+        int majorMax = (setup.steep ? tile.y + tile.height : tile.x + tile.width) - 1;
+        int minorMin = setup.steep ? tile.x : tile.y;
+        int minorMax = (setup.steep ? tile.x + tile.width : tile.y + tile.height) - 1;
+
+        int begin = std::max(setup.x0, majorMin);
+        int end = std::min(setup.x1, majorMax);
+        if (begin > end)
+        {
+            return;
+        }
+
+        // bresenham state at the first step inside the tile
+        int64_t k = begin - setup.x0;
+        int64_t dErrorY = 2 * (int64_t)std::abs(setup.dy);
+        int64_t steps = setup.dx > 0 ? (k * dErrorY + setup.dx - 1) / (2 * (int64_t)setup.dx) : 0;
+        int64_t error = k * dErrorY - 2 * (int64_t)setup.dx * steps;
+        int y = setup.y0 + (int)steps * setup.stepY;
+
+        const float *varyingsIn[2] = {setup.varyings[0], setup.varyings[1]};
+        float *varyings = quad.pixels[0].varyingsFrag;
+        ShaderProgramSoft *program = quad.shaderProgram.get();
+        glm::vec4 screenPos;
+        for (int x = begin; x <= end; x++)
+        {
+            // span of lineWidth pixels on the minor axis
+            int spanMin = std::max(y + setup.spanOffset, minorMin);
+            int spanMax = std::min(y + setup.spanOffset + setup.spanWidth - 1, minorMax);
+            if (spanMin <= spanMax)
+            {
+                float t = setup.dx > 0 ? (float)(x - setup.x0) / (float)setup.dx : 0.f;
+                screenPos.z = glm::mix(setup.z0, setup.z1, t);
+                screenPos.w = glm::mix(setup.w0, setup.w1, t);
+                interpolateLinear(varyings, varyingsIn, varyingsCnt_, t);
+                for (int m = spanMin; m <= spanMax; m++)
+                {
+                    screenPos.x = (float)(setup.steep ? m : x);
+                    screenPos.y = (float)(setup.steep ? x : m);
+                    rasterizationPointPixel(screenPos, varyings, program);
+                }
+            }
+
+            error += dErrorY;
+            if (error > setup.dx)
+            {
+                y += setup.stepY;
+                error -= 2 * (int64_t)setup.dx;
+            }
+        }
+    }
+
+    void RendererSoft::rasterizationTriangle(VertexHolder *v0, VertexHolder *v1, VertexHolder *v2, bool frontFacing,
+                                             const RasterTile &tile, PixelQuadContext &quad)
+    {
+        VertexHolder *vert[3] = {v0, v1, v2};
+        glm::vec4 screenPos[3] = {vert[0]->fragPos, vert[1]->fragPos, vert[2]->fragPos};
+        BoundingBox bounds = triangleBoundingBox(screenPos, viewport_.width, viewport_.height);
+
+        // clamp to tile, quads are aligned to even coordinates so they never straddle two tiles
+        int minX = std::max((int)bounds.min.x, tile.x) & ~1;
+        int minY = std::max((int)bounds.min.y, tile.y) & ~1;
+        int maxX = std::min((int)bounds.max.x, tile.x + tile.width - 1);
+        int maxY = std::min((int)bounds.max.y, tile.y + tile.height - 1);
+        if (minX > maxX || minY > maxY)
+        {
+            return;
+        }
+
+        // degenerate triangle
+        if (!setupTriangle(quad, vert, frontFacing))
+        {
+            return;
+        }
+
+        // tile level trivial reject / accept, binning only tested the bounding box
+        auto tileCoverage = quad.setup.TestBlock(tile.x, tile.y, tile.width, tile.height);
+        if (tileCoverage == TriangleSetup::Block_Outside)
+        {
+            return;
+        }
+
+        bool hizTest = earlyZ_ && renderState_->depthTest && fboDepth_;
+        bool hizWrite = renderState_->depthTest && renderState_->depthMask && fboDepth_;
+        bool depthInRange = quad.setup.zMin >= viewport_.absMinDepth && quad.setup.zMax <= viewport_.absMaxDepth;
+        const float hizEpsilon = 1e-5f;
+
+        for (int by = minY & ~(rasterBlockSize_ - 1); by <= maxY; by += rasterBlockSize_)
+        {
+            for (int bx = minX & ~(rasterBlockSize_ - 1); bx <= maxX; bx += rasterBlockSize_)
+            {
+                auto blockCoverage = tileCoverage;
+                if (blockCoverage != TriangleSetup::Block_Inside)
+                {
+                    blockCoverage = quad.setup.TestBlock(bx, by, rasterBlockSize_, rasterBlockSize_);
+                    if (blockCoverage == TriangleSetup::Block_Outside)
+                    {
+                        continue;
+                    }
+                }
+
+                // coarse occlusion against hierarchical z, interpolated z may differ from the plane by rounding
+                float blockZMin = 0.f;
+                float blockZMax = 0.f;
+                if (hizTest || hizWrite)
+                {
+                    quad.setup.BlockDepthRange(bx, by, rasterBlockSize_, rasterBlockSize_, blockZMin, blockZMax);
+                    blockZMin -= hizEpsilon;
+                    blockZMax += hizEpsilon;
+                    if (hizTest && hiZReject(bx, by, blockZMin, blockZMax))
+                    {
+                        continue;
+                    }
+                }
+
+                bool fullCovered = blockCoverage == TriangleSetup::Block_Inside;
+                BoundingBox blockBounds;
+                blockBounds.min = glm::vec3(std::max(bx, minX), std::max(by, minY), 0.f);
+                blockBounds.max = glm::vec3(std::min(bx + rasterBlockSize_ - 1, maxX), std::min(by + rasterBlockSize_ - 1, maxY), 0.f);
+                bool covered = rasterizationBlock(tile, blockBounds, fullCovered, quad);
+
+                if (covered && hizWrite)
+                {
+                    // every sample of the block is written only if the block lies inside this tile
+                    bool blockInTile = bx + rasterBlockSize_ <= tile.x + tile.width && by + rasterBlockSize_ <= tile.y + tile.height;
+                    updateHiZ(bx, by, blockZMin, blockZMax, fullCovered && blockInTile && depthInRange);
+                }
+            }
+        }
+    }
+
+    bool RendererSoft::rasterizationBlock(const RasterTile &tile, const BoundingBox &bounds, bool fullCovered,
+                                          PixelQuadContext &quad)
+    {
+        bool covered = false;
+        const SpanLayout &layout = getSpanLayout(rasterSamples_);
+        int quadCnt = layout.laneCnt / layout.quadLanes;
+        int spanWidth = quadCnt * 2;
+        int tileMaxX = tile.x + tile.width - 1;
+        int tileMaxY = tile.y + tile.height - 1;
+
+        // spans are aligned to their width, blocks are aligned to rasterBlockSize_, so spans never straddle blocks
+        int minX = (int)bounds.min.x & ~(spanWidth - 1);
+        int minY = (int)bounds.min.y & ~1;
+        int maxX = (int)bounds.max.x;
+        int maxY = (int)bounds.max.y;
+
+        for (int y = minY; y <= maxY; y += 2)
+        {
+            for (int x = minX; x <= maxX; x += spanWidth)
+            {
+                uint64_t mask;
+                if (fullCovered)
+                {
+                    // trivial accept, skip coverage test
+                    quad.setup.SetSpanOrigin(x, y);
+                    mask = layout.laneMask;
+                }
+                else
+                {
+                    mask = triangleCoverage(quad, x, y);
+                    if (mask == 0)
+                    {
+                        continue;
+                    }
+                }
+
+                // pixels outside the tile belong to other workers
+                if (x + spanWidth - 1 > tileMaxX || y + 1 > tileMaxY)
+                {
+                    for (int lane = 0; lane < layout.laneCnt; lane++)
+                    {
+                        if (x + layout.pixelX[lane] > tileMaxX || y + layout.pixelY[lane] > tileMaxY)
+                        {
+                            mask &= ~(1ull << lane);
+                        }
+                    }
+                }
+
+                if (mask == 0)
+                {
+                    continue;
+                }
+                edgeSpanDepth(quad.setup);
+                covered = true;
+
+                if (depthOnlyPass_)
+                {
+                    rasterizationDepthSpan(quad.setup, x, y, mask);
+                    continue;
+                }
+
+                for (int quadIdx = 0; quadIdx < quadCnt; quadIdx++)
+                {
+                    int laneBase = quadIdx * layout.quadLanes;
+                    if (((mask >> laneBase) & layout.quadMask) == 0)
+                    {
+                        continue;
+                    }
+                    quad.Init((float)(x + quadIdx * 2), (float)y, rasterSamples_);
+                    initQuadCoverage(quad, mask, laneBase);
+                    rasterizationPixelQuad(quad);
+                }
+            }
+        }
+        return covered;
+    }
+
+    bool RendererSoft::setupTriangle(PixelQuadContext &quad, VertexHolder *vert[3], bool frontFacing)
+    {
+        quad.frontFacing = frontFacing;
+        for (int i = 0; i < 3; i++)
+        {
+            quad.vertPos[i] = vert[i]->fragPos;
+            quad.vertZ[i] = &vert[i]->fragPos.z;
+            quad.vertW[i] = vert[i]->fragPos.w;
+            quad.vertVaryings[i] = vert[i]->varyings;
+        }
+
+        TriangleSetup &setup = quad.setup;
+
+        // snap to sub-pixel grid, keep |a * dx + b * dy| of a span far below 2^31
+        const float coordLimit = (float)(1 << 17);
+        int64_t vx[3], vy[3];
+        for (int i = 0; i < 3; i++)
+        {
+            vx[i] = (int64_t)std::floor(glm::clamp(quad.vertPos[i].x, -coordLimit, coordLimit) * TriangleSetup::SubPixelScale + 0.5f);
+            vy[i] = (int64_t)std::floor(glm::clamp(quad.vertPos[i].y, -coordLimit, coordLimit) * TriangleSetup::SubPixelScale + 0.5f);
+        }
+
+        int64_t area = (vx[1] - vx[0]) * (vy[2] - vy[0]) - (vy[1] - vy[0]) * (vx[2] - vx[0]);
+        if (area == 0)
+        {
+            return false;
+        }
+
+        setup.swapWinding = area < 0;
+        if (setup.swapWinding)
+        {
+            std::swap(vx[1], vx[2]);
+            std::swap(vy[1], vy[2]);
+            area = -area;
+        }
+        setup.invArea = 1.f / (float)area;
+
+        for (int i = 0; i < 3; i++)
+        {
+            int j = (i + 1) % 3;
+            int k = (i + 2) % 3;
+            setup.a[i] = vy[j] - vy[k];
+            setup.b[i] = vx[k] - vx[j];
+            setup.c[i] = -(setup.a[i] * vx[j] + setup.b[i] * vy[j]);
+
+            // shared edges are owned by exactly one of the two triangles
+            bool inclusive = setup.a[i] > 0 || (setup.a[i] == 0 && setup.b[i] < 0);
+            setup.bias[i] = inclusive ? 0 : -1;
+        }
+
+        // depth plane from the snapped edges, z = sum(z_i * E_i) / area
+        float vz[3] = {quad.vertPos[0].z, quad.vertPos[1].z, quad.vertPos[2].z};
+        if (setup.swapWinding)
+        {
+            std::swap(vz[1], vz[2]);
+        }
+        double invArea = 1.0 / (double)area;
+        for (int k = 0; k < 3; k++)
+        {
+            setup.zPlane[k] = 0.0;
+        }
+        for (int i = 0; i < 3; i++)
+        {
+            setup.zPlane[0] += vz[i] * (double)setup.a[i] * TriangleSetup::SubPixelScale * invArea;
+            setup.zPlane[1] += vz[i] * (double)setup.b[i] * TriangleSetup::SubPixelScale * invArea;
+            setup.zPlane[2] += vz[i] * (double)setup.c[i] * invArea;
+        }
+        for (int i = 0; i < 3; i++)
+        {
+            setup.zEdge[i] = vz[i] * setup.invArea;
+        }
+        setup.zMin = std::min(std::min(vz[0], vz[1]), vz[2]);
+        setup.zMax = std::max(std::max(vz[0], vz[1]), vz[2]);
+
+        const SpanLayout &layout = getSpanLayout(rasterSamples_);
+        setup.laneCnt = layout.laneCnt;
+        for (int i = 0; i < 3; i++)
+        {
+            for (int lane = 0; lane < layout.laneCnt; lane++)
             {
-                continue;
+                setup.laneOffset[i][lane] = (int32_t)(setup.a[i] * layout.offsetX[lane] + setup.b[i] * layout.offsetY[lane]);
             }
-            for (size_t idx : triangle.indices)
+            for (int p = 0; p < 4; p++)
             {
-                PrimitiveHolder point;
-                point.discard = false;
-                point.frontFacing = triangle.frontFacing;
-                point.indices[0] = idx;
+                int cx = (p & 1) * TriangleSetup::SubPixelScale + TriangleSetup::SubPixelScale / 2;
+                int cy = (p >> 1) * TriangleSetup::SubPixelScale + TriangleSetup::SubPixelScale / 2;
+                setup.centerOffset[i][p] = (int32_t)(setup.a[i] * cx + setup.b[i] * cy);
+            }
+        }
+        return true;
+    }
 
-                // clipping
-                clippingPoint(point);
-                if (point.discard)
+    uint64_t RendererSoft::triangleCoverage(PixelQuadContext &quad, int x, int y)
+    {
+        TriangleSetup &setup = quad.setup;
+        const int64_t edgeLimit = 1 << 30;
+
+        // edge values at span origin, only the sign matters for the coverage test so clamp to int32
+        setup.SetSpanOrigin(x, y);
+        int32_t edge[3];
+        for (int i = 0; i < 3; i++)
+        {
+            edge[i] = (int32_t)glm::clamp(setup.edgeOrigin[i] + setup.bias[i], -edgeLimit, edgeLimit);
+        }
+
+        uint64_t mask = 0;
+#ifdef SOFTGL_SIMD_OPT
+        for (int base = 0; base < setup.laneCnt; base += 8)
+        {
+            // a lane is covered if all three edge values are non-negative
+            __m256i sign = _mm256_setzero_si256();
+            for (int i = 0; i < 3; i++)
+            {
+                __m256i offset = _mm256_load_si256((__m256i *)&setup.laneOffset[i][base]);
+                sign = _mm256_or_si256(sign, _mm256_add_epi32(_mm256_set1_epi32(edge[i]), offset));
+            }
+            int negative = _mm256_movemask_ps(_mm256_castsi256_ps(sign));
+            mask |= (uint64_t)(~negative & 0xFF) << base;
+        }
+#else
+        for (int lane = 0; lane < setup.laneCnt; lane++)
+        {
+            if ((edge[0] + setup.laneOffset[0][lane]) >= 0 &&
+                (edge[1] + setup.laneOffset[1][lane]) >= 0 &&
+                (edge[2] + setup.laneOffset[2][lane]) >= 0)
+            {
+                mask |= 1ull << lane;
+            }
+        }
+#endif
+        return mask;
+    }
+
+    void RendererSoft::initQuadCoverage(PixelQuadContext &quad, uint64_t mask, int laneBase)
+    {
+        TriangleSetup &setup = quad.setup;
+        int64_t e[3];
+
+        for (int p = 0; p < 4; p++)
+        {
+            PixelContext &pixel = quad.pixels[p];
+            if (pixel.sampleCount > 1)
+            {
+                // barycentric only for covered samples
+                for (int s = 0; s < pixel.sampleCount; s++)
+                {
+                    int lane = laneBase + p * pixel.sampleCount + s;
+                    auto &sample = pixel.samples[s];
+                    sample.inside = (mask >> lane) & 1;
+                    if (sample.inside)
+                    {
+                        for (int i = 0; i < 3; i++)
+                        {
+                            e[i] = setup.edgeOrigin[i] + setup.laneOffset[i][lane];
+                        }
+                        edgeBarycentric(setup, e, sample.barycentric);
+                        sample.position.z = setup.laneDepth[lane];
+                    }
+                }
+
+                // pixel center is always needed (derivatives of helper pixels)
+                auto &center = pixel.samples[pixel.sampleCount];
+                for (int i = 0; i < 3; i++)
+                {
+                    e[i] = setup.edgeOrigin[i] + setup.centerOffset[i][p];
+                }
+                center.inside = (e[0] + setup.bias[0]) >= 0 && (e[1] + setup.bias[1]) >= 0 && (e[2] + setup.bias[2]) >= 0;
+                edgeBarycentric(setup, e, center.barycentric);
+                center.position.z = glm::dot(center.barycentric, glm::vec4(quad.vertPos[0].z, quad.vertPos[1].z, quad.vertPos[2].z, 0.f));
+            }
+            else
+            {
+                int lane = laneBase + p;
+                auto &sample = pixel.samples[0];
+                sample.inside = (mask >> lane) & 1;
+                for (int i = 0; i < 3; i++)
+                {
+                    e[i] = setup.edgeOrigin[i] + setup.laneOffset[i][lane];
+                }
+                edgeBarycentric(setup, e, sample.barycentric);
+                sample.position.z = setup.laneDepth[lane];
+            }
+
+            pixel.InitCoverage();
+            pixel.InitShadingSample();
+        }
+    }
+
+    void RendererSoft::rasterizationPixelQuad(PixelQuadContext &quad)
+    {
+        // coverage and barycentric are setup by initQuadCoverage
+        if (!quad.CheckInside())
+        {
+            return;
+        }
+
+        for (auto &pixel : quad.pixels)
+        {
+            for (auto &sample : pixel.samples)
+            {
+                if (!sample.inside)
                 {
                     continue;
                 }
 
-                // rasterization
-                rasterizationPoint(&vertexes_[point.indices[0]], pointSize_);
+                // z is the span depth set by initQuadCoverage
+                perspectiveSample(sample, quad.vertW, viewport_.absMinDepth, viewport_.absMaxDepth);
+            }
+            pixel.InitCoverage();
+        }
+
+        // visibility buffer: depth and primitive id only, shading is deferred
+        if (visibilityPass_)
+        {
+            writeVisibility(quad);
+            return;
+        }
+
+        // early z
+        if (earlyZ_ && renderState_->depthTest)
+        {
+            if (!earlyZTest(quad))
+            {
+                return;
             }
         }
+
+        // varying interpolate
+        // note: all quad pixels should perform varying interpolate to enable varying partial derivative
+        for (auto &pixel : quad.pixels)
+        {
+            interpolateBarycentric((float *)pixel.varyingsFrag,
+                                   quad.vertVaryings,
+                                   varyingsCnt_,
+                                   pixel.sampleShading->barycentric);
+        }
+
+        shadePixelQuad(quad);
     }
 
-    void RendererSoft::rasterizationPolygonsLine(std::vector<PrimitiveHolder> &primitives)
+    void RendererSoft::shadePixelQuad(PixelQuadContext &quad)
     {
-        for (auto &triangle : primitives)
+        // pixel shading, the whole quad in one call if the shader has a batch entry
+        bool batchShading = batchShading_ && quad.shaderProgram->hasFragmentShaderBatch();
+        if (batchShading)
         {
-            if (triangle.discard)
+            processFragmentShaderBatch(quad, varyingsCnt_, quad.shaderProgram.get());
+        }
+
+        // depth and coverage of all samples, pixel major, for the quad output merger
+        const int sampleCnt = quad.pixels[0].sampleCount;
+        alignas(32) float depth[TriangleSetup::MaxSpanLanes];
+        glm::vec4 fragColor[4];
+        uint64_t laneMask = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            auto &pixel = quad.pixels[i];
+            if (!pixel.inside)
             {
                 continue;
             }
-            for (size_t i = 0; i < 3; i++)
+
+            // fragment shader
+            if (batchShading)
             {
-                PrimitiveHolder line;
-                line.discard = false;
-                line.frontFacing = triangle.frontFacing;
-                line.indices[0] = triangle.indices[i];
-                line.indices[1] = triangle.indices[(i + 1) % 3];
+                fragColor[i] = quad.batch.fragColor.get(i);
+            }
+            else
+            {
+                processFragmentShader(pixel.sampleShading->position,
+                                      quad.frontFacing,
+                                      pixel.varyingsFrag,
+                                      quad.shaderProgram.get());
+                fragColor[i] = quad.shaderProgram->getShaderBuiltin().FragColor;
+            }
 
-                // clipping
-                clippingLine(line, true);
-                if (line.discard)
+            if (sampleCnt > 1)
+            {
+                for (int idx = 0; idx < sampleCnt; idx++)
                 {
-                    continue;
+                    auto &sample = pixel.samples[idx];
+                    depth[i * sampleCnt + idx] = sample.position.z;
+                    laneMask |= (uint64_t)sample.inside << (i * sampleCnt + idx);
+                }
+            }
+            else
+            {
+                depth[i] = pixel.sampleShading->position.z;
+                laneMask |= 1ull << i;
+            }
+        }
+
+        // per-sample operations of the whole quad
+        if (laneMask)
+        {
+            const glm::ivec2 &coord = quad.pixels[0].samples[0].fboCoord;
+            outputMerger_.quad(outputMergerCtx_, coord.x, coord.y, depth, laneMask, fragColor);
+        }
+    }
+
+    void RendererSoft::rasterizationDepthSpan(const TriangleSetup &setup, int x, int y, uint64_t mask)
+    {
+        // lane depths are setup by edgeSpanDepth, depthTest and depthMask are checked by draw
+        const SpanLayout &layout = getSpanLayout(rasterSamples_);
+        DepthFunction depthFunc = renderState_->depthFunc;
+
+#ifdef SOFTGL_SIMD_OPT
+        // span rows are contiguous in a linear buffer: 4 pixels, or 2 pixels with all their samples
+        int spanWidth = layout.laneCnt / layout.quadLanes * 2;
+        int rowLanes = layout.quadLanes / 2;
+        BufferLayout bufferLayout = fboDepth_->multiSample ? Layout_Linear : fboDepth_->buffer->getLayout();
+        if (bufferLayout == Layout_Linear && x + spanWidth <= fboDepth_->width && y + 1 < fboDepth_->height)
+        {
+            float *row0;
+            float *row1;
+            if (fboDepth_->multiSample)
+            {
+                // per-sample writes, uniform pixels of the quad are expanded first
+                for (int i = 0; i < 4; i++)
+                {
+                    fboDepth_->expand(x + (i & 1), y + (i >> 1));
+                }
+                row0 = fboDepth_->getSamples(x, y);
+                row1 = fboDepth_->getSamples(x, y + 1);
+            }
+            else
+            {
+                row0 = getFrameDepth(x, y, 0);
+                row1 = getFrameDepth(x, y + 1, 0);
+            }
+            const __m256i laneBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+            __m256 minDepth = _mm256_set1_ps(viewport_.absMinDepth);
+            __m256 maxDepth = _mm256_set1_ps(viewport_.absMaxDepth);
+
+            for (int base = 0; base < layout.laneCnt; base += 8)
+            {
+                __m256i bits = _mm256_and_si256(_mm256_set1_epi32((int)(mask >> base)), laneBits);
+                __m256 inside = _mm256_castsi256_ps(_mm256_cmpeq_epi32(bits, laneBits));
+                __m256 z = _mm256_load_ps(&setup.laneDepth[base]);
+
+                // depth clipping
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(z, minDepth, _CMP_GE_OQ));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(z, maxDepth, _CMP_LE_OQ));
+
+                if (rowLanes == 2)
+                {
+                    // lanes are two quads: (r0[0], r0[1], r1[0], r1[1]), (r0[2], r0[3], r1[2], r1[3])
+                    __m128 r0 = _mm_loadu_ps(row0);
+                    __m128 r1 = _mm_loadu_ps(row1);
+                    __m256 stored = _mm256_set_m128(_mm_shuffle_ps(r0, r1, _MM_SHUFFLE(3, 2, 3, 2)),
+                                                     _mm_shuffle_ps(r0, r1, _MM_SHUFFLE(1, 0, 1, 0)));
+                    __m256 pass = _mm256_and_ps(inside, DepthTestSIMD(z, stored, depthFunc));
+
+                    __m128 zLo = _mm256_castps256_ps128(z);
+                    __m128 zHi = _mm256_extractf128_ps(z, 1);
+                    __m128 passLo = _mm256_castps256_ps128(pass);
+                    __m128 passHi = _mm256_extractf128_ps(pass, 1);
+                    _mm_maskstore_ps(row0, _mm_castps_si128(_mm_shuffle_ps(passLo, passHi, _MM_SHUFFLE(1, 0, 1, 0))),
+                                     _mm_shuffle_ps(zLo, zHi, _MM_SHUFFLE(1, 0, 1, 0)));
+                    _mm_maskstore_ps(row1, _mm_castps_si128(_mm_shuffle_ps(passLo, passHi, _MM_SHUFFLE(3, 2, 3, 2))),
+                                     _mm_shuffle_ps(zLo, zHi, _MM_SHUFFLE(3, 2, 3, 2)));
+                }
+                else if (rowLanes == 4)
+                {
+                    // 2 samples, the low half is the first row and the high half the second
+                    __m256 stored = _mm256_set_m128(_mm_loadu_ps(row1), _mm_loadu_ps(row0));
+                    __m256 pass = _mm256_and_ps(inside, DepthTestSIMD(z, stored, depthFunc));
+                    _mm_maskstore_ps(row0, _mm_castps_si128(_mm256_castps256_ps128(pass)), _mm256_castps256_ps128(z));
+                    _mm_maskstore_ps(row1, _mm_castps_si128(_mm256_extractf128_ps(pass, 1)), _mm256_extractf128_ps(z, 1));
                 }
+                else
+                {
+                    // lanes of one quad row are its two pixels with all samples
+                    float *row = (base < rowLanes ? row0 : row1) + base % rowLanes;
+                    __m256 stored = _mm256_loadu_ps(row);
+                    __m256 pass = _mm256_and_ps(inside, DepthTestSIMD(z, stored, depthFunc));
+                    _mm256_maskstore_ps(row, _mm256_castps_si256(pass), z);
+                }
+            }
+            return;
+        }
+#endif
+
+        for (int lane = 0; lane < layout.laneCnt; lane++)
+        {
+            float z = setup.laneDepth[lane];
+            if (!((mask >> lane) & 1) || z < viewport_.absMinDepth || z > viewport_.absMaxDepth)
+            {
+                continue;
+            }
+            int sample = rasterSamples_ > 1 ? lane % rasterSamples_ : 0;
+            float *zPtr = getFrameDepth(x + layout.pixelX[lane], y + layout.pixelY[lane], sample);
+            if (zPtr && DepthTest(z, *zPtr, depthFunc))
+            {
+                *zPtr = z;
+            }
+        }
+    }
+
+    void RendererSoft::resetHiZ(float depth)
+    {
+        hizDepth_ = fboDepth_.get();
+        hizTileCntX_ = (fboDepth_->width + rasterBlockSize_ - 1) / rasterBlockSize_;
+        hizTileCntY_ = (fboDepth_->height + rasterBlockSize_ - 1) / rasterBlockSize_;
+        hizTiles_.resize(hizTileCntX_ * hizTileCntY_);
+        for (auto &tile : hizTiles_)
+        {
+            tile.minDepth = depth;
+            tile.maxDepth = depth;
+        }
+    }
+
+    void RendererSoft::rebuildHiZ()
+    {
+        resetHiZ(0.f);
+        for (int ty = 0; ty < hizTileCntY_; ty++)
+        {
+            for (int tx = 0; tx < hizTileCntX_; tx++)
+            {
+                float minDepth = std::numeric_limits<float>::max();
+                float maxDepth = std::numeric_limits<float>::lowest();
+                int endX = std::min((tx + 1) * rasterBlockSize_, fboDepth_->width);
+                int endY = std::min((ty + 1) * rasterBlockSize_, fboDepth_->height);
+                for (int y = ty * rasterBlockSize_; y < endY; y++)
+                {
+                    for (int x = tx * rasterBlockSize_; x < endX; x++)
+                    {
+                        for (int sample = 0; sample < fboDepth_->sampleCnt; sample++)
+                        {
+                            float depth = 0.f;
+                            readFrameDepth(x, y, sample, depth);
+                            minDepth = std::min(minDepth, depth);
+                            maxDepth = std::max(maxDepth, depth);
+                        }
+                    }
+                }
+                auto &tile = hizTiles_[ty * hizTileCntX_ + tx];
+                tile.minDepth = minDepth;
+                tile.maxDepth = maxDepth;
+            }
+        }
+    }
+
+    bool RendererSoft::hiZReject(int x, int y, float zMin, float zMax)
+    {
+        int tx = x / rasterBlockSize_;
+        int ty = y / rasterBlockSize_;
+        if (tx >= hizTileCntX_ || ty >= hizTileCntY_)
+        {
+            return false;
+        }
+
+        auto &tile = hizTiles_[ty * hizTileCntX_ + tx];
+        switch (renderState_->depthFunc)
+        {
+        case LESS:
+            return zMin >= tile.maxDepth;
+        case LEQUAL:
+            return zMin > tile.maxDepth;
+        case GREATER:
+            return zMax <= tile.minDepth;
+        case GEQUAL:
+            return zMax < tile.minDepth;
+        case NEVER:
+            return true;
+        default:
+            break;
+        }
+        return false;
+    }
+
+    void RendererSoft::updateHiZ(int x, int y, float zMin, float zMax, bool fullCovered)
+    {
+        int tx = x / rasterBlockSize_;
+        int ty = y / rasterBlockSize_;
+        if (tx >= hizTileCntX_ || ty >= hizTileCntY_)
+        {
+            return;
+        }
+
+        // written depth is clamped to the viewport depth range
+        zMin = glm::clamp(zMin, viewport_.absMinDepth, viewport_.absMaxDepth);
+        zMax = glm::clamp(zMax, viewport_.absMinDepth, viewport_.absMaxDepth);
+
+        auto &tile = hizTiles_[ty * hizTileCntX_ + tx];
+        switch (renderState_->depthFunc)
+        {
+        case LESS:
+        case LEQUAL:
+            // depth only moves closer, and a fully covered block is now no farther than the triangle
+            tile.minDepth = std::min(tile.minDepth, zMin);
+            if (fullCovered)
+            {
+                tile.maxDepth = std::min(tile.maxDepth, zMax);
+            }
+            return;
+        case GREATER:
+        case GEQUAL:
+            tile.maxDepth = std::max(tile.maxDepth, zMax);
+            if (fullCovered)
+            {
+                tile.minDepth = std::max(tile.minDepth, zMin);
+            }
+            return;
+        case ALWAYS:
+            if (fullCovered)
+            {
+                tile.minDepth = zMin;
+                tile.maxDepth = zMax;
+                return;
+            }
+            break;
+        default:
+            break;
+        }
+
+        tile.minDepth = std::min(tile.minDepth, zMin);
+        tile.maxDepth = std::max(tile.maxDepth, zMax);
+    }
 
-                // rasterization
-                rasterizationLine(&vertexes_[line.indices[0]],
-                                  &vertexes_[line.indices[1]],
-                                  renderState_->lineWidth);
+    bool RendererSoft::earlyZTest(PixelQuadContext &quad)
+    {
+        for (auto &pixel : quad.pixels)
+        {
+            if (!pixel.inside)
+            {
+                continue;
+            }
+            if (pixel.sampleCount > 1)
+            {
+                bool inside = false;
+                for (int idx = 0; idx < pixel.sampleCount; idx++)
+                {
+                    auto &sample = pixel.samples[idx];
+                    if (!sample.inside)
+                    {
+                        continue;
+                    }
+                    sample.inside = processDepthTest(sample.fboCoord.x, sample.fboCoord.y, sample.position.z, idx, true);
+                    if (sample.inside)
+                    {
+                        inside = true;
+                    }
+                }
+                pixel.inside = inside;
+            }
+            else
+            {
+                auto &sample = *pixel.sampleShading;
+                sample.inside = processDepthTest(sample.fboCoord.x, sample.fboCoord.y, sample.position.z, 0, true);
+                pixel.inside = sample.inside;
             }
         }
+        return quad.CheckInside();
     }
 
-    void RendererSoft::rasterizationPolygonsTriangle(std::vector<PrimitiveHolder> &primitives)
+    bool RendererSoft::checkDepthOnlyEligible()
     {
-        for (auto &triangle : primitives)
+        // filled triangles without color output, the fragment shader has no visible effect
+        return depthOnly_ &&
+               primitiveType_ == Primitive_TRIANGLE &&
+               renderState_->polygonMode == PolygonMode::FILL &&
+               !fboColor_ && fboDepth_ &&
+               !shaderProgram_->fragmentShaderDiscard();
+    }
+
+    bool RendererSoft::checkVisibilityEligible()
+    {
+        // opaque depth tested triangles, last depth writer is the visible one
+        return primitiveType_ == Primitive_TRIANGLE &&
+               renderState_->polygonMode == PolygonMode::FILL &&
+               !renderState_->blend &&
+               renderState_->depthTest &&
+               renderState_->depthMask &&
+               fboColor_ && !fboColor_->multiSample &&
+               fboDepth_ && !fboDepth_->multiSample;
+    }
+
+    void RendererSoft::writeVisibility(PixelQuadContext &quad)
+    {
+        for (auto &pixel : quad.pixels)
         {
-            if (triangle.discard)
+            auto &sample = *pixel.sampleShading;
+            if (!sample.inside)
             {
                 continue;
             }
-            rasterizationTriangle(&vertexes_[triangle.indices[0]],
-                                  &vertexes_[triangle.indices[1]],
-                                  &vertexes_[triangle.indices[2]],
-                                  triangle.frontFacing);
+            int x = sample.fboCoord.x;
+            int y = sample.fboCoord.y;
+            if (x >= fboColor_->width || y >= fboColor_->height)
+            {
+                continue;
+            }
+            if (processDepthTest(x, y, sample.position.z, 0, false))
+            {
+                visibilityIds_[(size_t)y * fboColor_->width + x] = quad.primitiveId;
+            }
         }
     }
 
-    void RendererSoft::rasterizationPoint(VertexHolder *v, float pointSize)
+    void RendererSoft::recordVisibilityDraw()
     {
-        if (!fboColor_)
+        uint32_t primitiveCnt = (uint32_t)primitives_.size();
+        if (primitiveCnt == 0)
         {
             return;
         }
 
-        float left = v->fragPos.x - pointSize / 2.f + 0.5f;
-        float right = left + pointSize;
-        float top = v->fragPos.y - pointSize / 2.f + 0.5f;
-        float bottom = top + pointSize;
+        visibilityDraws_.emplace_back();
+        auto &record = visibilityDraws_.back();
+        record.primitiveBase = visibilityPrimitiveBase_;
+        record.vertexes = std::move(vertexes_);
+        record.primitives = std::move(primitives_);
+        record.varyingsCnt = varyingsCnt_;
+        record.varyingsAlignedCnt = varyingsAlignedCnt_;
+        record.uniforms = shaderProgram_->copyUniformBuffer();
+        record.threadPrograms = threadPrograms_;
 
-        glm::vec4 &screenPos = v->fragPos;
-        for (int x = (int)left; x < (int)right; x++)
+        // the caller may retarget a sampler before the pass is shaded, the copy points at a snapshot
+        // of each sampler as it is now, shared by the draws that saw the same texture
+        auto &samplers = shaderProgram_->getBoundSamplers();
+        for (int location = 0; location < (int)samplers.size(); location++)
         {
-            for (int y = (int)top; y < (int)bottom; y++)
+            SamplerSoft *sampler = samplers[location];
+            if (!sampler)
             {
-                screenPos.x = (float)x;
-                screenPos.y = (float)y;
-                processFragmentShader(screenPos, true, v->varyings, shaderProgram_);
-                auto &builtIn = shaderProgram_->getShaderBuiltin();
-                if (!builtIn.discard)
-                {
-                    // TODO MSAA
-                    for (int idx = 0; idx < rasterSamples_; idx++)
-                    {
-                        processPerSampleOperations(x, y, screenPos.z, builtIn.FragColor, idx);
-                    }
-                }
+                continue;
+            }
+            auto it = std::find_if(visibilitySamplers_.begin(), visibilitySamplers_.end(),
+                                   [sampler](const VisibilitySampler &entry)
+                                   { return entry.sampler == sampler && entry.version == sampler->getVersion(); });
+            if (it == visibilitySamplers_.end())
+            {
+                visibilitySamplers_.push_back({sampler, sampler->getVersion(), sampler->clone()});
+                it = visibilitySamplers_.end() - 1;
             }
+            shaderProgram_->rebindUniformSampler(record.uniforms.get(), it->snapshot.get(), location);
         }
+
+        visibilityPrimitiveCnt_ += primitiveCnt;
     }
 
-    void RendererSoft::rasterizationLine(VertexHolder *v0, VertexHolder *v1, float lineWidth)
+    void RendererSoft::flushVisibilityBuffer()
     {
-        // TODO diamond-exit rule
-        int x0 = (int)v0->fragPos.x, y0 = (int)v0->fragPos.y;
-        int x1 = (int)v1->fragPos.x, y1 = (int)v1->fragPos.y;
-
-        float z0 = v0->fragPos.z;
-        float z1 = v1->fragPos.z;
-
-        float w0 = v0->fragPos.w;
-        float w1 = v1->fragPos.w;
-
-        bool steep = false;
-        if (std::abs(x0 - x1) < std::abs(y0 - y1))
+        if (visibilityDraws_.empty())
         {
-            std::swap(x0, y0);
-            std::swap(x1, y1);
-            steep = true;
+            return;
         }
 
-        const float *varyingsIn[2] = {v0->varyings, v1->varyings};
-
-        if (x0 > x1)
+        size_t varyingsAlignedCnt = 0;
+        for (auto &record : visibilityDraws_)
         {
-            std::swap(x0, x1);
-            std::swap(y0, y1);
-            std::swap(z0, z1);
-            std::swap(w0, w1);
-            std::swap(varyingsIn[0], varyingsIn[1]);
+            varyingsAlignedCnt = std::max(varyingsAlignedCnt, record.varyingsAlignedCnt);
         }
-        int dx = x1 - x0;
-        int dy = y1 - y0;
-
-        int error = 0;
-        int dError = 2 * std::abs(dy);
-
-        int y = y0;
-
-        auto varyings = AlignedMemory::makeBuffer<float>(varyingsCnt_);
-        VertexHolder pt{};
-        pt.varyings = varyings.get();
-
-        float t = 0;
-        for (int x = x0; x <= x1; x++)
+        threadQuadCtx_.resize(threadPool_.getThreadCnt());
+        for (auto &ctx : threadQuadCtx_)
         {
-            t = (float)(x - x0) / (float)dx;
-            pt.fragPos = glm::vec4(x, y, glm::mix(z0, z1, t), glm::mix(w0, w1, t));
-            if (steep)
-            {
-                std::swap(pt.fragPos.x, pt.fragPos.y);
-            }
-            interpolateLinear(pt.varyings, varyingsIn, varyingsCnt_, t);
-            rasterizationPoint(&pt, lineWidth);
-
-            error += dError;
-            if (error > dx)
-            {
-                y += (y1 > y0 ? 1 : -1);
-                error -= 2 * dx;
-            }
+            ctx.SetVaryingsSize(varyingsAlignedCnt);
         }
-    }
-
-    void RendererSoft::rasterizationTriangle(VertexHolder *v0, VertexHolder *v1, VertexHolder *v2, bool frontFacing)
-    {
-        // TODO top-left rule
-        VertexHolder *vert[3] = {v0, v1, v2};
-        glm::aligned_vec4 screenPos[3] = {vert[0]->fragPos, vert[1]->fragPos, vert[2]->fragPos};
-        BoundingBox bounds = triangleBoundingBox(screenPos, viewport_.width, viewport_.height);
-        bounds.min -= 1.f;
 
-        auto blockSize = rasterBlockSize_;
-        int blockCntX = (bounds.max.x - bounds.min.x + blockSize - 1.f) / blockSize;
-        int blockCntY = (bounds.max.y - bounds.min.y + blockSize - 1.f) / blockSize;
+        // every recorded draw is single sample
+        int samples = rasterSamples_;
+        rasterSamples_ = 1;
 
-        for (int blockY = 0; blockY < blockCntY; blockY++)
+        auto shade = [this](size_t begin, size_t end, size_t thread_id)
         {
-            for (int blockX = 0; blockX < blockCntX; blockX++)
+            for (size_t idx = begin; idx < end; idx++)
             {
+                shadeVisibilityTile(rasterTiles_[idx], threadQuadCtx_[thread_id], (int)thread_id);
+            }
+        };
 #ifdef RASTER_MULTI_THREAD
-                threadPool_.pushTask([&, vert, bounds, blockSize, blockX, blockY](int thread_id)
-                                     {
-                                         // init pixel quad
-                                         auto pixelQuad = threadQuadCtx_[thread_id];
+        threadPool_.parallelFor(0, rasterTiles_.size(), 1, shade);
 #else
-                auto pixelQuad = threadQuadCtx_[0];
-#endif
-                                         pixelQuad.frontFacing = frontFacing;
-
-                                         for (int i = 0; i < 3; i++)
-                                         {
-                                             pixelQuad.vertPos[i] = vert[i]->fragPos;
-                                             pixelQuad.vertZ[i] = &vert[i]->fragPos.z;
-                                             pixelQuad.vertW[i] = vert[i]->fragPos.w;
-                                             pixelQuad.vertVaryings[i] = vert[i]->varyings;
-                                         }
-
-                                         glm::aligned_vec4 *vertPos = pixelQuad.vertPos;
-                                         pixelQuad.vertPosFlat[0] = {vertPos[2].x, vertPos[1].x, vertPos[0].x, 0.f};
-                                         pixelQuad.vertPosFlat[1] = {vertPos[2].y, vertPos[1].y, vertPos[0].y, 0.f};
-                                         pixelQuad.vertPosFlat[2] = {vertPos[0].z, vertPos[1].z, vertPos[2].z, 0.f};
-                                         pixelQuad.vertPosFlat[3] = {vertPos[0].w, vertPos[1].w, vertPos[2].w, 0.f};
-
-                                         // block rasterization
-                                         int blockStartX = bounds.min.x + blockX * blockSize;
-                                         int blockStartY = bounds.min.y + blockY * blockSize;
-                                         for (int y = blockStartY + 1; y < blockStartY + blockSize && y <= bounds.max.y; y += 2)
-                                         {
-                                             for (int x = blockStartX + 1; x < blockStartX + blockSize && x <= bounds.max.x; x += 2)
-                                             {
-                                                 pixelQuad.Init((float)x, (float)y, rasterSamples_);
-                                                 rasterizationPixelQuad(pixelQuad);
-                                             }
-                                         }
-#ifdef RASTER_MULTI_THREAD
-                                     });
+        shade(0, rasterTiles_.size(), 0);
 #endif
-            }
-        }
+
+        rasterSamples_ = samples;
+        // the clones still point at the recorded uniforms, rebind them on the next draw
+        threadProgramsId_ = -1;
+        std::fill(visibilityIds_.begin(), visibilityIds_.end(), 0);
+        visibilityDraws_.clear();
+        visibilitySamplers_.clear();
+        visibilityPrimitiveCnt_ = 0;
     }
 
-    void RendererSoft::rasterizationPixelQuad(PixelQuadContext &quad)
+    void RendererSoft::shadeVisibilityTile(const RasterTile &tile, PixelQuadContext &quad, int threadId)
     {
-        glm::aligned_vec4 *vert = quad.vertPosFlat;
-        glm::aligned_vec4 &v0 = quad.vertPos[0];
-
-        // barycentric
-        for (auto &pixel : quad.pixels)
+        int tileMaxX = std::min(tile.x + tile.width, fboColor_->width);
+        int tileMaxY = std::min(tile.y + tile.height, fboColor_->height);
+        for (int y = tile.y; y < tileMaxY; y += 2)
         {
-            for (auto &sample : pixel.samples)
+            for (int x = tile.x; x < tileMaxX; x += 2)
             {
-                sample.inside = barycentric(vert, v0, sample.position, sample.barycentric);
+                uint32_t ids[4];
+                for (int p = 0; p < 4; p++)
+                {
+                    int px = x + (p & 1);
+                    int py = y + (p >> 1);
+                    ids[p] = (px < tileMaxX && py < tileMaxY) ? visibilityIds_[(size_t)py * fboColor_->width + px] : 0;
+                }
+
+                // shade each primitive visible in this quad once, other pixels act as helpers
+                for (int p = 0; p < 4; p++)
+                {
+                    uint32_t id = ids[p];
+                    if (id == 0 || (p > 0 && id == ids[0]) || (p > 1 && id == ids[1]) || (p > 2 && id == ids[2]))
+                    {
+                        continue;
+                    }
+                    int mask = 0;
+                    for (int i = 0; i < 4; i++)
+                    {
+                        if (ids[i] == id)
+                        {
+                            mask |= 1 << i;
+                        }
+                    }
+                    shadeVisibilityQuad(quad, x, y, id, mask, threadId);
+                }
             }
-            pixel.InitCoverage();
-            pixel.InitShadingSample();
         }
-        if (!quad.CheckInside())
+    }
+
+    void RendererSoft::shadeVisibilityQuad(PixelQuadContext &quad, int x, int y, uint32_t id, int mask, int threadId)
+    {
+        // find the draw by its first primitive id
+        auto it = std::upper_bound(visibilityDraws_.begin(), visibilityDraws_.end(), id - 1,
+                                   [](uint32_t value, const VisibilityDraw &record)
+                                   { return value < record.primitiveBase; });
+        auto &record = *(it - 1);
+        auto &triangle = record.primitives[id - 1 - record.primitiveBase];
+
+        // the cached clone of this worker, draws of the same program only differ in their uniforms
+        auto &program = record.threadPrograms[threadId];
+        program->bindUniformBuffer(record.uniforms);
+
+        DerivativeContext &df_ctx = program->getShaderBuiltin().dfCtx;
+        df_ctx.p0 = quad.pixels[0].varyingsFrag;
+        df_ctx.p1 = quad.pixels[1].varyingsFrag;
+        df_ctx.p2 = quad.pixels[2].varyingsFrag;
+        df_ctx.p3 = quad.pixels[3].varyingsFrag;
+
+        VertexHolder *vert[3] = {&record.vertexes[triangle.indices[0]],
+                                 &record.vertexes[triangle.indices[1]],
+                                 &record.vertexes[triangle.indices[2]]};
+        if (!setupTriangle(quad, vert, triangle.frontFacing))
         {
             return;
         }
 
+        quad.Init((float)x, (float)y, 1);
+        quad.setup.SetSpanOrigin(x, y);
+        initQuadCoverage(quad, mask, 0);
+
         for (auto &pixel : quad.pixels)
         {
-            for (auto &sample : pixel.samples)
+            auto &sample = pixel.samples[0];
+            if (sample.inside)
             {
-                if (!sample.inside)
-                {
-                    continue;
-                }
-
-                // interpolate z, w
                 interpolateBarycentric(&sample.position.z, quad.vertZ, 2, sample.barycentric);
-
-                // depth clipping
-                if (sample.position.z < viewport_.absMinDepth || sample.position.z > viewport_.absMaxDepth)
-                {
-                    sample.inside = false;
-                }
-
-                // barycentric correction
                 sample.barycentric *= (1.f / sample.position.w * quad.vertW);
             }
         }
 
-        // early z
-        if (earlyZ_ && renderState_->depthTest)
-        {
-            if (!earlyZTest(quad))
-            {
-                return;
-            }
-        }
-
-        // varying interpolate
-        // note: all quad pixels should perform varying interpolate to enable varying partial derivative
         for (auto &pixel : quad.pixels)
         {
             interpolateBarycentric((float *)pixel.varyingsFrag,
                                    quad.vertVaryings,
-                                   varyingsCnt_,
+                                   record.varyingsCnt,
                                    pixel.sampleShading->barycentric);
         }
 
-        // pixel shading
-        for (auto &pixel : quad.pixels)
+        bool batchShading = batchShading_ && program->hasFragmentShaderBatch();
+        if (batchShading)
+        {
+            processFragmentShaderBatch(quad, record.varyingsCnt, program.get());
+        }
+
+        // depth is already resolved and blending is disabled, write color directly
+        for (int i = 0; i < 4; i++)
         {
+            auto &pixel = quad.pixels[i];
             if (!pixel.inside)
             {
                 continue;
             }
-
-            // fragment shader
-            processFragmentShader(pixel.sampleShading->position,
-                                  quad.frontFacing,
-                                  pixel.varyingsFrag,
-                                  quad.shaderProgram.get());
-
-            // sample coverage
-            auto &builtIn = quad.shaderProgram->getShaderBuiltin();
-
-            // per-sample operations
-            if (pixel.sampleCount > 1)
+            auto &sample = pixel.samples[0];
+            glm::vec4 color;
+            if (batchShading)
             {
-                for (int idx = 0; idx < pixel.sampleCount; idx++)
-                {
-                    auto &sample = pixel.samples[idx];
-                    if (!sample.inside)
-                    {
-                        continue;
-                    }
-                    processPerSampleOperations(sample.fboCoord.x, sample.fboCoord.y, sample.position.z, builtIn.FragColor, idx);
-                }
+                color = quad.batch.fragColor.get(i);
             }
             else
             {
-                auto &sample = *pixel.sampleShading;
-                processPerSampleOperations(sample.fboCoord.x, sample.fboCoord.y, sample.position.z, builtIn.FragColor, 0);
+                processFragmentShader(sample.position, quad.frontFacing, pixel.varyingsFrag, program.get());
+                color = program->getShaderBuiltin().FragColor;
             }
+            color = glm::clamp(color, 0.f, 1.f);
+            setFrameColor(sample.fboCoord.x, sample.fboCoord.y, color * 255.f, 0);
         }
     }
 
-    bool RendererSoft::earlyZTest(PixelQuadContext &quad)
+    void RendererSoft::setupResolveTiles(bool allDirty)
     {
-        for (auto &pixel : quad.pixels)
+        // color target changed inside the pass, resolve what the previous one has pending
+        if (resolveColor_ != fboColor_)
         {
-            if (!pixel.inside)
-            {
-                continue;
-            }
-            if (pixel.sampleCount > 1)
-            {
-                bool inside = false;
-                for (int idx = 0; idx < pixel.sampleCount; idx++)
-                {
-                    auto &sample = pixel.samples[idx];
-                    if (!sample.inside)
-                    {
-                        continue;
-                    }
-                    sample.inside = processDepthTest(sample.fboCoord.x, sample.fboCoord.y, sample.position.z, idx, true);
-                    if (sample.inside)
-                    {
-                        inside = true;
-                    }
-                }
-                pixel.inside = inside;
-            }
-            else
-            {
-                auto &sample = *pixel.sampleShading;
-                sample.inside = processDepthTest(sample.fboCoord.x, sample.fboCoord.y, sample.position.z, 0, true);
-                pixel.inside = sample.inside;
-            }
+            multiSampleResolve();
+            resolveColor_ = fboColor_;
+            resolveTileCntX_ = (fboColor_->width + rasterTileSize_ - 1) / rasterTileSize_;
+            resolveTileCntY_ = (fboColor_->height + rasterTileSize_ - 1) / rasterTileSize_;
+            resolveDirty_.assign(resolveTileCntX_ * resolveTileCntY_, 0);
+        }
+        if (allDirty)
+        {
+            std::fill(resolveDirty_.begin(), resolveDirty_.end(), 1);
         }
-        return quad.CheckInside();
     }
 
-    void RendererSoft::multiSampleResolve()
+    void RendererSoft::markResolveTile(const RasterTile &tile)
+    {
+        if (!resolveColor_ || resolveColor_ != fboColor_)
+        {
+            return;
+        }
+        int tx = tile.x / rasterTileSize_;
+        int ty = tile.y / rasterTileSize_;
+        if (tx < resolveTileCntX_ && ty < resolveTileCntY_)
+        {
+            resolveDirty_[ty * resolveTileCntX_ + tx] = 1;
+        }
+    }
+
+    void RendererSoft::materializeClearTile(const RasterTile &tile)
     {
-        if (!fboColor_->buffer)
+        if (fboColor_)
+        {
+            fboColor_->materializeRect(tile.x, tile.y, tile.x + tile.width, tile.y + tile.height);
+        }
+        if (fboDepth_)
         {
-            fboColor_->buffer = Buffer<RGBA>::makeDefault(fboColor_->width, fboColor_->height);
+            fboDepth_->materializeRect(tile.x, tile.y, tile.x + tile.width, tile.y + tile.height);
         }
+    }
 
-        auto *srcPtr = fboColor_->bufferMs4x->getRawDataPtr();
-        auto *dstPtr = fboColor_->buffer->getRawDataPtr();
+    void RendererSoft::multiSampleResolve()
+    {
+        if (!resolveColor_)
+        {
+            return;
+        }
+        if (!resolveColor_->buffer)
+        {
+            resolveColor_->buffer = Buffer<RGBA>::makeDefault(resolveColor_->width, resolveColor_->height);
+        }
 
-        for (size_t row = 0; row < fboColor_->height; row++)
+        auto resolve = [this](size_t begin, size_t end, size_t thread_id)
         {
-            auto *rowSrc = srcPtr + row * fboColor_->width;
-            auto *rowDst = dstPtr + row * fboColor_->width;
-#ifdef RASTER_MULTI_THREAD
-            threadPool_.pushTask([&, rowSrc, rowDst](int thread_id)
-                                 {
-#endif
-                                     auto *src = rowSrc;
-                                     auto *dst = rowDst;
-                                     for (size_t idx = 0; idx < fboColor_->width; idx++)
-                                     {
-                                         glm::vec4 color(0.f);
-                                         for (int i = 0; i < fboColor_->sampleCnt; i++)
-                                         {
-                                             color += (glm::vec4)(*src)[i];
-                                         }
-                                         color /= fboColor_->sampleCnt;
-                                         *dst = color;
-                                         src++;
-                                         dst++;
-                                     }
+            for (size_t tileIdx = begin; tileIdx < end; tileIdx++)
+            {
+                if (resolveDirty_[tileIdx])
+                {
+                    resolveDirty_[tileIdx] = 0;
+                    multiSampleResolveTile((int)tileIdx);
+                }
+            }
+        };
 #ifdef RASTER_MULTI_THREAD
-                                 });
+        threadPool_.parallelFor(0, resolveDirty_.size(), 0, resolve);
+#else
+        resolve(0, resolveDirty_.size(), 0);
 #endif
+        resolveColor_ = nullptr;
+    }
+
+    void RendererSoft::multiSampleResolveTile(int tileIdx)
+    {
+        auto &color = *resolveColor_;
+        int x0 = (tileIdx % resolveTileCntX_) * rasterTileSize_;
+        int y0 = (tileIdx / resolveTileCntX_) * rasterTileSize_;
+        int x1 = std::min(x0 + rasterTileSize_, (int)color.width);
+        int y1 = std::min(y0 + rasterTileSize_, (int)color.height);
+        const int sampleCnt = color.sampleCnt;
+
+        int sampleShift = 0;
+        while ((1 << sampleShift) < sampleCnt)
+        {
+            sampleShift++;
         }
 
-        threadPool_.waitTasksFinish();
+        for (int y = y0; y < y1; y++)
+        {
+            const uint8_t *uniform = color.uniformMs.data() + (size_t)y * color.width;
+            auto *dst = color.buffer->getRawDataPtr() + (size_t)y * color.width;
+            for (int x = x0; x < x1; x++)
+            {
+                if (color.isClearPending(x, y))
+                {
+                    dst[x] = color.clearValue;
+                    continue;
+                }
+                const RGBA *src = color.getSamples(x, y);
+                if (uniform[x])
+                {
+                    dst[x] = src[0];
+                    continue;
+                }
+#ifdef SOFTGL_SIMD_OPT
+                // 4 samples are 16 bytes, widen to 16 bit and accumulate (16 * 255 fits), then shift and pack
+                if (sampleCnt >= 4)
+                {
+                    __m128i sum = _mm_setzero_si128();
+                    for (int i = 0; i < sampleCnt; i += 4)
+                    {
+                        __m128i samples = _mm_loadu_si128((const __m128i *)(src + i));
+                        sum = _mm_add_epi16(sum, _mm_add_epi16(_mm_cvtepu8_epi16(samples), _mm_cvtepu8_epi16(_mm_srli_si128(samples, 8))));
+                    }
+                    sum = _mm_add_epi16(sum, _mm_srli_si128(sum, 8));
+                    __m128i avg = _mm_srl_epi16(sum, _mm_cvtsi32_si128(sampleShift));
+                    int32_t packed = _mm_cvtsi128_si32(_mm_packus_epi16(avg, avg));
+                    memcpy(&dst[x], &packed, sizeof(packed));
+                    continue;
+                }
+#endif
+                // integer average, same truncation as the float resolve
+                glm::ivec4 sum(0);
+                for (int i = 0; i < sampleCnt; i++)
+                {
+                    sum += glm::ivec4(src[i]);
+                }
+                dst[x] = RGBA(sum >> sampleShift);
+            }
+        }
     }
 
     RGBA *RendererSoft::getFrameColor(int x, int y, int sample)
@@ -1061,10 +3181,9 @@ namespace Learn
         RGBA *ptr = nullptr;
         if (fboColor_->multiSample)
         {
-            auto *ptrMs = fboColor_->bufferMs4x->get(x, y);
-            if (ptrMs)
+            if (x >= 0 && y >= 0 && x < fboColor_->width && y < fboColor_->height)
             {
-                ptr = (RGBA *)ptrMs + sample;
+                ptr = fboColor_->getSampleForWrite(x, y, sample);
             }
         }
         else
@@ -1085,10 +3204,9 @@ namespace Learn
         float *depthPtr = nullptr;
         if (fboDepth_->multiSample)
         {
-            auto *ptr = fboDepth_->bufferMs4x->get(x, y);
-            if (ptr)
+            if (x >= 0 && y >= 0 && x < fboDepth_->width && y < fboDepth_->height)
             {
-                depthPtr = &ptr->x + sample;
+                depthPtr = fboDepth_->getSampleForWrite(x, y, sample);
             }
         }
         else
@@ -1098,6 +3216,23 @@ namespace Learn
         return depthPtr;
     }
 
+    bool RendererSoft::readFrameDepth(int x, int y, int sample, float &depth)
+    {
+        if (!fboDepth_ || x < 0 || y < 0 || x >= fboDepth_->width || y >= fboDepth_->height)
+        {
+            return false;
+        }
+        if (fboDepth_->multiSample)
+        {
+            depth = fboDepth_->getSample(x, y, sample);
+        }
+        else
+        {
+            depth = fboDepth_->isClearPending(x, y) ? fboDepth_->clearValue : *fboDepth_->buffer->get(x, y);
+        }
+        return true;
+    }
+
     void RendererSoft::setFrameColor(int x, int y, const RGBA &color, int sample)
     {
         RGBA *ptr = getFrameColor(x, y, sample);
@@ -1126,13 +3261,27 @@ namespace Learn
 
     void RendererSoft::vertexShaderImpl(VertexHolder &vertex)
     {
-        shaderProgram_->bindVertexAttributes(vertex.vertex);
-        shaderProgram_->bindVertexShaderVaryings(vertex.varyings);
-        shaderProgram_->execVertexShader();
-
+        vertexShaderImpl(vertex, shaderProgram_);
         pointSize_ = shaderProgram_->getShaderBuiltin().PointSize;
-        vertex.clipPos = shaderProgram_->getShaderBuiltin().Position;
+    }
+
+    void RendererSoft::vertexShaderImpl(VertexHolder &vertex, ShaderProgramSoft *program)
+    {
+        program->bindVertexAttributes(vertex.vertex);
+        if (positionOnly_)
+        {
+            program->execVertexShaderPosition();
+        }
+        else
+        {
+            program->bindVertexShaderVaryings(vertex.varyings);
+            program->execVertexShader();
+        }
+
+        // clip mask in the same pass, the position is still hot
+        vertex.clipPos = program->getShaderBuiltin().Position;
         vertex.clipMask = countFrustumClipMask(vertex.clipPos);
+        vertex.guardBandMask = vertex.clipMask ? countGuardBandClipMask(vertex.clipPos) : 0;
     }
 
     void RendererSoft::perspectiveDivideImpl(VertexHolder &vertex)
@@ -1168,6 +3317,23 @@ namespace Learn
         return mask;
     }
 
+    int RendererSoft::countGuardBandClipMask(glm::vec4 &clipPos)
+    {
+        // near and far planes are always clipped, x and y only beyond the guard band
+        int mask = countFrustumClipMask(clipPos) & (FrustumClipMask::POSITIVE_Z | FrustumClipMask::NEGATIVE_Z);
+        float guardX = clipPos.w * viewport_.guardBandX;
+        float guardY = clipPos.w * viewport_.guardBandY;
+        if (guardX < clipPos.x)
+            mask |= FrustumClipMask::POSITIVE_X;
+        if (guardX < -clipPos.x)
+            mask |= FrustumClipMask::NEGATIVE_X;
+        if (guardY < clipPos.y)
+            mask |= FrustumClipMask::POSITIVE_Y;
+        if (guardY < -clipPos.y)
+            mask |= FrustumClipMask::NEGATIVE_Y;
+        return mask;
+    }
+
     BoundingBox RendererSoft::triangleBoundingBox(glm::vec4 *vert, float width, float height)
     {
         float minX = std::min(std::min(vert[0].x, vert[1].x), vert[2].x);
@@ -1185,53 +3351,10 @@ namespace Learn
         return {min, max};
     }
 
-    bool RendererSoft::barycentric(glm::aligned_vec4 *vert, glm::aligned_vec4 &v0, glm::aligned_vec4 &p,
-                                   glm::aligned_vec4 &bc)
-    {
-#ifdef SOFTGL_SIMD_OPT
-        // Ref: https://geometrian.com/programming/tutorials/cross-product/index.php
-        __m128 vec0 = _mm_sub_ps(_mm_load_ps(&vert[0].x), _mm_set_ps(0, p.x, v0.x, v0.x));
-        __m128 vec1 = _mm_sub_ps(_mm_load_ps(&vert[1].x), _mm_set_ps(0, p.y, v0.y, v0.y));
-
-        __m128 tmp0 = _mm_shuffle_ps(vec0, vec0, _MM_SHUFFLE(3, 0, 2, 1));
-        __m128 tmp1 = _mm_shuffle_ps(vec1, vec1, _MM_SHUFFLE(3, 1, 0, 2));
-        __m128 tmp2 = _mm_mul_ps(tmp0, vec1);
-        __m128 tmp3 = _mm_shuffle_ps(tmp2, tmp2, _MM_SHUFFLE(3, 0, 2, 1));
-        __m128 u = _mm_sub_ps(_mm_mul_ps(tmp0, tmp1), tmp3);
-
-        if (std::abs(MM_F32(u, 2)) < FLT_EPSILON)
-        {
-            return false;
-        }
-
-        u = _mm_div_ps(u, _mm_set1_ps(MM_F32(u, 2)));
-        bc = {1.f - (MM_F32(u, 0) + MM_F32(u, 1)), MM_F32(u, 1), MM_F32(u, 0), 0.f};
-#else
-        glm::vec3 u = glm::cross(glm::vec3(vert[0]) - glm::vec3(v0.x, v0.x, p.x),
-                                 glm::vec3(vert[1]) - glm::vec3(v0.y, v0.y, p.y));
-        if (std::abs(u.z) < FLT_EPSILON)
-        {
-            return false;
-        }
-
-        u /= u.z;
-        bc = {1.f - (u.x + u.y), u.y, u.x, 0.f};
-#endif
-
-        if (bc.x < 0 || bc.y < 0 || bc.z < 0)
-        {
-            return false;
-        }
-
-        return true;
-    }
-
     void RendererSoft::interpolateVertex(VertexHolder &out, VertexHolder &v0, VertexHolder &v1, float t)
     {
-        out.vertexHolder = AlignedMemory::makeBuffer<uint8_t>(vao_->vertexStride);
-        out.vertex = out.vertexHolder.get();
-        out.varyingsHolder = AlignedMemory::makeAlignedBuffer<float>(varyingsAlignedCnt_);
-        out.varyings = out.varyingsHolder.get();
+        out.vertex = frameArena_.alloc<uint8_t>(vao_->vertexStride);
+        out.varyings = frameArena_.alloc<float>(varyingsAlignedCnt_);
 
         // interpolate vertex (only support float element right now)
         const float *vertexIn[2] = {(float *)v0.vertex, (float *)v1.vertex};
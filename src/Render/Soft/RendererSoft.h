@@ -1,11 +1,20 @@
 #pragma once
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 #include "RendererInternal.h"
 #include "Utils/Geometry.h"
+#include "Utils/Arena.h"
 #include "Utils/ThreadPool.h"
 #include "Render/Base/Renderer.h"
 #include "VertexSoft.h"
 #include "FrameBufferSoft.h"
+#include "PipelineStatesSoft.h"
+#include "SamplerSoft.h"
+#include "UniformSoft.h"
+#include "CommandListSoft.h"
 
 namespace Learn
 {
@@ -16,6 +25,7 @@ namespace Learn
         PrimitiveType primitiveType_ = Primitive_TRIANGLE;
         FrameBufferSoft *fbo_ = nullptr;
         const RenderStates *renderState_ = nullptr;
+        PipelineStatesSoft *pipelineStates_ = nullptr;
         VertexArrayObjectSoft *vao_ = nullptr;
         ShaderProgramSoft *shaderProgram_ = nullptr;
 
@@ -24,22 +34,113 @@ namespace Learn
 
         std::vector<VertexHolder> vertexes_;
         std::vector<PrimitiveHolder> primitives_;
+        std::vector<PrimitiveHolder> clippedPrimitives_;
 
-        std::shared_ptr<float> varyings_ = nullptr;
+        // points or lines generated from triangles in polygon point/line mode, with their dedup state
+        std::vector<PrimitiveHolder> polygonPrimitives_;
+        std::vector<uint8_t> vertexDrawn_;
+        std::vector<uint64_t> edgeTable_;
+
+        // pipeline temporaries (vertex varyings, clipped vertices), released when the next render pass begins
+        Arena frameArena_;
+
+        float *varyings_ = nullptr;
         size_t varyingsCnt_ = 0;
         size_t varyingsAlignedCnt_ = 0;
         size_t varyingsAlignedSize_ = 0;
 
         float pointSize_ = 1.f;
         bool earlyZ_ = true;
+        bool guardBand_ = true;
+        bool microTriangle_ = true;
+        bool microMerge_ = false;
+        bool batchShading_ = true;
+        bool depthOnly_ = true;
+        bool depthOnlyPass_ = false;
+        bool positionOnly_ = false;
         int rasterSamples_ = 1;
-        int rasterBlockSize_ = 32;
+        OutputMergerKernels outputMerger_;
+        OutputMergerContext outputMergerCtx_;
+        int rasterTileSize_ = 32;
+        int rasterBlockSize_ = 8;
+        size_t vertexChunkSize_ = 4096;
+
+        // sort-middle binning: every tile is rasterized by exactly one worker
+        std::vector<RasterTile> rasterTiles_;
+        int rasterTileCntX_ = 0;
+        int rasterTileCntY_ = 0;
+        std::vector<PrimitiveHolder> *rasterPrimitives_ = nullptr; // primitives referenced by the tile bins
+        PrimitiveType rasterPrimitiveType_ = Primitive_TRIANGLE;
+
+        // hierarchical z, one tile per raster block of the depth attachment
+        std::vector<HiZTile> hizTiles_;
+        int hizTileCntX_ = 0;
+        int hizTileCntY_ = 0;
+        ImageBufferSoft<float> *hizDepth_ = nullptr;
+
+        // multi-sample color target and its tiles written since the last resolve, resolved when the pass ends
+        std::shared_ptr<ImageBufferSoft<RGBA>> resolveColor_ = nullptr;
+        std::vector<uint8_t> resolveDirty_;
+        int resolveTileCntX_ = 0;
+        int resolveTileCntY_ = 0;
 
-        ThreadPool threadPool_;
+        // visibility buffer: draws write depth and primitive id, shading runs once per visible pixel on flush
+        bool visibilityBuffer_ = false;
+        bool visibilityPass_ = false;
+        std::vector<uint32_t> visibilityIds_;
+        std::vector<VisibilityDraw> visibilityDraws_;
+        uint32_t visibilityPrimitiveCnt_ = 0;
+        uint32_t visibilityPrimitiveBase_ = 0;
+        std::vector<VisibilitySampler> visibilitySamplers_;
+
+        ThreadPool &threadPool_ = ThreadPool::shared(); // frame lane of the process wide scheduler
+        std::vector<std::shared_ptr<ShaderProgramSoft>> threadPrograms_; // per worker clones of the bound program
+        int threadProgramsId_ = -1;
+        std::unordered_map<int, ThreadProgramSet> threadProgramCache_; // by program id
+        BindingTableCache bindingTables_; // executing thread
+        uint64_t renderPassCnt_ = 0;
+        const uint64_t passCacheMaxAge_ = 64; // passes a cached program set or binding table survives unused
         std::vector<PixelQuadContext> threadQuadCtx_;
 
+        // command list mode: pipeline calls are recorded by the caller and replayed in order on the submit thread
+        bool commandList_ = false;
+        std::unique_ptr<CommandListSoft> recordList_;
+        uint64_t recordSerial_ = 1; // serial of the list being recorded
+        BindingTableCache recordBindingTables_; // recording thread, aged by the passes it records
+        std::vector<std::unique_ptr<CommandListSoft>> freeLists_;
+        std::deque<std::unique_ptr<CommandListSoft>> submitQueue_;
+        std::thread submitThread_;
+        std::mutex submitMutex_;
+        std::condition_variable submitCv_;
+        std::condition_variable idleCv_;
+        bool submitBusy_ = false;
+        bool submitExit_ = false;
+
+        // recording side state, uniform locations and attachment snapshots are resolved when recorded
+        FrameBufferSoft *recordFbo_ = nullptr;
+        std::shared_ptr<FrameBufferSoft> recordFboSnapshot_;
+        ShaderProgramSoft *recordProgram_ = nullptr;
+
+        // replay side, keeps the bound objects alive across command lists, samplers are private to the submit thread
+        std::shared_ptr<FrameBuffer> boundFbo_;
+        std::shared_ptr<VertexArrayObject> boundVao_;
+        std::shared_ptr<ShaderProgram> boundProgram_;
+        std::shared_ptr<PipelineStates> boundStates_;
+        std::unordered_map<int, std::shared_ptr<SamplerSoft>> replaySamplers_;
+
+        // present ring, the latest completed frame is shown while later frames render
+        std::vector<std::shared_ptr<Buffer<RGBA>>> presentBuffers_;
+        int presentBufferCnt_ = 3;
+        int presentLatest_ = -1;
+        int presentAcquired_ = -1;
+        uint64_t framesSubmitted_ = 0;
+        uint64_t framesPresented_ = 0;
+
     public:
+        ~RendererSoft();
+
         RendererType type() override { return Renderer_Soft; }
+        void destroy() override;
 
         // framebuffer
         std::shared_ptr<FrameBuffer> createFrameBuffer(bool offscreen) override;
@@ -71,21 +172,48 @@ namespace Learn
         void endRenderPass() override;
         void waitIdle() override;
 
+        // copies the resolved color into the present ring once everything recorded before it has executed
+        void present(std::shared_ptr<Texture> &color);
+        // latest completed frame, stays valid until the next acquire
+        std::shared_ptr<Buffer<RGBA>> acquirePresentBuffer();
+
     public:
         inline void setEnableEarlyZ(bool enable) { earlyZ_ = enable; };
+        inline void setEnableVisibilityBuffer(bool enable) { visibilityBuffer_ = enable; };
+        inline void setEnableBatchShading(bool enable) { batchShading_ = enable; };
+        inline void setEnableDepthOnly(bool enable) { depthOnly_ = enable; };
+        inline void setEnableGuardBand(bool enable) { guardBand_ = enable; };
+        inline void setEnableMicroTriangle(bool enable) { microTriangle_ = enable; };
+        void setEnableCommandList(bool enable);
+        void setPresentBufferCnt(int cnt);
 
     private:
+        inline bool recordingCommands() const
+        {
+            return commandList_ && std::this_thread::get_id() != submitThread_.get_id();
+        }
+        void recordShaderResources(ShaderResources &resources);
+        void recordDraw();
+        void submitCommands();
+        void submitLoop();
+        void executeCommands(CommandListSoft &list);
+        void presentImpl(ImageBufferSoft<RGBA> &color);
+
         void processVertexShader();
+        void vertexShaderChunk(size_t begin, size_t end, float *varyingBuffer, ShaderProgramSoft *program);
+        void setupThreadPrograms();
+        void evictPassCaches();
+        void evictBindingTables(BindingTableCache &cache);
+        ResourceBindingTableSoft &getBindingTable(BindingTableCache &cache, ShaderProgramSoft &program,
+                                                  const ShaderResources &resources);
         void processPrimitiveAssembly();
         void processClipping();
         void processPerspectiveDivide();
         void processViewportTransform();
-        void processFaceCulling();
         void processRasterization();
         void processFragmentShader(glm::vec4 &screenPos, bool frontFacing, void *varyings, ShaderProgramSoft *shader);
-        void processPerSampleOperations(int x, int y, float depth, const glm::vec4 &color, int sample);
+        void processFragmentShaderBatch(PixelQuadContext &quad, size_t varyingsCnt, ShaderProgramSoft *shader);
         bool processDepthTest(int x, int y, float depth, int sample, bool skipWrite);
-        void processColorBlending(int x, int y, glm::vec4 &color, int sample);
 
         void processPointAssembly();
         void processLineAssembly();
@@ -100,30 +228,68 @@ namespace Learn
         void interpolateBarycentric(float *varsOut, const float *varsIn[3], size_t elemCnt, glm::aligned_vec4 &bc);
         void interpolateBarycentricSIMD(float *varsOut, const float *varsIn[3], size_t elemCnt, glm::aligned_vec4 &bc);
 
-        void rasterizationPoint(VertexHolder *v, float pointSize);
-        void rasterizationLine(VertexHolder *v0, VertexHolder *v1, float lineWidth);
-        void rasterizationTriangle(VertexHolder *v0, VertexHolder *v1, VertexHolder *v2, bool frontFacing);
+        void rasterizationPoint(VertexHolder *v, float pointSize, const RasterTile &tile, PixelQuadContext &quad);
+        void rasterizationPointPixel(glm::vec4 &screenPos, void *varyings, ShaderProgramSoft *program);
+        void rasterizationLine(VertexHolder *v0, VertexHolder *v1, float lineWidth, const RasterTile &tile, PixelQuadContext &quad);
+        void rasterizationTriangle(VertexHolder *v0, VertexHolder *v1, VertexHolder *v2, bool frontFacing,
+                                   const RasterTile &tile, PixelQuadContext &quad);
+        void rasterizationTile(RasterTile &tile, PixelQuadContext &quad);
+        void rasterizationMicroTriangle(const PrimitiveHolder &triangle, const RasterTile &tile, PixelQuadContext &quad);
+        void mergeMicroQuad(PixelQuadContext &quad, int x, int y, uint64_t mask, int laneBase);
+        void flushMicroQuad(PixelQuadContext &quad);
+        bool rasterizationBlock(const RasterTile &tile, const BoundingBox &bounds, bool fullCovered, PixelQuadContext &quad);
         void rasterizationPolygons(std::vector<PrimitiveHolder> &primitives);
         void rasterizationPolygonsPoint(std::vector<PrimitiveHolder> &primitives);
         void rasterizationPolygonsLine(std::vector<PrimitiveHolder> &primitives);
         void rasterizationPolygonsTriangle(std::vector<PrimitiveHolder> &primitives);
+        void rasterizationTiles(std::vector<PrimitiveHolder> &primitives, PrimitiveType type);
         void rasterizationPixelQuad(PixelQuadContext &quad);
+        void shadePixelQuad(PixelQuadContext &quad);
+        void rasterizationDepthSpan(const TriangleSetup &setup, int x, int y, uint64_t mask);
+        bool checkDepthOnlyEligible();
+
+        void setupRasterTiles();
+        void binningTriangles(std::vector<PrimitiveHolder> &primitives);
+        void binningPoints(std::vector<PrimitiveHolder> &primitives);
+        void binningLines(std::vector<PrimitiveHolder> &primitives);
+        void binPixelRect(uint32_t idx, int minX, int minY, int maxX, int maxY);
+
+        bool setupTriangle(PixelQuadContext &quad, VertexHolder *vert[3], bool frontFacing);
+        uint64_t triangleCoverage(PixelQuadContext &quad, int x, int y);
+        void initQuadCoverage(PixelQuadContext &quad, uint64_t mask, int laneBase);
+
+        void resetHiZ(float depth);
+        void rebuildHiZ();
+        bool hiZReject(int x, int y, float zMin, float zMax);
+        void updateHiZ(int x, int y, float zMin, float zMax, bool fullCovered);
 
         bool earlyZTest(PixelQuadContext &quad);
+        void setupResolveTiles(bool allDirty);
+        void markResolveTile(const RasterTile &tile);
+        void materializeClearTile(const RasterTile &tile);
         void multiSampleResolve();
+        void multiSampleResolveTile(int tileIdx);
+
+        bool checkVisibilityEligible();
+        void writeVisibility(PixelQuadContext &quad);
+        void recordVisibilityDraw();
+        void flushVisibilityBuffer();
+        void shadeVisibilityTile(const RasterTile &tile, PixelQuadContext &quad, int threadId);
+        void shadeVisibilityQuad(PixelQuadContext &quad, int x, int y, uint32_t id, int mask, int threadId);
 
     private:
         inline RGBA *getFrameColor(int x, int y, int sample);
         inline float *getFrameDepth(int x, int y, int sample);
+        inline bool readFrameDepth(int x, int y, int sample, float &depth);
         inline void setFrameColor(int x, int y, const RGBA &color, int sample);
 
         size_t clippingNewVertex(size_t idx0, size_t idx1, float t, bool postVertexProcess = false);
         void vertexShaderImpl(VertexHolder &vertex);
+        void vertexShaderImpl(VertexHolder &vertex, ShaderProgramSoft *program);
         void perspectiveDivideImpl(VertexHolder &vertex);
         void viewportTransformImpl(VertexHolder &vertex);
         int countFrustumClipMask(glm::vec4 &clipPos);
+        int countGuardBandClipMask(glm::vec4 &clipPos);
         BoundingBox triangleBoundingBox(glm::vec4 *vert, float width, float height);
-
-        bool barycentric(glm::aligned_vec4 *vert, glm::aligned_vec4 &v0, glm::aligned_vec4 &p, glm::aligned_vec4 &bc);
     };
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <functional>
+#include "Utils/ThreadPool.h"
 #include "TextureSoft.h"
 
 namespace Learn
@@ -93,6 +94,21 @@ namespace Learn
                 lod += (*BaseSampler<T>::lodFunc_)(this);
             return texture2DLodImpl(uv, lod);
         }
+        // pixel quad lookup, lod is computed once from the quad derivatives
+        void texture2DQuadImpl(const glm::vec2 *uv, int mask, T *out, float bias = 0.f)
+        {
+            float lod = bias;
+            if (BaseSampler<T>::useMipmaps && BaseSampler<T>::lodFunc_)
+                lod += (*BaseSampler<T>::lodFunc_)(this);
+            for (int i = 0; i < 4; i++)
+            {
+                if ((mask >> i) & 1)
+                {
+                    glm::vec2 coord = uv[i];
+                    out[i] = texture2DLodImpl(coord, lod);
+                }
+            }
+        }
     };
 
     template <typename T>
@@ -272,15 +288,29 @@ namespace Learn
         float ratio_x = (float)src->getWidth() / (float)dst->getWidth();
         float ratio_y = (float)src->getHeight() / (float)dst->getHeight();
         glm::vec2 delta = glm::vec2(ratio_x, ratio_y) * 0.5f;
-        for (int y = 0; y < dst->getHeight(); y++)
+        auto sampleRect = [&](size_t x0, size_t y0, size_t x1, size_t y1, size_t thread_id)
         {
-            for (int x = 0; x < dst->getWidth(); x++)
+            for (int y = (int)y0; y < (int)y1; y++)
             {
-                glm::vec2 uv = glm::vec2(x, y) * glm::vec2(ratio_x, ratio_y) + delta;
-                auto color = samplePixelBilinear(src, uv, Wrap_CLAMP_TO_BORDER, border);
-                dst->set(x, y, color);
+                for (int x = (int)x0; x < (int)x1; x++)
+                {
+                    glm::vec2 uv = glm::vec2(x, y) * glm::vec2(ratio_x, ratio_y) + delta;
+                    auto color = samplePixelBilinear(src, uv, Wrap_CLAMP_TO_BORDER, border);
+                    dst->set(x, y, color);
+                }
             }
+        };
+
+        // the small levels of a chain are not worth a round trip to the pool
+        const size_t tileSize = 64;
+        size_t width = dst->getWidth();
+        size_t height = dst->getHeight();
+        if (width <= tileSize && height <= tileSize)
+        {
+            sampleRect(0, 0, width, height, 0);
+            return;
         }
+        ThreadPool::shared().parallelFor2D(width, height, tileSize, tileSize, sampleRect);
     }
 
     template <typename T>
@@ -419,6 +449,18 @@ namespace Learn
     public:
         virtual TextureType texType() = 0;
         virtual void setTexture(const std::shared_ptr<Texture> &tex) = 0;
+        virtual std::shared_ptr<SamplerSoft> clone() const = 0;
+        // render targets keep untouched tiles as pending clears, they are written before being sampled
+        virtual void materializeClears() = 0;
+
+        // bumped when the sampler is pointed at another texture
+        inline uint32_t getVersion() const
+        {
+            return version_;
+        }
+
+    protected:
+        uint32_t version_ = 0;
     };
 
     template <typename T>
@@ -436,13 +478,31 @@ namespace Learn
 
         void setTexture(const std::shared_ptr<Texture> &tex) override
         {
-            tex_ = dynamic_cast<TextureSoft<T> *>(tex.get());
+            auto *texSoft = dynamic_cast<TextureSoft<T> *>(tex.get());
+            if (texSoft != tex_)
+            {
+                version_++;
+            }
+            tex_ = texSoft;
             tex_->getBorderColor(sampler_.borderColor());
             sampler_.setFilterMode(tex_->getSamplerDesc().filterMin);
             sampler_.setWrapMode(tex_->getSamplerDesc().wrapS);
             sampler_.setImage(&tex_->getImage());
         }
 
+        std::shared_ptr<SamplerSoft> clone() const override
+        {
+            return std::make_shared<Sampler2DSoft<T>>(*this);
+        }
+
+        void materializeClears() override
+        {
+            if (tex_)
+            {
+                tex_->getImage().materializeClears();
+            }
+        }
+
         inline TextureSoft<T> *getTexture() const
         {
             return tex_;
@@ -458,6 +518,11 @@ namespace Learn
             return sampler_.texutre2DImpl(coord, bias);
         }
 
+        inline void texture2DQuad(const glm::vec2 *coord, int mask, T *out, float bias = 0.f)
+        {
+            sampler_.texture2DQuadImpl(coord, mask, out, bias);
+        }
+
         inline T texture2DLod(glm::vec2 coord, float lod = 0.f)
         {
             return sampler_.texture2DLodImpl(coord, lod);
@@ -484,7 +549,12 @@ namespace Learn
 
         void setTexture(const std::shared_ptr<Texture> &tex) override
         {
-            tex_ = dynamic_cast<TextureSoft<T> *>(tex.get());
+            auto *texSoft = dynamic_cast<TextureSoft<T> *>(tex.get());
+            if (texSoft != tex_)
+            {
+                version_++;
+            }
+            tex_ = texSoft;
             tex_->getBorderColor(sampler_.borderColor());
             sampler_.setFilterMode(tex_->getSamplerDesc().filterMin);
             sampler_.setWrapMode(tex_->getSamplerDesc().wrapS);
@@ -494,6 +564,22 @@ namespace Learn
             }
         }
 
+        std::shared_ptr<SamplerSoft> clone() const override
+        {
+            return std::make_shared<SamplerCubeSoft<T>>(*this);
+        }
+
+        void materializeClears() override
+        {
+            if (tex_)
+            {
+                for (int i = 0; i < 6; i++)
+                {
+                    tex_->getImage((CubeMapFace)i).materializeClears();
+                }
+            }
+        }
+
         inline TextureSoft<T> *getTexture() const
         {
             return tex_;
@@ -0,0 +1,314 @@
+#pragma once
+
+#include <cmath>
+#include "Utils/GLM_Header.h"
+#include "Utils/SIMD.h"
+
+namespace Learn
+{
+    // SoA types for batched fragment shading, one lane per pixel of a 2x2 pixel quad
+    // lane i is quad pixel i (p0 p1 bottom, p2 p3 top)
+    constexpr int BatchLanes = 4;
+    constexpr int BatchLaneMask = (1 << BatchLanes) - 1;
+
+    // math functions are found by ADL only, so they never hide the scalar ones (abs, min, max...)
+    namespace Batch
+    {
+        struct BatchMask
+        {
+#ifdef SOFTGL_SIMD_OPT
+            __m128 v;
+
+            BatchMask() : v(_mm_setzero_ps()) {}
+            explicit BatchMask(__m128 m) : v(m) {}
+
+            inline int bits() const { return _mm_movemask_ps(v); }
+            inline BatchMask operator&(const BatchMask &o) const { return BatchMask(_mm_and_ps(v, o.v)); }
+            inline BatchMask operator|(const BatchMask &o) const { return BatchMask(_mm_or_ps(v, o.v)); }
+            inline BatchMask operator!() const { return BatchMask(_mm_xor_ps(v, _mm_castsi128_ps(_mm_set1_epi32(-1)))); }
+#else
+            int m = 0;
+
+            BatchMask() = default;
+            explicit BatchMask(int bits) : m(bits & BatchLaneMask) {}
+
+            inline int bits() const { return m; }
+            inline BatchMask operator&(const BatchMask &o) const { return BatchMask(m & o.m); }
+            inline BatchMask operator|(const BatchMask &o) const { return BatchMask(m | o.m); }
+            inline BatchMask operator!() const { return BatchMask(~m); }
+#endif
+            inline bool any() const { return bits() != 0; }
+            inline bool all() const { return bits() == BatchLaneMask; }
+        };
+
+        struct BatchFloat
+        {
+#ifdef SOFTGL_SIMD_OPT
+            __m128 v;
+
+            BatchFloat() : v(_mm_setzero_ps()) {}
+            BatchFloat(float s) : v(_mm_set1_ps(s)) {}
+            explicit BatchFloat(__m128 m) : v(m) {}
+
+            static inline BatchFloat load(const float *ptr) { return BatchFloat(_mm_load_ps(ptr)); }
+            inline void store(float *ptr) const { _mm_store_ps(ptr, v); }
+#else
+            float v[BatchLanes];
+
+            BatchFloat() : v{0.f, 0.f, 0.f, 0.f} {}
+            BatchFloat(float s) : v{s, s, s, s} {}
+
+            static inline BatchFloat load(const float *ptr)
+            {
+                BatchFloat ret;
+                for (int i = 0; i < BatchLanes; i++)
+                {
+                    ret.v[i] = ptr[i];
+                }
+                return ret;
+            }
+            inline void store(float *ptr) const
+            {
+                for (int i = 0; i < BatchLanes; i++)
+                {
+                    ptr[i] = v[i];
+                }
+            }
+#endif
+
+            inline float get(int lane) const
+            {
+                alignas(16) float lanes[BatchLanes];
+                store(lanes);
+                return lanes[lane];
+            }
+            inline void set(int lane, float s)
+            {
+                alignas(16) float lanes[BatchLanes];
+                store(lanes);
+                lanes[lane] = s;
+                *this = load(lanes);
+            }
+
+            // lane-wise scalar function, for transcendental functions without a SIMD version
+            template <typename F>
+            inline BatchFloat map(F func) const
+            {
+                alignas(16) float lanes[BatchLanes];
+                store(lanes);
+                for (float &s : lanes)
+                {
+                    s = func(s);
+                }
+                return load(lanes);
+            }
+        };
+
+#ifdef SOFTGL_SIMD_OPT
+#define BATCH_FLOAT_BINARY(op, intrin)                                                     \
+        inline BatchFloat operator op(const BatchFloat &a, const BatchFloat &b)            \
+        {                                                                                  \
+            return BatchFloat(intrin(a.v, b.v));                                           \
+        }
+#define BATCH_FLOAT_COMPARE(op, cmp)                                                       \
+        inline BatchMask operator op(const BatchFloat &a, const BatchFloat &b)             \
+        {                                                                                  \
+            return BatchMask(_mm_cmp_ps(a.v, b.v, cmp));                                   \
+        }
+#else
+#define BATCH_FLOAT_BINARY(op, intrin)                                                     \
+        inline BatchFloat operator op(const BatchFloat &a, const BatchFloat &b)            \
+        {                                                                                  \
+            BatchFloat ret;                                                                \
+            for (int i = 0; i < BatchLanes; i++)                                           \
+            {                                                                              \
+                ret.v[i] = a.v[i] op b.v[i];                                               \
+            }                                                                              \
+            return ret;                                                                    \
+        }
+#define BATCH_FLOAT_COMPARE(op, cmp)                                                       \
+        inline BatchMask operator op(const BatchFloat &a, const BatchFloat &b)             \
+        {                                                                                  \
+            int bits = 0;                                                                  \
+            for (int i = 0; i < BatchLanes; i++)                                           \
+            {                                                                              \
+                bits |= (a.v[i] op b.v[i]) ? (1 << i) : 0;                                 \
+            }                                                                              \
+            return BatchMask(bits);                                                        \
+        }
+#endif
+
+        BATCH_FLOAT_BINARY(+, _mm_add_ps)
+        BATCH_FLOAT_BINARY(-, _mm_sub_ps)
+        BATCH_FLOAT_BINARY(*, _mm_mul_ps)
+        BATCH_FLOAT_BINARY(/, _mm_div_ps)
+
+        BATCH_FLOAT_COMPARE(<, _CMP_LT_OQ)
+        BATCH_FLOAT_COMPARE(<=, _CMP_LE_OQ)
+        BATCH_FLOAT_COMPARE(>, _CMP_GT_OQ)
+        BATCH_FLOAT_COMPARE(>=, _CMP_GE_OQ)
+
+#undef BATCH_FLOAT_BINARY
+#undef BATCH_FLOAT_COMPARE
+
+        inline BatchFloat operator-(const BatchFloat &a) { return BatchFloat(0.f) - a; }
+        inline BatchFloat &operator+=(BatchFloat &a, const BatchFloat &b) { return a = a + b; }
+        inline BatchFloat &operator-=(BatchFloat &a, const BatchFloat &b) { return a = a - b; }
+        inline BatchFloat &operator*=(BatchFloat &a, const BatchFloat &b) { return a = a * b; }
+        inline BatchFloat &operator/=(BatchFloat &a, const BatchFloat &b) { return a = a / b; }
+
+#ifdef SOFTGL_SIMD_OPT
+        inline BatchFloat min(const BatchFloat &a, const BatchFloat &b) { return BatchFloat(_mm_min_ps(a.v, b.v)); }
+        inline BatchFloat max(const BatchFloat &a, const BatchFloat &b) { return BatchFloat(_mm_max_ps(a.v, b.v)); }
+        inline BatchFloat sqrt(const BatchFloat &a) { return BatchFloat(_mm_sqrt_ps(a.v)); }
+        inline BatchFloat abs(const BatchFloat &a) { return BatchFloat(_mm_andnot_ps(_mm_set1_ps(-0.f), a.v)); }
+
+        // mask ? a : b
+        inline BatchFloat select(const BatchMask &mask, const BatchFloat &a, const BatchFloat &b)
+        {
+            return BatchFloat(_mm_blendv_ps(b.v, a.v, mask.v));
+        }
+#else
+        inline BatchFloat min(const BatchFloat &a, const BatchFloat &b)
+        {
+            BatchFloat ret;
+            for (int i = 0; i < BatchLanes; i++)
+            {
+                ret.v[i] = std::min(a.v[i], b.v[i]);
+            }
+            return ret;
+        }
+        inline BatchFloat max(const BatchFloat &a, const BatchFloat &b)
+        {
+            BatchFloat ret;
+            for (int i = 0; i < BatchLanes; i++)
+            {
+                ret.v[i] = std::max(a.v[i], b.v[i]);
+            }
+            return ret;
+        }
+        inline BatchFloat sqrt(const BatchFloat &a) { return a.map([](float s) { return std::sqrt(s); }); }
+        inline BatchFloat abs(const BatchFloat &a) { return a.map([](float s) { return std::fabs(s); }); }
+
+        inline BatchFloat select(const BatchMask &mask, const BatchFloat &a, const BatchFloat &b)
+        {
+            BatchFloat ret;
+            for (int i = 0; i < BatchLanes; i++)
+            {
+                ret.v[i] = ((mask.m >> i) & 1) ? a.v[i] : b.v[i];
+            }
+            return ret;
+        }
+#endif
+
+        inline BatchFloat clamp(const BatchFloat &a, const BatchFloat &lo, const BatchFloat &hi) { return min(max(a, lo), hi); }
+        inline BatchFloat mix(const BatchFloat &a, const BatchFloat &b, const BatchFloat &t) { return a + (b - a) * t; }
+        inline BatchFloat pow(const BatchFloat &a, float e) { return a.map([e](float s) { return std::pow(s, e); }); }
+        inline BatchFloat exp2(const BatchFloat &a) { return a.map([](float s) { return std::exp2(s); }); }
+        inline BatchFloat asin(const BatchFloat &a) { return a.map([](float s) { return std::asin(s); }); }
+
+        inline BatchFloat atan(const BatchFloat &y, const BatchFloat &x)
+        {
+            alignas(16) float ly[BatchLanes];
+            alignas(16) float lx[BatchLanes];
+            y.store(ly);
+            x.store(lx);
+            for (int i = 0; i < BatchLanes; i++)
+            {
+                ly[i] = std::atan2(ly[i], lx[i]);
+            }
+            return BatchFloat::load(ly);
+        }
+
+        struct BatchVec2
+        {
+            BatchFloat x, y;
+
+            BatchVec2() = default;
+            BatchVec2(const BatchFloat &s) : x(s), y(s) {}
+            BatchVec2(const BatchFloat &x, const BatchFloat &y) : x(x), y(y) {}
+            BatchVec2(const glm::vec2 &s) : x(s.x), y(s.y) {}
+
+            inline glm::vec2 get(int lane) const { return {x.get(lane), y.get(lane)}; }
+        };
+
+        struct BatchVec3
+        {
+            BatchFloat x, y, z;
+
+            BatchVec3() = default;
+            BatchVec3(const BatchFloat &s) : x(s), y(s), z(s) {}
+            BatchVec3(const BatchFloat &x, const BatchFloat &y, const BatchFloat &z) : x(x), y(y), z(z) {}
+            BatchVec3(const glm::vec3 &s) : x(s.x), y(s.y), z(s.z) {}
+
+            inline glm::vec3 get(int lane) const { return {x.get(lane), y.get(lane), z.get(lane)}; }
+        };
+
+        struct BatchVec4
+        {
+            BatchFloat x, y, z, w;
+
+            BatchVec4() = default;
+            BatchVec4(const BatchFloat &s) : x(s), y(s), z(s), w(s) {}
+            BatchVec4(const BatchFloat &x, const BatchFloat &y, const BatchFloat &z, const BatchFloat &w) : x(x), y(y), z(z), w(w) {}
+            BatchVec4(const BatchVec3 &v, const BatchFloat &w) : x(v.x), y(v.y), z(v.z), w(w) {}
+            BatchVec4(const glm::vec4 &s) : x(s.x), y(s.y), z(s.z), w(s.w) {}
+
+            inline BatchVec3 xyz() const { return {x, y, z}; }
+            inline glm::vec4 get(int lane) const { return {x.get(lane), y.get(lane), z.get(lane), w.get(lane)}; }
+            inline void set(int lane, const glm::vec4 &s)
+            {
+                x.set(lane, s.x);
+                y.set(lane, s.y);
+                z.set(lane, s.z);
+                w.set(lane, s.w);
+            }
+        };
+
+        // component-wise operators
+        inline BatchVec2 operator+(const BatchVec2 &a, const BatchVec2 &b) { return {a.x + b.x, a.y + b.y}; }
+        inline BatchVec2 operator-(const BatchVec2 &a, const BatchVec2 &b) { return {a.x - b.x, a.y - b.y}; }
+        inline BatchVec2 operator*(const BatchVec2 &a, const BatchVec2 &b) { return {a.x * b.x, a.y * b.y}; }
+        inline BatchVec2 operator*(const BatchVec2 &a, const BatchFloat &s) { return {a.x * s, a.y * s}; }
+        inline BatchVec2 operator+(const BatchVec2 &a, const BatchFloat &s) { return {a.x + s, a.y + s}; }
+
+        inline BatchVec3 operator+(const BatchVec3 &a, const BatchVec3 &b) { return {a.x + b.x, a.y + b.y, a.z + b.z}; }
+        inline BatchVec3 operator-(const BatchVec3 &a, const BatchVec3 &b) { return {a.x - b.x, a.y - b.y, a.z - b.z}; }
+        inline BatchVec3 operator*(const BatchVec3 &a, const BatchVec3 &b) { return {a.x * b.x, a.y * b.y, a.z * b.z}; }
+        inline BatchVec3 operator/(const BatchVec3 &a, const BatchVec3 &b) { return {a.x / b.x, a.y / b.y, a.z / b.z}; }
+        inline BatchVec3 operator-(const BatchVec3 &a) { return {-a.x, -a.y, -a.z}; }
+        inline BatchVec3 operator+(const BatchVec3 &a, const BatchFloat &s) { return {a.x + s, a.y + s, a.z + s}; }
+        inline BatchVec3 operator-(const BatchVec3 &a, const BatchFloat &s) { return {a.x - s, a.y - s, a.z - s}; }
+        inline BatchVec3 operator*(const BatchVec3 &a, const BatchFloat &s) { return {a.x * s, a.y * s, a.z * s}; }
+        inline BatchVec3 operator/(const BatchVec3 &a, const BatchFloat &s) { return {a.x / s, a.y / s, a.z / s}; }
+        inline BatchVec3 operator+(const BatchFloat &s, const BatchVec3 &a) { return a + s; }
+        inline BatchVec3 operator-(const BatchFloat &s, const BatchVec3 &a) { return {s - a.x, s - a.y, s - a.z}; }
+        inline BatchVec3 operator*(const BatchFloat &s, const BatchVec3 &a) { return a * s; }
+        inline BatchVec3 &operator+=(BatchVec3 &a, const BatchVec3 &b) { return a = a + b; }
+        inline BatchVec3 &operator*=(BatchVec3 &a, const BatchVec3 &b) { return a = a * b; }
+
+        inline BatchVec4 operator*(const BatchVec4 &a, const BatchVec4 &b) { return {a.x * b.x, a.y * b.y, a.z * b.z, a.w * b.w}; }
+        inline BatchVec4 operator+(const BatchVec4 &a, const BatchVec4 &b) { return {a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w}; }
+
+        inline BatchFloat dot(const BatchVec3 &a, const BatchVec3 &b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+        inline BatchVec3 cross(const BatchVec3 &a, const BatchVec3 &b)
+        {
+            return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+        }
+        inline BatchVec3 normalize(const BatchVec3 &a) { return a * (1.f / sqrt(dot(a, a))); }
+        inline BatchVec3 reflect(const BatchVec3 &i, const BatchVec3 &n) { return i - n * (dot(n, i) * 2.f); }
+        inline BatchVec3 mix(const BatchVec3 &a, const BatchVec3 &b, const BatchFloat &t) { return a + (b - a) * t; }
+        inline BatchVec3 max(const BatchVec3 &a, const BatchVec3 &b) { return {max(a.x, b.x), max(a.y, b.y), max(a.z, b.z)}; }
+        inline BatchVec3 pow(const BatchVec3 &a, float e) { return {pow(a.x, e), pow(a.y, e), pow(a.z, e)}; }
+        inline BatchVec3 select(const BatchMask &mask, const BatchVec3 &a, const BatchVec3 &b)
+        {
+            return {select(mask, a.x, b.x), select(mask, a.y, b.y), select(mask, a.z, b.z)};
+        }
+    }
+
+    using Batch::BatchMask;
+    using Batch::BatchFloat;
+    using Batch::BatchVec2;
+    using Batch::BatchVec3;
+    using Batch::BatchVec4;
+}
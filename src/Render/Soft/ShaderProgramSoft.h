@@ -7,6 +7,14 @@
 
 namespace Learn
 {
+    // uniform whose contents are in a location of the uniform memory, and the version that was copied
+    struct BoundUniformSoft
+    {
+        int uniformId = -1;
+        uint32_t version = 0;
+        uint64_t listSerial = 0; // command list it was recorded in, recording side only
+    };
+
     class ShaderProgramSoft : public ShaderProgram
     {
     private:
@@ -18,6 +26,9 @@ namespace Learn
 
         std::shared_ptr<uint8_t> definesBuffer_; // 0->false; 1->true
         std::shared_ptr<uint8_t> uniformBuffer_;
+        std::vector<BoundUniformSoft> boundUniforms_;    // by location
+        std::vector<BoundUniformSoft> recordedUniforms_; // by location, what the recorded commands bind
+        std::vector<SamplerSoft *> boundSamplers_;       // by location
 
         UID<ShaderProgramSoft> uuid_;
 
@@ -63,6 +74,9 @@ namespace Learn
             uniformBuffer_ = AlignedMemory::makeBuffer<uint8_t>(vertexShader_->getShaderUniformsSize());
             vertexShader_->bindShaderUniforms(uniformBuffer_.get());
             fragmentShader_->bindShaderUniforms(uniformBuffer_.get());
+            boundUniforms_.assign(vertexShader_->getUniformsDesc().size(), BoundUniformSoft());
+            recordedUniforms_.assign(vertexShader_->getUniformsDesc().size(), BoundUniformSoft());
+            boundSamplers_.assign(vertexShader_->getUniformsDesc().size(), nullptr);
 
             return true;
         }
@@ -75,6 +89,39 @@ namespace Learn
         {
             int offset = vertexShader_->GetUniformOffset(binding);
             memcpy(uniformBuffer_.get() + offset, data, len);
+            if (binding >= 0 && binding < (int)boundUniforms_.size())
+            {
+                boundUniforms_[binding] = BoundUniformSoft();
+            }
+        }
+
+        // copies the block only if another block or version is bound at this location, returns whether it copied
+        inline bool bindUniformBlockBuffer(void *data, size_t len, int binding, int uniformId, uint32_t version)
+        {
+            auto &bound = boundUniforms_[binding];
+            if (bound.uniformId == uniformId && bound.version == version)
+            {
+                return false;
+            }
+            int offset = vertexShader_->GetUniformOffset(binding);
+            memcpy(uniformBuffer_.get() + offset, data, len);
+            bound.uniformId = uniformId;
+            bound.version = version;
+            return true;
+        }
+
+        // recording side of the above, false if the commands recorded in this list already bind this version
+        inline bool recordUniformBinding(int binding, int uniformId, uint32_t version, uint64_t listSerial)
+        {
+            auto &recorded = recordedUniforms_[binding];
+            if (recorded.uniformId == uniformId && recorded.version == version && recorded.listSerial == listSerial)
+            {
+                return false;
+            }
+            recorded.uniformId = uniformId;
+            recorded.version = version;
+            recorded.listSerial = listSerial;
+            return true;
         }
 
         inline void bindUniformSampler(std::shared_ptr<SamplerSoft> &sampler, int binding)
@@ -82,6 +129,23 @@ namespace Learn
             int offset = vertexShader_->GetUniformOffset(binding);
             auto **ptr = reinterpret_cast<SamplerSoft **>(uniformBuffer_.get() + offset);
             *ptr = sampler.get();
+            if (binding >= 0 && binding < (int)boundSamplers_.size())
+            {
+                boundSamplers_[binding] = sampler.get();
+            }
+        }
+
+        // points a copy of the uniform memory at another sampler
+        inline void rebindUniformSampler(uint8_t *uniforms, SamplerSoft *sampler, int binding) const
+        {
+            int offset = vertexShader_->GetUniformOffset(binding);
+            *reinterpret_cast<SamplerSoft **>(uniforms + offset) = sampler;
+        }
+
+        // samplers the uniform memory points at, nullptr for locations without one
+        inline const std::vector<SamplerSoft *> &getBoundSamplers() const
+        {
+            return boundSamplers_;
         }
 
         inline void bindVertexShaderVaryings(void *ptr)
@@ -99,7 +163,8 @@ namespace Learn
             return vertexShader_->getShaderVaryingsSize();
         }
 
-        inline int getUniformLocation(const std::string &name)
+        // locations are fixed by the uniform descs once the shaders are set, the lookup only reads them
+        inline int getUniformLocation(const std::string &name) const
         {
             return vertexShader_->getUniformLocation(name);
         }
@@ -114,6 +179,16 @@ namespace Learn
             vertexShader_->shaderMain();
         }
 
+        inline bool hasVertexShaderPosition() const
+        {
+            return vertexShader_->hasPositionMain();
+        }
+
+        inline void execVertexShaderPosition()
+        {
+            vertexShader_->shaderMainPosition();
+        }
+
         inline void prepareFragmentShader()
         {
             fragmentShader_->prepareExecMain();
@@ -125,9 +200,30 @@ namespace Learn
             fragmentShader_->shaderMain();
         }
 
+        inline bool fragmentShaderDiscard() const
+        {
+            return fragmentShader_->hasDiscard();
+        }
+
+        inline bool hasFragmentShaderBatch() const
+        {
+            return fragmentShader_->hasBatchMain();
+        }
+
+        inline void execFragmentShaderBatch(FragmentBatch &batch)
+        {
+            fragmentShader_->setupSamplerDerivative();
+            fragmentShader_->shaderMainBatch(batch);
+        }
+
+        // per worker copy for shading. only the execution state is taken, the recording thread keeps
+        // updating the binding bookkeeping of this program while the submit thread clones it
         inline std::shared_ptr<ShaderProgramSoft> clone() const
         {
-            auto ret = std::make_shared<ShaderProgramSoft>(*this);
+            auto ret = std::make_shared<ShaderProgramSoft>();
+            ret->builtin_ = builtin_;
+            ret->definesBuffer_ = definesBuffer_;
+            ret->uniformBuffer_ = uniformBuffer_;
 
             ret->vertexShader_ = vertexShader_->clone();
             ret->fragmentShader_ = fragmentShader_->clone();
@@ -136,5 +232,31 @@ namespace Learn
 
             return ret;
         }
+
+        inline const std::shared_ptr<uint8_t> &getUniformBuffer() const
+        {
+            return uniformBuffer_;
+        }
+
+        // copy of the uniform values currently bound
+        inline std::shared_ptr<uint8_t> copyUniformBuffer() const
+        {
+            size_t size = vertexShader_->getShaderUniformsSize();
+            auto ret = AlignedMemory::makeBuffer<uint8_t>(size);
+            memcpy(ret.get(), uniformBuffer_.get(), size);
+            return ret;
+        }
+
+        // points both shaders at other uniform memory, clones share it with their source program otherwise
+        inline void bindUniformBuffer(const std::shared_ptr<uint8_t> &buffer)
+        {
+            if (uniformBuffer_ == buffer)
+            {
+                return;
+            }
+            uniformBuffer_ = buffer;
+            vertexShader_->bindShaderUniforms(buffer.get());
+            fragmentShader_->bindShaderUniforms(buffer.get());
+        }
     };
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include <functional>
 #include "SamplerSoft.h"
+#include "ShaderBatchSoft.h"
 
 namespace Learn
 {
@@ -43,6 +44,64 @@ namespace Learn
         DerivativeContext dfCtx;
     };
 
+    // one pixel quad shaded by a single call of the batch entry, lane i is quad pixel i
+    struct FragmentBatch
+    {
+        int mask = 0; // covered lanes, the others are helper lanes (derivatives only)
+        bool frontFacing = true;
+        BatchVec4 fragCoord;
+        BatchVec4 fragColor;
+
+        // per lane varyings (AoS, as used by derivatives and the scalar entry),
+        // and the same values in SoA layout: element e of lane i at varyings[e * BatchLanes + i]
+        float *laneVaryings[BatchLanes] = {nullptr, nullptr, nullptr, nullptr};
+        float *varyings = nullptr;
+
+        void transposeVaryings(size_t elemCnt)
+        {
+            for (size_t e = 0; e < elemCnt; e += 4)
+            {
+#ifdef SOFTGL_SIMD_OPT
+                __m128 r0 = _mm_load_ps(laneVaryings[0] + e);
+                __m128 r1 = _mm_load_ps(laneVaryings[1] + e);
+                __m128 r2 = _mm_load_ps(laneVaryings[2] + e);
+                __m128 r3 = _mm_load_ps(laneVaryings[3] + e);
+                _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+                _mm_store_ps(varyings + e * BatchLanes, r0);
+                _mm_store_ps(varyings + e * BatchLanes + 4, r1);
+                _mm_store_ps(varyings + e * BatchLanes + 8, r2);
+                _mm_store_ps(varyings + e * BatchLanes + 12, r3);
+#else
+                for (size_t k = e; k < e + 4; k++)
+                {
+                    for (int i = 0; i < BatchLanes; i++)
+                    {
+                        varyings[k * BatchLanes + i] = laneVaryings[i][k];
+                    }
+                }
+#endif
+            }
+        }
+
+        // offset: byte offset of the member in ShaderVaryings
+        inline BatchFloat varyingFloat(size_t offset) const
+        {
+            return BatchFloat::load(varyings + offset / sizeof(float) * BatchLanes);
+        }
+        inline BatchVec2 varyingVec2(size_t offset) const
+        {
+            return {varyingFloat(offset), varyingFloat(offset + sizeof(float))};
+        }
+        inline BatchVec3 varyingVec3(size_t offset) const
+        {
+            return {varyingFloat(offset), varyingFloat(offset + sizeof(float)), varyingFloat(offset + 2 * sizeof(float))};
+        }
+        inline BatchVec4 varyingVec4(size_t offset) const
+        {
+            return {varyingVec3(offset), varyingFloat(offset + 3 * sizeof(float))};
+        }
+    };
+
     class ShaderSoft
     {
     public:
@@ -64,6 +123,36 @@ namespace Learn
 
         virtual std::shared_ptr<ShaderSoft> clone() = 0;
 
+        // optional vertex shader entry that only writes gl->Position, used by passes consuming no varyings
+        virtual bool hasPositionMain() const
+        {
+            return false;
+        }
+        virtual void shaderMainPosition() {}
+
+        // fragment shaders that may set discard must override this, depth only draws skip shading otherwise
+        virtual bool hasDiscard() const
+        {
+            return false;
+        }
+
+        // optional SoA entry of fragment shaders, shades all lanes of a pixel quad in one call
+        virtual bool hasBatchMain() const
+        {
+            return false;
+        }
+        virtual void shaderMainBatch(FragmentBatch &batch) {}
+
+        // scalar entry for a single lane, used by lanes that leave the batch path
+        void shaderMainLane(FragmentBatch &batch, int lane)
+        {
+            gl->FragCoord = batch.fragCoord.get(lane);
+            gl->FrontFacing = batch.frontFacing;
+            bindShaderVaryings(batch.laneVaryings[lane]);
+            shaderMain();
+            batch.fragColor.set(lane, gl->FragColor);
+        }
+
         static inline glm::ivec2 textureSize(Sampler2DSoft<RGBA> *sampler, int lod)
         {
             auto &buffer = sampler->getTexture()->getImage().getBuffer(lod);
@@ -111,6 +200,81 @@ namespace Learn
             return ret / 255.f;
         }
 
+        // batch sampling, only lanes in mask are fetched (the others are left zero)
+        static inline BatchVec4 texelsToBatch(const RGBA *texels, int mask)
+        {
+            alignas(16) float rgba[4][BatchLanes] = {};
+            for (int i = 0; i < BatchLanes; i++)
+            {
+                if ((mask >> i) & 1)
+                {
+                    for (int c = 0; c < 4; c++)
+                    {
+                        rgba[c][i] = texels[i][c];
+                    }
+                }
+            }
+            return {BatchFloat::load(rgba[0]) / 255.f, BatchFloat::load(rgba[1]) / 255.f,
+                    BatchFloat::load(rgba[2]) / 255.f, BatchFloat::load(rgba[3]) / 255.f};
+        }
+
+        static inline BatchVec4 texture(Sampler2DSoft<RGBA> *sampler, const BatchVec2 &coord, int mask)
+        {
+            alignas(16) float u[BatchLanes];
+            alignas(16) float v[BatchLanes];
+            coord.x.store(u);
+            coord.y.store(v);
+
+            glm::vec2 uv[BatchLanes];
+            RGBA texels[BatchLanes];
+            for (int i = 0; i < BatchLanes; i++)
+            {
+                uv[i] = glm::vec2(u[i], v[i]);
+            }
+            sampler->texture2DQuad(uv, mask, texels);
+            return texelsToBatch(texels, mask);
+        }
+
+        static inline BatchVec4 textureLodOffset(Sampler2DSoft<RGBA> *sampler, const BatchVec2 &coord, float lod,
+                                                 glm::ivec2 offset, int mask)
+        {
+            RGBA texels[BatchLanes];
+            for (int i = 0; i < BatchLanes; i++)
+            {
+                if ((mask >> i) & 1)
+                {
+                    texels[i] = sampler->texture2DLodOffset(coord.get(i), lod, offset);
+                }
+            }
+            return texelsToBatch(texels, mask);
+        }
+
+        static inline BatchVec4 texture(SamplerCubeSoft<RGBA> *sampler, const BatchVec3 &coord, int mask)
+        {
+            RGBA texels[BatchLanes];
+            for (int i = 0; i < BatchLanes; i++)
+            {
+                if ((mask >> i) & 1)
+                {
+                    texels[i] = sampler->textureCube(coord.get(i));
+                }
+            }
+            return texelsToBatch(texels, mask);
+        }
+
+        static inline BatchVec4 textureLod(SamplerCubeSoft<RGBA> *sampler, const BatchVec3 &coord, const BatchFloat &lod, int mask)
+        {
+            RGBA texels[BatchLanes];
+            for (int i = 0; i < BatchLanes; i++)
+            {
+                if ((mask >> i) & 1)
+                {
+                    texels[i] = sampler->textureCubeLod(coord.get(i), lod.get(i));
+                }
+            }
+            return texelsToBatch(texels, mask);
+        }
+
         virtual size_t getSamplerDerivativeOffset(BaseSampler<RGBA> *sampler) const
         {
             return 0;
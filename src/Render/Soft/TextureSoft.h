@@ -11,18 +11,28 @@ namespace Learn
 
 #define SOFT_MS_CNT 4
 
+    // multi sample images keep sampleCnt samples per pixel, and a pixel whose samples are all
+    // equal is stored once in its first sample with the uniform flag set
     template <typename T>
     class ImageBufferSoft
     {
     public:
         std::shared_ptr<Buffer<T>> buffer;
-        std::shared_ptr<Buffer<glm::tvec4<T>>> bufferMs4x;
+        std::shared_ptr<Buffer<T>> bufferMs; // row linear, pixel (x, y) sample s at (y * width + x) * sampleCnt + s
+        std::vector<uint8_t> uniformMs;
 
         int width = 0;
         int height = 0;
         bool multiSample = false;
         int sampleCnt = 1;
 
+        // lazy clear, a pending tile reads as clearValue until materializeTile writes it
+        bool clearPending = false;
+        T clearValue = T(0);
+        int clearTileSize = 0;
+        int clearTileCntX = 0;
+        std::vector<uint8_t> clearTiles;
+
         ImageBufferSoft() = default;
         ImageBufferSoft(int w, int h, int samples = 1)
         {
@@ -35,13 +45,17 @@ namespace Learn
             {
                 buffer = Buffer<T>::makeDefault(w, h);
             }
-            else if(samples == 4)
+            else if (samples == 2 || samples == 4 || samples == 8 || samples == 16)
             {
-                bufferMs4x = Buffer<glm::tvec4<T>>::makeDefault(w, h);
+                bufferMs = Buffer<T>::makeLayout(w * samples, h, Layout_Linear);
+                uniformMs.assign((size_t)w * h, 1);
             }
             else
             {
                 LOG_ERROR("Unsupported sample count: {}", samples);
+                sampleCnt = 1;
+                multiSample = false;
+                buffer = Buffer<T>::makeDefault(w, h);
             }
         }
         explicit ImageBufferSoft(std::shared_ptr<Buffer<T>> buf)
@@ -52,6 +66,166 @@ namespace Learn
             sampleCnt = 1;
             buffer = buf;
         }
+
+        inline T *getSamples(int x, int y)
+        {
+            return bufferMs->getRawDataPtr() + ((size_t)y * width + x) * sampleCnt;
+        }
+
+        inline bool isUniform(int x, int y) const
+        {
+            return uniformMs[(size_t)y * width + x] != 0;
+        }
+
+        inline const T &getSample(int x, int y, int sample)
+        {
+            if (isClearPending(x, y))
+            {
+                return clearValue;
+            }
+            T *samples = getSamples(x, y);
+            return isUniform(x, y) ? samples[0] : samples[sample];
+        }
+
+        // a uniform pixel is expanded before one of its samples is written
+        inline T *getSampleForWrite(int x, int y, int sample)
+        {
+            expand(x, y);
+            return getSamples(x, y) + sample;
+        }
+
+        inline void setUniform(int x, int y, const T &value)
+        {
+            getSamples(x, y)[0] = value;
+            uniformMs[(size_t)y * width + x] = 1;
+        }
+
+        inline void expand(int x, int y)
+        {
+            uint8_t &uniform = uniformMs[(size_t)y * width + x];
+            if (uniform)
+            {
+                T *samples = getSamples(x, y);
+                for (int i = 1; i < sampleCnt; i++)
+                {
+                    samples[i] = samples[0];
+                }
+                uniform = 0;
+            }
+        }
+
+        void expandAll()
+        {
+            materializeAll();
+            for (int y = 0; y < height; y++)
+            {
+                for (int x = 0; x < width; x++)
+                {
+                    expand(x, y);
+                }
+            }
+        }
+
+        // clear writes one sample per pixel
+        void clearSamples(const T &value)
+        {
+            T *ptr = bufferMs->getRawDataPtr();
+            size_t pixelCnt = (size_t)width * height;
+            for (size_t i = 0; i < pixelCnt; i++)
+            {
+                ptr[i * sampleCnt] = value;
+            }
+            std::fill(uniformMs.begin(), uniformMs.end(), 1);
+            clearPending = false;
+        }
+
+        // records the clear per tile, nothing is written until a tile is first touched
+        void clearLazy(const T &value, int tileSize)
+        {
+            clearValue = value;
+            clearTileSize = tileSize;
+            clearTileCntX = (width + tileSize - 1) / tileSize;
+            int tileCntY = (height + tileSize - 1) / tileSize;
+            clearTiles.assign((size_t)clearTileCntX * tileCntY, 1);
+            clearPending = true;
+        }
+
+        inline bool isClearPending(int x, int y) const
+        {
+            return clearPending && clearTiles[(y / clearTileSize) * clearTileCntX + x / clearTileSize] != 0;
+        }
+
+        // tiles are written by one thread each, so no locking here
+        void materializeTile(int tileIdx)
+        {
+            uint8_t &pending = clearTiles[tileIdx];
+            if (!pending)
+            {
+                return;
+            }
+            pending = 0;
+
+            int x0 = (tileIdx % clearTileCntX) * clearTileSize;
+            int y0 = (tileIdx / clearTileCntX) * clearTileSize;
+            int x1 = std::min(x0 + clearTileSize, width);
+            int y1 = std::min(y0 + clearTileSize, height);
+            for (int y = y0; y < y1; y++)
+            {
+                if (multiSample)
+                {
+                    T *samples = getSamples(x0, y);
+                    for (int x = 0; x < x1 - x0; x++)
+                    {
+                        samples[x * sampleCnt] = clearValue;
+                    }
+                    auto uniform = uniformMs.begin() + (size_t)y * width;
+                    std::fill(uniform + x0, uniform + x1, 1);
+                }
+                else if (buffer->getLayout() == Layout_Linear)
+                {
+                    T *row = buffer->getRawDataPtr() + (size_t)y * width;
+                    std::fill(row + x0, row + x1, clearValue);
+                }
+                else
+                {
+                    for (int x = x0; x < x1; x++)
+                    {
+                        buffer->set(x, y, clearValue);
+                    }
+                }
+            }
+        }
+
+        // materializes the pending tiles overlapping [x0, x1) x [y0, y1)
+        void materializeRect(int x0, int y0, int x1, int y1)
+        {
+            if (!clearPending)
+            {
+                return;
+            }
+            x1 = std::min(x1, width);
+            y1 = std::min(y1, height);
+            for (int ty = y0 / clearTileSize; ty * clearTileSize < y1; ty++)
+            {
+                for (int tx = x0 / clearTileSize; tx * clearTileSize < x1; tx++)
+                {
+                    materializeTile(ty * clearTileCntX + tx);
+                }
+            }
+        }
+
+        void materializeAll()
+        {
+            if (!clearPending)
+            {
+                return;
+            }
+            for (int i = 0; i < (int)clearTiles.size(); i++)
+            {
+                materializeTile(i);
+            }
+            clearPending = false;
+        }
     };
 
     template <typename T>
@@ -71,10 +245,34 @@ namespace Learn
         {
             return empty() ? 0 : levels[0]->height;
         }
+        // readers see the whole level, pending clear tiles of a single sample level are written first
         inline std::shared_ptr<ImageBufferSoft<T>> &getBuffer(uint32_t level = 0)
+        {
+            auto &buffer = levels[level];
+            if (buffer->clearPending && !buffer->multiSample)
+            {
+                buffer->materializeAll();
+            }
+            return buffer;
+        }
+
+        // the level as render passes and present use it, pending clear tiles stay pending
+        inline std::shared_ptr<ImageBufferSoft<T>> &getAttachmentBuffer(uint32_t level = 0)
         {
             return levels[level];
         }
+
+        // writes the pending clear tiles of every single sample level
+        void materializeClears()
+        {
+            for (auto &buffer : levels)
+            {
+                if (buffer->clearPending && !buffer->multiSample)
+                {
+                    buffer->materializeAll();
+                }
+            }
+        }
         void generateMipmap(bool sample = true);
         // {
         //     //不需要在这里实现,具体实现在SamplerSoft
@@ -102,6 +300,7 @@ namespace Learn
             usage = desc.usage;
             useMipmaps = desc.useMipmaps;
             multiSample = desc.multiSample;
+            sampleCount = desc.sampleCount;
 
             switch (type)
             {
@@ -156,7 +355,7 @@ namespace Learn
             for (auto &image : images_)
             {
                 image.levels.resize(1);
-                image.levels[0] = std::make_shared<ImageBufferSoft<T>>(width, height, multiSample ? SOFT_MS_CNT : 1);
+                image.levels[0] = std::make_shared<ImageBufferSoft<T>>(width, height, multiSample ? sampleCount : 1);
                 if (useMipmaps)
                 {
                     image.generateMipmap(false);
@@ -202,9 +401,11 @@ namespace Learn
                 for (int level = 0; level < layer.levels.size(); level++)
                 {
                     auto &img = layer.getBuffer(level);
+                    img->clearPending = false;
                     if (multiSample)
                     {
-                        file.read((char *)img->bufferMs4x->getRawDataPtr(), img->bufferMs4x->getRawDataBytesSize());
+                        file.read((char *)img->bufferMs->getRawDataPtr(), img->bufferMs->getRawDataBytesSize());
+                        std::fill(img->uniformMs.begin(), img->uniformMs.end(), 0);
                     }
                     else
                     {
@@ -240,10 +441,12 @@ namespace Learn
                     auto &img = layer.getBuffer(level);
                     if (multiSample)
                     {
-                        file.write((char *)img->bufferMs4x->getRawDataPtr(), img->bufferMs4x->getRawDataBytesSize());
+                        img->expandAll();
+                        file.write((char *)img->bufferMs->getRawDataPtr(), img->bufferMs->getRawDataBytesSize());
                     }
                     else
                     {
+                        img->materializeAll();
                         file.write((char *)img->buffer->getRawDataPtr(), img->buffer->getRawDataBytesSize());
                     }
                 }
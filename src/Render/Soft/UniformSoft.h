@@ -10,6 +10,7 @@ namespace Learn
     {
     private:
         std::vector<uint8_t> buffer_;
+        uint32_t version_ = 0; // bumped on every update, programs skip copying versions they already hold
     public:
         UniformBlockSoft(const std::string &name, int size) : UniformBlock(name, size)
         {
@@ -31,22 +32,40 @@ namespace Learn
         void setSubData(void *data, int len, int offset) override
         {
             memcpy(buffer_.data() + offset, data, len);
+            version_++;
         }
 
         void setData(void *data, int len) override
         {
             setSubData(data, len, 0);
         }
+
+        inline const std::vector<uint8_t> &getBuffer() const
+        {
+            return buffer_;
+        }
+
+        inline uint32_t getVersion() const
+        {
+            return version_;
+        }
     };
 
     class UniformSamplerSoft : public UniformSampler
     {
     private:
         std::shared_ptr<SamplerSoft> sampler_;
+        std::shared_ptr<Texture> texture_;
+        uint32_t version_ = 0; // bumped when the texture changes
 
     public:
         explicit UniformSamplerSoft(const std::string &name, TextureType type, TextureFormat format)
             : UniformSampler(name, type, format)
+        {
+            sampler_ = createSampler(type, format);
+        }
+
+        static std::shared_ptr<SamplerSoft> createSampler(TextureType type, TextureFormat format)
         {
             switch (type)
             {
@@ -54,28 +73,24 @@ namespace Learn
                 switch (format)
                 {
                 case TextureFormat_RGBA8:
-                    sampler_ = std::make_shared<Sampler2DSoft<RGBA>>();
-                    break;
+                    return std::make_shared<Sampler2DSoft<RGBA>>();
                 case TextureFormat_FLOAT32:
-                    sampler_ = std::make_shared<Sampler2DSoft<float>>();
-                    break;
+                    return std::make_shared<Sampler2DSoft<float>>();
                 }
                 break;
             case TextureType_CUBE:
                 switch (format)
                 {
                 case TextureFormat_RGBA8:
-                    sampler_ = std::make_shared<SamplerCubeSoft<RGBA>>();
-                    break;
+                    return std::make_shared<SamplerCubeSoft<RGBA>>();
                 case TextureFormat_FLOAT32:
-                    sampler_ = std::make_shared<SamplerCubeSoft<float>>();
-                    break;
+                    return std::make_shared<SamplerCubeSoft<float>>();
                 }
                 break;
             default:
-                sampler_ = nullptr;
                 break;
             }
+            return nullptr;
         }
 
         int getLocation(ShaderProgram &program) override
@@ -92,7 +107,103 @@ namespace Learn
 
         void setTexture(const std::shared_ptr<Texture> &tex) override
         {
+            texture_ = tex;
             sampler_->setTexture(tex);
+            version_++;
         }
+
+        inline const std::shared_ptr<Texture> &getTexture() const
+        {
+            return texture_;
+        }
+
+        inline std::shared_ptr<SamplerSoft> &getSampler()
+        {
+            return sampler_;
+        }
+
+        inline uint32_t getVersion() const
+        {
+            return version_;
+        }
+    };
+
+    // one uniform of a binding table, resolved for the table's program
+    struct ResourceBindingSoft
+    {
+        int location = -1;
+        int uniformId = -1;
+        UniformBlockSoft *block = nullptr;
+        UniformSamplerSoft *sampler = nullptr;
+    };
+
+    // flattened bindings of a (program, resources) pair: locations and concrete types are resolved once,
+    // binding walks a vector instead of two maps with a location lookup per uniform
+    class ResourceBindingTableSoft
+    {
+    public:
+        std::vector<ResourceBindingSoft> bindings; // uniforms the program uses
+        uint64_t lastUsePass = 0;
+
+        // the resources still hold the uniforms the table was built from, compares pointers only
+        bool matches(const ShaderResources &resources) const
+        {
+            if (uniforms_.size() != resources.blocks.size() + resources.samplers.size())
+            {
+                return false;
+            }
+            size_t idx = 0;
+            for (auto &kv : resources.blocks)
+            {
+                if (uniforms_[idx++] != kv.second.get())
+                {
+                    return false;
+                }
+            }
+            for (auto &kv : resources.samplers)
+            {
+                if (uniforms_[idx++] != kv.second.get())
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void build(ShaderProgramSoft &program, const ShaderResources &resources)
+        {
+            uniforms_.clear();
+            bindings.clear();
+            for (auto &kv : resources.blocks)
+            {
+                add(program, kv.second.get(), dynamic_cast<UniformBlockSoft *>(kv.second.get()), nullptr);
+            }
+            for (auto &kv : resources.samplers)
+            {
+                add(program, kv.second.get(), nullptr, dynamic_cast<UniformSamplerSoft *>(kv.second.get()));
+            }
+        }
+
+    private:
+        void add(ShaderProgramSoft &program, Uniform *uniform, UniformBlockSoft *block, UniformSamplerSoft *sampler)
+        {
+            uniforms_.push_back(uniform);
+            // resolved by name instead of ShaderProgram::getLocation, whose cache would be written
+            // here on the recording thread while the submit thread clones the program
+            int location = program.getUniformLocation(uniform->name_);
+            if (location < 0)
+            {
+                return;
+            }
+            ResourceBindingSoft binding;
+            binding.location = location;
+            binding.uniformId = uniform->getHash();
+            binding.block = block;
+            binding.sampler = sampler;
+            bindings.push_back(binding);
+        }
+
+    private:
+        std::vector<const Uniform *> uniforms_; // every uniform of the resources in map order
     };
 }
\ No newline at end of file
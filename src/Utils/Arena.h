@@ -0,0 +1,108 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#include "AlignedMemory.h"
+
+namespace Learn
+{
+
+    // bump allocator, everything allocated is released at once by reset()
+    // blocks used since the last reset are merged into one, so a repeated workload stops allocating
+    class Arena
+    {
+    public:
+        explicit Arena(size_t blockSize = 1 << 20)
+            : blockSize_(blockSize)
+        {
+        }
+
+        ~Arena()
+        {
+            releaseBlocks();
+        }
+
+        Arena(const Arena &) = delete;
+        Arena &operator=(const Arena &) = delete;
+
+        template <typename T>
+        T *alloc(size_t cnt)
+        {
+            size_t size = alignSize(cnt * sizeof(T));
+            if (size == 0)
+            {
+                return nullptr;
+            }
+            if (blocks_.empty() || offset_ + size > blocks_.back().size)
+            {
+                newBlock(size);
+            }
+            auto *ptr = reinterpret_cast<T *>(blocks_.back().data + offset_);
+            offset_ += size;
+            return ptr;
+        }
+
+        void reset()
+        {
+            if (blocks_.size() > 1)
+            {
+                size_t capacity = getCapacity();
+                releaseBlocks();
+                newBlock(capacity);
+            }
+            offset_ = 0;
+        }
+
+        inline size_t getCapacity() const
+        {
+            size_t capacity = 0;
+            for (auto &block : blocks_)
+            {
+                capacity += block.size;
+            }
+            return capacity;
+        }
+
+        inline size_t getBlockCnt() const
+        {
+            return blocks_.size();
+        }
+
+    private:
+        struct Block
+        {
+            uint8_t *data = nullptr;
+            size_t size = 0;
+        };
+
+        static inline size_t alignSize(size_t size)
+        {
+            return (size + ALIGNED_MEMORY_ALIGNMENT - 1) & ~(size_t)(ALIGNED_MEMORY_ALIGNMENT - 1);
+        }
+
+        void newBlock(size_t minSize)
+        {
+            Block block;
+            block.size = std::max(blockSize_, minSize);
+            block.data = static_cast<uint8_t *>(AlignedMemory::alignedMalloc(block.size));
+            blocks_.push_back(block);
+            offset_ = 0;
+        }
+
+        void releaseBlocks()
+        {
+            for (auto &block : blocks_)
+            {
+                AlignedMemory::alignedFree(block.data);
+            }
+            blocks_.clear();
+            offset_ = 0;
+        }
+
+    private:
+        size_t blockSize_ = 0;
+        size_t offset_ = 0;
+        std::vector<Block> blocks_;
+    };
+
+}
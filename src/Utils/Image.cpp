@@ -4,8 +4,11 @@
 #include <stb/stb_image.h>
 #include <stb/stb_image_write.h>
 
+#include <mutex>
+
 #include "Image.h"
 #include "Logger.h"
+#include "ThreadPool.h"
 
 namespace Learn
 {
@@ -20,51 +23,55 @@ namespace Learn
         }
         auto buffer = Buffer<RGBA>::makeDefault(iw, ih);
 
-        // convert to rgba
-        for (size_t y = 0; y < ih; y++)
+        // convert to rgba, rows are independent
+        auto convertRows = [&](size_t begin, size_t end, size_t thread_id)
         {
-            for (size_t x = 0; x < iw; x++)
+            for (size_t y = begin; y < end; y++)
             {
-                auto &to = *buffer->get(x, y);
-                size_t idx = x + y * iw;
-
-                switch (n)
-                {
-                case STBI_grey:
-                {
-                    to.r = data[idx];
-                    to.g = to.b = to.r;
-                    to.a = 255;
-                    break;
-                }
-                case STBI_grey_alpha:
+                for (size_t x = 0; x < iw; x++)
                 {
-                    to.r = data[idx * 2 + 0];
-                    to.g = to.b = to.r;
-                    to.a = data[idx * 2 + 1];
-                    break;
-                }
-                case STBI_rgb:
-                {
-                    to.r = data[idx * 3 + 0];
-                    to.g = data[idx * 3 + 1];
-                    to.b = data[idx * 3 + 2];
-                    to.a = 255;
-                    break;
-                }
-                case STBI_rgb_alpha:
-                {
-                    to.r = data[idx * 4 + 0];
-                    to.g = data[idx * 4 + 1];
-                    to.b = data[idx * 4 + 2];
-                    to.a = data[idx * 4 + 3];
-                    break;
-                }
-                default:
-                    break;
+                    auto &to = *buffer->get(x, y);
+                    size_t idx = x + y * iw;
+
+                    switch (n)
+                    {
+                    case STBI_grey:
+                    {
+                        to.r = data[idx];
+                        to.g = to.b = to.r;
+                        to.a = 255;
+                        break;
+                    }
+                    case STBI_grey_alpha:
+                    {
+                        to.r = data[idx * 2 + 0];
+                        to.g = to.b = to.r;
+                        to.a = data[idx * 2 + 1];
+                        break;
+                    }
+                    case STBI_rgb:
+                    {
+                        to.r = data[idx * 3 + 0];
+                        to.g = data[idx * 3 + 1];
+                        to.b = data[idx * 3 + 2];
+                        to.a = 255;
+                        break;
+                    }
+                    case STBI_rgb_alpha:
+                    {
+                        to.r = data[idx * 4 + 0];
+                        to.g = data[idx * 4 + 1];
+                        to.b = data[idx * 4 + 2];
+                        to.a = data[idx * 4 + 3];
+                        break;
+                    }
+                    default:
+                        break;
+                    }
                 }
             }
-        }
+        };
+        ThreadPool::shared().parallelFor(0, ih, 0, convertRows);
 
         stbi_image_free(data);
 
@@ -80,31 +87,37 @@ namespace Learn
 
     void Image::convertFloatImage(RGBA *dst, float *src, uint32_t width, uint32_t height)
     {
-        float *srcPixel = src;
-
+        size_t pixelCnt = (size_t)width * height;
+        std::mutex rangeMutex;
         float depthMin = FLT_MAX;
         float depthMax = FLT_MIN;
-        for (int i = 0; i < width * height; i++)
+        auto findRange = [&](size_t begin, size_t end, size_t thread_id)
         {
-            float depth = *srcPixel;
-            depthMin = std::min(depthMin, depth);
-            depthMax = std::max(depthMax, depth);
-            srcPixel++;
-        }
+            float chunkMin = FLT_MAX;
+            float chunkMax = FLT_MIN;
+            for (size_t i = begin; i < end; i++)
+            {
+                chunkMin = std::min(chunkMin, src[i]);
+                chunkMax = std::max(chunkMax, src[i]);
+            }
+            std::lock_guard<std::mutex> lock(rangeMutex);
+            depthMin = std::min(depthMin, chunkMin);
+            depthMax = std::max(depthMax, chunkMax);
+        };
+        ThreadPool::shared().parallelFor(0, pixelCnt, 0, findRange);
 
-        srcPixel = src;
-        RGBA *dstPixel = dst;
-        for (int i = 0; i < width * height; i++)
+        auto convertPixels = [&](size_t begin, size_t end, size_t thread_id)
         {
-            float depth = *srcPixel;
-            depth = (depth - depthMin) / (depthMax - depthMin);
-            dstPixel->r = glm::clamp((int)(depth * 255.f), 0, 255);
-            dstPixel->g = dstPixel->r;
-            dstPixel->b = dstPixel->r;
-            dstPixel->a = 255;
-
-            srcPixel++;
-            dstPixel++;
-        }
+            for (size_t i = begin; i < end; i++)
+            {
+                float depth = (src[i] - depthMin) / (depthMax - depthMin);
+                RGBA &dstPixel = dst[i];
+                dstPixel.r = glm::clamp((int)(depth * 255.f), 0, 255);
+                dstPixel.g = dstPixel.r;
+                dstPixel.b = dstPixel.r;
+                dstPixel.a = 255;
+            }
+        };
+        ThreadPool::shared().parallelFor(0, pixelCnt, 0, convertPixels);
     }
 }
\ No newline at end of file
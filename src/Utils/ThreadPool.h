@@ -1,22 +1,251 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
+#include <cstddef>
 #include <functional>
-#include <iostream>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <new>
 #include <thread>
+#include <type_traits>
+#include <vector>
 
 namespace Learn
 {
 
+    // type erased task, callables up to InlineSize bytes are stored in place instead of on the heap
+    class ThreadTask
+    {
+    public:
+        static constexpr size_t InlineSize = 48;
+
+        ThreadTask() = default;
+
+        template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, ThreadTask>>>
+        explicit ThreadTask(F &&func)
+        {
+            using T = std::decay_t<F>;
+            if constexpr (sizeof(T) <= InlineSize && alignof(T) <= alignof(std::max_align_t) &&
+                          std::is_nothrow_move_constructible_v<T>)
+            {
+                new (storage_) T(std::forward<F>(func));
+                ops_ = &inlineOps<T>;
+            }
+            else
+            {
+                *reinterpret_cast<T **>(storage_) = new T(std::forward<F>(func));
+                ops_ = &heapOps<T>;
+            }
+        }
+
+        ThreadTask(ThreadTask &&other) noexcept
+        {
+            moveFrom(other);
+        }
+
+        ThreadTask &operator=(ThreadTask &&other) noexcept
+        {
+            if (this != &other)
+            {
+                reset();
+                moveFrom(other);
+            }
+            return *this;
+        }
+
+        ThreadTask(const ThreadTask &) = delete;
+        ThreadTask &operator=(const ThreadTask &) = delete;
+
+        ~ThreadTask()
+        {
+            reset();
+        }
+
+        inline explicit operator bool() const
+        {
+            return ops_ != nullptr;
+        }
+
+        inline void operator()(size_t threadId)
+        {
+            ops_->invoke(storage_, threadId);
+        }
+
+        inline void reset()
+        {
+            if (ops_)
+            {
+                ops_->destroy(storage_);
+                ops_ = nullptr;
+            }
+        }
+
+    private:
+        struct Ops
+        {
+            void (*invoke)(void *storage, size_t threadId);
+            void (*move)(void *dst, void *src);
+            void (*destroy)(void *storage);
+        };
+
+        template <typename T>
+        static constexpr Ops inlineOps = {
+            [](void *storage, size_t threadId)
+            { (*static_cast<T *>(storage))(threadId); },
+            [](void *dst, void *src)
+            {
+                new (dst) T(std::move(*static_cast<T *>(src)));
+                static_cast<T *>(src)->~T();
+            },
+            [](void *storage)
+            { static_cast<T *>(storage)->~T(); }};
+
+        template <typename T>
+        static constexpr Ops heapOps = {
+            [](void *storage, size_t threadId)
+            { (**static_cast<T **>(storage))(threadId); },
+            [](void *dst, void *src)
+            { *static_cast<T **>(dst) = *static_cast<T **>(src); },
+            [](void *storage)
+            { delete *static_cast<T **>(storage); }};
+
+        inline void moveFrom(ThreadTask &other)
+        {
+            if (other.ops_)
+            {
+                other.ops_->move(storage_, other.storage_);
+                ops_ = other.ops_;
+                other.ops_ = nullptr;
+            }
+        }
+
+    private:
+        alignas(std::max_align_t) unsigned char storage_[InlineSize];
+        const Ops *ops_ = nullptr;
+    };
+
+    // bounded Chase-Lev deque: the owner pushes and pops at the bottom, other workers steal from the top.
+    // a slot is only reused after the task moved out of it, so a slow thief never sees it overwritten
+    class WorkStealingDeque
+    {
+    public:
+        static constexpr int64_t Capacity = 1024;
+
+        bool push(ThreadTask &task)
+        {
+            int64_t b = bottom_.load(std::memory_order_relaxed);
+            int64_t t = top_.load(std::memory_order_acquire);
+            size_t idx = (size_t)b & (Capacity - 1);
+            if (b - t >= Capacity || full_[idx].load(std::memory_order_acquire))
+            {
+                return false;
+            }
+            slots_[idx] = std::move(task);
+            full_[idx].store(1, std::memory_order_relaxed);
+            bottom_.store(b + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool pop(ThreadTask &task)
+        {
+            int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+            bottom_.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t = top_.load(std::memory_order_relaxed);
+            if (t > b)
+            {
+                bottom_.store(b + 1, std::memory_order_relaxed);
+                return false;
+            }
+            if (t == b)
+            {
+                // last task, race the thieves for it
+                bool won = top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+                bottom_.store(b + 1, std::memory_order_relaxed);
+                if (!won)
+                {
+                    return false;
+                }
+            }
+            take(b, task);
+            return true;
+        }
+
+        bool steal(ThreadTask &task)
+        {
+            int64_t t = top_.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t b = bottom_.load(std::memory_order_acquire);
+            if (t >= b)
+            {
+                return false;
+            }
+            if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                return false;
+            }
+            take(t, task);
+            return true;
+        }
+
+    private:
+        inline void take(int64_t pos, ThreadTask &task)
+        {
+            size_t idx = (size_t)pos & (Capacity - 1);
+            task = std::move(slots_[idx]);
+            full_[idx].store(0, std::memory_order_release);
+        }
+
+    private:
+        alignas(64) std::atomic<int64_t> top_{0};
+        alignas(64) std::atomic<int64_t> bottom_{0};
+        ThreadTask slots_[Capacity];
+        std::atomic<uint8_t> full_[Capacity] = {};
+    };
+
+    // priority lanes of the scheduler, lower values are picked first
+    enum TaskLane
+    {
+        TaskLane_Frame,   // work the current frame is waiting on
+        TaskLane_Loading, // model and texture loading
+        TaskLane_IBL,     // environment map precompute
+        TaskLane_Count,
+    };
+
+    // external threads submit through shared FIFO queues, tasks pushed by a worker go to its own deques
+    // and are stolen by idle workers. idle workers spin briefly, then park on a futex until work arrives.
+    // every task runs in a lane inherited from the pushing thread, workers take frame tasks first and
+    // background lanes never occupy more than threadCnt - 1 workers, so frame work always finds one free
     class ThreadPool
     {
     public:
+        // tags the tasks pushed by the current thread for its lifetime, tasks inherit the lane they were pushed in
+        class LaneScope
+        {
+        public:
+            explicit LaneScope(TaskLane lane) : prevLane_(currentLane_)
+            {
+                currentLane_ = lane;
+            }
+
+            ~LaneScope()
+            {
+                currentLane_ = prevLane_;
+            }
+
+            LaneScope(const LaneScope &) = delete;
+            LaneScope &operator=(const LaneScope &) = delete;
+
+        private:
+            TaskLane prevLane_;
+        };
+
         explicit ThreadPool(const size_t threadCnt = std::thread::hardware_concurrency())
-            : threadCnt_(threadCnt),
-              threads_(new std::thread[threadCnt])
+            : threadCnt_(std::max((size_t)1, threadCnt)), // hardware_concurrency() is 0 when unknown
+              backgroundLimit_(std::max((size_t)1, threadCnt_ - 1)),
+              threads_(new std::thread[threadCnt_]),
+              queues_(new WorkStealingDeque[threadCnt_ * TaskLane_Count])
         {
             createThreads();
         }
@@ -25,52 +254,301 @@ namespace Learn
         {
             waitTasksFinish();
             running_ = false;
+            wakeWorkers(true);
             joinThreads();
         }
 
+        // the process wide scheduler, the renderer and asset loading share its workers
+        static ThreadPool &shared()
+        {
+            static ThreadPool pool;
+            return pool;
+        }
+
+        static inline TaskLane currentLane()
+        {
+            return currentLane_;
+        }
+
         inline size_t getThreadCnt() const
         {
             return threadCnt_;
         }
 
+        inline size_t getParkedCnt() const
+        {
+            return sleepers_;
+        }
+
         template <typename F>
         void pushTask(const F &task)
         {
+            ThreadTask wrapped(task);
+            TaskLane lane = currentLane_;
             tasksCnt_++;
+            tasksQueued_++;
+            laneQueued_[lane]++;
+            if (!(currentPool_ == this && localQueue(currentWorker_, lane).push(wrapped)))
             {
                 const std::lock_guard<std::mutex> lock(mutex_);
-                tasks_.push(std::function<void(size_t)>(task));
+                auto &injector = injectors_[lane];
+                if (injector.cnt == injector.tasks.size())
+                {
+                    growTasks(injector);
+                }
+                injector.tasks[(injector.head + injector.cnt) % injector.tasks.size()] = std::move(wrapped);
+                injector.cnt++;
             }
+            wakeWorkers(false);
         }
 
         template <typename F, typename... A>
         void pushTask(const F &task, const A &...args)
         {
-            pushTask([task, args...]
+            pushTask([task, args...](size_t)
                      { task(args...); });
         }
 
-        void waitTasksFinish() const
+        // blocks until every task of the pool finished, on the shared pool that is every client's work.
+        // for the owner of a private pool waiting from outside, tasks join what they pushed with a TaskGroup.
+        // a worker returns at once, its own task stays counted until it returns
+        void waitTasksFinish()
         {
+            if (currentPool_ == this)
+            {
+                return;
+            }
+
             while (true)
             {
-                if (!paused)
+                size_t cnt = tasksCnt_;
+                if (!paused ? cnt == 0 : tasksRunningCnt() == 0)
                 {
-                    if (tasksCnt_ == 0)
-                        break;
+                    break;
                 }
-                else
+                // finishing tasks notify every change while paused, so the running ones are waited for
+                wakeWorkers(false);
+                tasksCnt_.wait(cnt);
+            }
+        }
+
+        // runs func(begin, end, threadId) over [begin, end) and returns once every chunk finished.
+        // ranges are split in halves down to grain elements (0 picks a grain from the thread count),
+        // idle workers steal the larger halves. safe to call from inside a task of this pool
+        template <typename F>
+        void parallelFor(size_t begin, size_t end, size_t grain, const F &func)
+        {
+            if (begin >= end)
+            {
+                return;
+            }
+            if (grain == 0)
+            {
+                grain = std::max((size_t)1, (end - begin + threadCnt_ * 4 - 1) / (threadCnt_ * 4));
+            }
+            if (currentPool_ == this && end - begin <= grain)
+            {
+                func(begin, end, currentWorker_);
+                return;
+            }
+
+            ForGroup group;
+            group.grain = grain;
+            group.lane = currentLane_;
+            group.func = &func;
+            group.invoke = [](const void *f, size_t b, size_t e, size_t threadId)
+            { (*static_cast<const F *>(f))(b, e, threadId); };
+            pushRange(&group, begin, end);
+            joinGroup(group);
+        }
+
+        // 2D variant, func(x0, y0, x1, y1, threadId) is called once per tileWidth x tileHeight tile
+        template <typename F>
+        void parallelFor2D(size_t width, size_t height, size_t tileWidth, size_t tileHeight, const F &func)
+        {
+            size_t tileCntX = (width + tileWidth - 1) / tileWidth;
+            size_t tileCntY = (height + tileHeight - 1) / tileHeight;
+            parallelFor(0, tileCntX * tileCntY, 1, [&](size_t begin, size_t end, size_t threadId)
+                        {
+                            for (size_t idx = begin; idx < end; idx++)
+                            {
+                                size_t x0 = (idx % tileCntX) * tileWidth;
+                                size_t y0 = (idx / tileCntX) * tileHeight;
+                                func(x0, y0, std::min(x0 + tileWidth, width), std::min(y0 + tileHeight, height), threadId);
+                            } });
+        }
+
+        // workers stop taking tasks while set and park, clearing it wakes them and the joins waiting on them
+        class PauseFlag
+        {
+        public:
+            explicit PauseFlag(ThreadPool &pool) : pool_(pool) {}
+
+            PauseFlag &operator=(bool value)
+            {
+                value_ = value;
+                if (!value)
                 {
-                    if (tasksRunningCnt() == 0)
-                        break;
+                    pool_.resumeWorkers();
                 }
-                std::this_thread::yield();
+                return *this;
             }
-        }
 
-        std::atomic<bool> paused{false};
+            inline operator bool() const
+            {
+                return value_;
+            }
+
+        private:
+            ThreadPool &pool_;
+            std::atomic<bool> value_{false};
+        };
+
+        PauseFlag paused{*this};
 
     private:
+        // idle loops yield this many times before they block
+        static constexpr int IdleSpinCnt = 64;
+
+        // state of one parallelFor call, lives on the caller's stack until the join returns
+        struct ForGroup
+        {
+            std::atomic<size_t> pending{0};
+            size_t grain = 1;
+            TaskLane lane = TaskLane_Frame;
+            const void *func = nullptr;
+            void (*invoke)(const void *func, size_t begin, size_t end, size_t threadId) = nullptr;
+        };
+
+        // externally pushed tasks of one lane, keeps its capacity so pushing does not allocate in steady state
+        struct Injector
+        {
+            std::vector<ThreadTask> tasks;
+            size_t head = 0;
+            size_t cnt = 0;
+        };
+
+    public:
+        // joins only the tasks pushed through it, the way parallelFor joins its chunks,
+        // so a client of the shared pool never waits on other clients' frame, loading or IBL work
+        class TaskGroup
+        {
+        public:
+            explicit TaskGroup(ThreadPool &pool) : pool_(pool)
+            {
+                group_.lane = currentLane_;
+            }
+
+            ~TaskGroup()
+            {
+                wait();
+            }
+
+            TaskGroup(const TaskGroup &) = delete;
+            TaskGroup &operator=(const TaskGroup &) = delete;
+
+            template <typename F>
+            void pushTask(const F &task)
+            {
+                ThreadPool *pool = &pool_;
+                ForGroup *group = &group_;
+                group->lane = std::max(group->lane, currentLane_);
+                group->pending++;
+                pool_.pushTask([pool, group, task](size_t threadId)
+                               {
+                                   task(threadId);
+                                   pool->finishGroupTask(group); });
+            }
+
+            // blocks until every task pushed through the group finished, a worker runs queued tasks meanwhile
+            void wait()
+            {
+                pool_.joinGroup(group_);
+            }
+
+        private:
+            ThreadPool &pool_;
+            ForGroup group_;
+        };
+
+    private:
+        inline void pushRange(ForGroup *group, size_t begin, size_t end)
+        {
+            group->pending++;
+            pushTask([this, group, begin, end](size_t threadId)
+                     { runRange(group, begin, end, threadId); });
+        }
+
+        void runRange(ForGroup *group, size_t begin, size_t end, size_t threadId)
+        {
+            // the upper halves go to this worker's deque, thieves take the oldest and largest first
+            while (end - begin > group->grain)
+            {
+                size_t mid = begin + (end - begin) / 2;
+                pushRange(group, mid, end);
+                end = mid;
+            }
+            group->invoke(group->func, begin, end, threadId);
+
+            finishGroupTask(group);
+        }
+
+        // the group is gone as soon as pending hits 0, only pool members are touched after that
+        void finishGroupTask(ForGroup *group)
+        {
+            if (--group->pending == 0)
+            {
+                joinEpoch_++;
+                joinEpoch_.notify_all();
+            }
+        }
+
+        void joinGroup(ForGroup &group)
+        {
+            if (currentPool_ == this)
+            {
+                // a worker keeps running tasks instead of blocking, nested loops cannot starve the pool.
+                // only lanes at least as urgent as the group are picked, a frame join never waits on a file load
+                // with nothing to pick it blocks until some group finishes, the remaining chunks are running elsewhere
+                ThreadTask task;
+                TaskLane lane;
+                int idleCnt = 0;
+                while (true)
+                {
+                    uint32_t epoch = joinEpoch_;
+                    if (group.pending == 0)
+                    {
+                        break;
+                    }
+                    if (!paused && popTask(currentWorker_, task, lane, TaskLane_Frame, group.lane))
+                    {
+                        runTask(task, currentWorker_, lane);
+                        idleCnt = 0;
+                    }
+                    else if (++idleCnt < IdleSpinCnt)
+                    {
+                        std::this_thread::yield();
+                    }
+                    else
+                    {
+                        joinEpoch_.wait(epoch);
+                        idleCnt = 0;
+                    }
+                }
+                return;
+            }
+
+            while (true)
+            {
+                uint32_t epoch = joinEpoch_;
+                if (group.pending == 0)
+                {
+                    break;
+                }
+                joinEpoch_.wait(epoch);
+            }
+        }
+
         void createThreads()
         {
             for (size_t i = 0; i < threadCnt_; i++)
@@ -87,56 +565,216 @@ namespace Learn
             }
         }
 
-        size_t tasksQueuedCnt() const
+        size_t tasksRunningCnt() const
         {
-            const std::lock_guard<std::mutex> lock(mutex_);
-            return tasks_.size();
+            return tasksCnt_ - tasksQueued_;
         }
 
-        size_t tasksRunningCnt() const
+        inline WorkStealingDeque &localQueue(size_t threadId, int lane)
         {
-            return tasksCnt_ - tasksQueuedCnt();
+            return queues_[threadId * TaskLane_Count + lane];
         }
 
-        bool popTask(std::function<void(size_t)> &task)
+        bool popInjected(int lane, ThreadTask &task)
         {
             const std::lock_guard<std::mutex> lock(mutex_);
-            if (tasks_.empty())
+            auto &injector = injectors_[lane];
+            if (injector.cnt == 0)
+            {
+                return false;
+            }
+            task = std::move(injector.tasks[injector.head]);
+            injector.head = (injector.head + 1) % injector.tasks.size();
+            injector.cnt--;
+            return true;
+        }
+
+        // takes the most urgent task of the lanes [firstLane, lastLane]
+        bool popTask(size_t threadId, ThreadTask &task, TaskLane &lane, int firstLane, int lastLane)
+        {
+            if (tasksQueued_ == 0)
+            {
                 return false;
+            }
+            for (int l = firstLane; l <= lastLane; l++)
+            {
+                if (laneQueued_[l] == 0)
+                {
+                    continue;
+                }
+                bool found = (threadId < threadCnt_ && localQueue(threadId, l).pop(task)) || popInjected(l, task);
+                for (size_t i = 1; !found && i <= threadCnt_; i++)
+                {
+                    found = localQueue((threadId + i) % threadCnt_, l).steal(task);
+                }
+                if (found)
+                {
+                    laneQueued_[l]--;
+                    tasksQueued_--;
+                    lane = (TaskLane)l;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        inline void runTask(ThreadTask &task, size_t threadId, TaskLane lane)
+        {
+            // tasks pushed from inside inherit the lane, restored for the task this worker is nested in
+            TaskLane prevLane = currentLane_;
+            currentLane_ = lane;
+            task(threadId);
+            task.reset();
+            currentLane_ = prevLane;
+            size_t left = --tasksCnt_;
+            if (left == 0 || paused)
+            {
+                tasksCnt_.notify_all();
+            }
+        }
+
+        // called with mutex_ held, keeps the queued tasks in order
+        void growTasks(Injector &injector)
+        {
+            std::vector<ThreadTask> tasks(std::max(injector.tasks.size() * 2, (size_t)64));
+            for (size_t i = 0; i < injector.cnt; i++)
+            {
+                tasks[i] = std::move(injector.tasks[(injector.head + i) % injector.tasks.size()]);
+            }
+            injector.tasks = std::move(tasks);
+            injector.head = 0;
+        }
+
+        void wakeWorkers(bool all)
+        {
+            if (sleepers_ == 0)
+            {
+                return;
+            }
+            parkEpoch_++;
+            if (all)
+            {
+                parkEpoch_.notify_all();
+            }
             else
             {
-                task = std::move(tasks_.front());
-                tasks_.pop();
-                return true;
+                parkEpoch_.notify_one();
             }
         }
 
+        // frame tasks are always runnable, background ones only while a background slot is free
+        inline bool hasRunnableTasks() const
+        {
+            return laneQueued_[TaskLane_Frame] != 0 ||
+                   (tasksQueued_ != laneQueued_[TaskLane_Frame] && backgroundRunning_ < backgroundLimit_);
+        }
+
+        void park()
+        {
+            uint32_t epoch = parkEpoch_;
+            sleepers_++;
+            // rechecked after announcing, a task pushed or a resume before this point is seen here, later ones wake us
+            if ((paused || !hasRunnableTasks()) && running_)
+            {
+                parkEpoch_.wait(epoch);
+            }
+            sleepers_--;
+        }
+
+        void resumeWorkers()
+        {
+            wakeWorkers(true);
+            joinEpoch_++;
+            joinEpoch_.notify_all();
+        }
+
+        // a top level background task holds a slot while it runs, tasks it helps with while joining do not
+        bool popBackgroundTask(size_t threadId, ThreadTask &task, TaskLane &lane)
+        {
+            if (tasksQueued_ == laneQueued_[TaskLane_Frame])
+            {
+                return false;
+            }
+            if (backgroundRunning_++ >= backgroundLimit_)
+            {
+                backgroundRunning_--;
+                return false;
+            }
+            if (!popTask(threadId, task, lane, TaskLane_Frame + 1, TaskLane_Count - 1))
+            {
+                backgroundRunning_--;
+                return false;
+            }
+            return true;
+        }
+
         void taskWorker(size_t threadId)
         {
+            currentPool_ = this;
+            currentWorker_ = threadId;
+
+            int idleCnt = 0;
+            ThreadTask task;
+            TaskLane lane;
             while (running_)
             {
-                std::function<void(size_t)> task;
-                if (!paused && popTask(task))
+                if (paused)
                 {
-                    task(threadId);
-                    tasksCnt_--;
+                    park();
+                    idleCnt = 0;
+                    continue;
                 }
-                else
+                if (popTask(threadId, task, lane, TaskLane_Frame, TaskLane_Frame))
+                {
+                    runTask(task, threadId, lane);
+                    idleCnt = 0;
+                }
+                else if (popBackgroundTask(threadId, task, lane))
+                {
+                    runTask(task, threadId, lane);
+                    backgroundRunning_--;
+                    // a worker parked on the full background slots can take the next one
+                    if (tasksQueued_ != laneQueued_[TaskLane_Frame])
+                    {
+                        wakeWorkers(false);
+                    }
+                    idleCnt = 0;
+                }
+                else if (++idleCnt < IdleSpinCnt)
                 {
                     std::this_thread::yield();
                 }
+                else
+                {
+                    park();
+                    idleCnt = 0;
+                }
             }
         }
 
     private:
+        static inline thread_local ThreadPool *currentPool_ = nullptr;
+        static inline thread_local size_t currentWorker_ = 0;
+        static inline thread_local TaskLane currentLane_ = TaskLane_Frame;
+
         mutable std::mutex mutex_ = {};
         std::atomic<bool> running_{true};
 
+        size_t threadCnt_ = 0;
+        size_t backgroundLimit_ = 1;
         std::unique_ptr<std::thread[]> threads_;
-        std::atomic<size_t> threadCnt_{0};
+        std::unique_ptr<WorkStealingDeque[]> queues_; // TaskLane_Count deques per worker
+
+        Injector injectors_[TaskLane_Count];
+
+        std::atomic<size_t> tasksCnt_{0};    // pushed and not finished
+        std::atomic<size_t> tasksQueued_{0}; // pushed and not started
+        std::atomic<size_t> laneQueued_[TaskLane_Count] = {};
+        std::atomic<size_t> backgroundRunning_{0};
 
-        std::queue<std::function<void(size_t)>> tasks_ = {};
-        std::atomic<size_t> tasksCnt_{0};
+        std::atomic<uint32_t> parkEpoch_{0};
+        std::atomic<uint32_t> joinEpoch_{0};
+        std::atomic<size_t> sleepers_{0};
     };
 
 }
@@ -42,6 +42,10 @@ namespace Learn
             bool depthTest = true;
             bool reverseZ = false;
 
+            // software renderer only
+            bool visibilityBuffer = false;
+            bool commandList = true;
+
             glm::vec4 clearColor = {0.f, 0.f, 0.f, 0.f};
             glm::vec3 ambientColor = {0.5f, 0.5f, 0.5f};
 
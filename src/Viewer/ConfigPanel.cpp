@@ -206,6 +206,14 @@ namespace Learn
                 }
             }
 
+            // visibility buffer
+            if (config_.rendererType == Renderer_Soft)
+            {
+                ImGui::Separator();
+                ImGui::Checkbox("visibility buffer", &config_.visibilityBuffer);
+                ImGui::Checkbox("command list", &config_.commandList);
+            }
+
             // Anti aliasing
             const char *aaItems[] = {
                 "NONE",
@@ -250,6 +250,9 @@ namespace Learn
                 return;
             }
 
+            // the cube faces may still be rendering
+            renderer_->waitIdle();
+
             // TODO check md5
             auto cacheFilePath = getCacheFilePath(getTextureHashKey(tex));
             if (tex->format == TextureFormat_RGBA8)
@@ -145,20 +145,14 @@ namespace Learn
             {
                 skyboxTex.resize(6);
 
-                ThreadPool pool(6);
-                pool.pushTask([&](int thread_id)
-                              { skyboxTex[0] = loadTextureFile(filepath + "right.jpg"); });
-                pool.pushTask([&](int thread_id)
-                              { skyboxTex[1] = loadTextureFile(filepath + "left.jpg"); });
-                pool.pushTask([&](int thread_id)
-                              { skyboxTex[2] = loadTextureFile(filepath + "top.jpg"); });
-                pool.pushTask([&](int thread_id)
-                              { skyboxTex[3] = loadTextureFile(filepath + "bottom.jpg"); });
-                pool.pushTask([&](int thread_id)
-                              { skyboxTex[4] = loadTextureFile(filepath + "front.jpg"); });
-                pool.pushTask([&](int thread_id)
-                              { skyboxTex[5] = loadTextureFile(filepath + "back.jpg"); });
-                pool.waitTasksFinish();
+                const char *faceNames[6] = {"right.jpg", "left.jpg", "top.jpg", "bottom.jpg", "front.jpg", "back.jpg"};
+                ThreadPool::LaneScope lane(TaskLane_Loading);
+                ThreadPool::shared().parallelFor(0, 6, 1, [&](size_t begin, size_t end, size_t thread_id)
+                                                 {
+                                                     for (size_t i = begin; i < end; i++)
+                                                     {
+                                                         skyboxTex[i] = loadTextureFile(filepath + faceNames[i]);
+                                                     } });
 
                 auto &texData = material->textureData[MaterialTexType_CUBE];
                 texData.tag = filepath;
@@ -536,12 +530,15 @@ namespace Learn
                 return;
             }
 
-            ThreadPool pool(std::min(texPaths.size(), (size_t)std::thread::hardware_concurrency()));
-            for (auto &path : texPaths)
-            {
-                pool.pushTask([&](int thread_id)
-                              { loadTextureFile(path); });
-            }
+            // one file per leaf, decoding sizes differ too much for coarser chunks
+            std::vector<std::string> paths(texPaths.begin(), texPaths.end());
+            ThreadPool::LaneScope lane(TaskLane_Loading);
+            ThreadPool::shared().parallelFor(0, paths.size(), 1, [&](size_t begin, size_t end, size_t thread_id)
+                                             {
+                                                 for (size_t i = begin; i < end; i++)
+                                                 {
+                                                     loadTextureFile(paths[i]);
+                                                 } });
         }
 
         std::shared_ptr<Buffer<RGBA>> ModelLoader::loadTextureFile(const std::string &path)
@@ -119,6 +119,15 @@ class VS : public ShaderBlinnPhong {
       v->v_tangent = glm::normalize(T - glm::dot(T, N) * N);
     }
   }
+
+  // shadow map and depth prepass only need the position
+  bool hasPositionMain() const override {
+    return true;
+  }
+
+  void shaderMainPosition() override {
+    gl->Position = u->u_modelViewProjectionMatrix * glm::vec4(a->a_position, 1.0);
+  }
 };
 
 class FS : public ShaderBlinnPhong {
@@ -162,14 +171,28 @@ class FS : public ShaderBlinnPhong {
     }
   }
 
-  float ShadowCalculation(glm::vec4 fragPos, glm::vec3 normal) {
+  BatchVec3 GetNormalFromMap(FragmentBatch &batch, const BatchVec2 &texCoord) {
+    if (def->NORMAL_MAP) {
+      BatchVec3 N = normalize(batch.varyingVec3(offsetof(ShaderVaryings, v_normal)));
+      BatchVec3 T = normalize(batch.varyingVec3(offsetof(ShaderVaryings, v_tangent)));
+      T = normalize(T - dot(T, N) * N);
+      BatchVec3 B = cross(T, N);
+
+      BatchVec3 tangentNormal = texture(u->u_normalMap, texCoord, batch.mask).xyz() * 2.0f - 1.0f;
+      return normalize(T * tangentNormal.x + B * tangentNormal.y + N * tangentNormal.z);
+    } else {
+      return normalize(batch.varyingVec3(offsetof(ShaderVaryings, v_normalVector)));
+    }
+  }
+
+  float ShadowCalculation(glm::vec4 fragPos, glm::vec3 normal, glm::vec3 lightDirection) {
     glm::vec3 projCoords = glm::vec3(fragPos) / fragPos.w;
     float currentDepth = projCoords.z;
     if (currentDepth < 0.f || currentDepth > 1.f) {
       return 0.0f;
     }
 
-    float bias = glm::max(depthBiasCoeff * (1.0f - glm::dot(normal, glm::normalize(v->v_lightDirection))), depthBiasMin);
+    float bias = glm::max(depthBiasCoeff * (1.0f - glm::dot(normal, glm::normalize(lightDirection))), depthBiasMin);
     float shadow = 0.0f;
 
     // PCF
@@ -228,7 +251,7 @@ class FS : public ShaderBlinnPhong {
 
       if (u->u_enableShadow) {
         // calculate shadow
-        float shadow = 1.0f - ShadowCalculation(v->v_shadowFragPos, N);
+        float shadow = 1.0f - ShadowCalculation(v->v_shadowFragPos, N, v->v_lightDirection);
         diffuseColor *= shadow;
         specularColor *= shadow;
       }
@@ -240,6 +263,72 @@ class FS : public ShaderBlinnPhong {
 
     gl->FragColor = glm::vec4(ambientColor + diffuseColor + specularColor + emissiveColor, baseColor.a);
   }
+
+  bool hasBatchMain() const override {
+    return true;
+  }
+
+  void shaderMainBatch(FragmentBatch &batch) override {
+    const static float pointLightRangeInverse = 1.0f / 5.f;
+    const static float specularExponent = 128.f;
+
+    BatchVec2 texCoord = batch.varyingVec2(offsetof(ShaderVaryings, v_texCoord));
+
+    BatchVec4 baseColor;
+    if (def->ALBEDO_MAP) {
+      baseColor = texture(u->u_albedoMap, texCoord, batch.mask);
+    } else {
+      baseColor = u->u_baseColor;
+    }
+
+    BatchVec3 N = GetNormalFromMap(batch, texCoord);
+
+    // ambient
+    BatchFloat ao = 1.f;
+    if (def->AO_MAP) {
+      ao = texture(u->u_aoMap, texCoord, batch.mask).x;
+    }
+    BatchVec3 ambientColor = baseColor.xyz() * BatchVec3(u->u_ambientColor) * ao;
+    BatchVec3 diffuseColor(0.f);
+    BatchVec3 specularColor(0.f);
+    BatchVec3 emissiveColor(0.f);
+
+    if (u->u_enableLight) {
+      // diffuse
+      BatchVec3 lightDir = batch.varyingVec3(offsetof(ShaderVaryings, v_lightDirection));
+      BatchVec3 lDir = lightDir * pointLightRangeInverse;
+      BatchFloat attenuation = clamp(1.0f - dot(lDir, lDir), 0.0f, 1.0f);
+
+      BatchVec3 lightDirection = normalize(lightDir);
+      BatchFloat diffuse = max(dot(N, lightDirection), 0.0f);
+      diffuseColor = BatchVec3(u->u_pointLightColor) * baseColor.xyz() * diffuse * attenuation;
+
+      // specular
+      BatchVec3 cameraDirection = normalize(batch.varyingVec3(offsetof(ShaderVaryings, v_cameraDirection)));
+      BatchVec3 halfVector = normalize(lightDirection + cameraDirection);
+      BatchFloat specularAngle = max(dot(N, halfVector), 0.0f);
+      specularColor = BatchVec3(pow(specularAngle, specularExponent) * u->u_kSpecular);
+
+      if (u->u_enableShadow) {
+        // PCF lookups are data dependent, evaluated per lane
+        BatchVec4 shadowFragPos = batch.varyingVec4(offsetof(ShaderVaryings, v_shadowFragPos));
+        BatchFloat shadow = 1.0f;
+        for (int i = 0; i < BatchLanes; i++) {
+          if ((batch.mask >> i) & 1) {
+            shadow.set(i, 1.0f - ShadowCalculation(shadowFragPos.get(i), N.get(i), lightDir.get(i)));
+          }
+        }
+        diffuseColor *= shadow;
+        specularColor *= shadow;
+      }
+    }
+
+    if (def->EMISSIVE_MAP) {
+      emissiveColor = texture(u->u_emissiveMap, texCoord, batch.mask).xyz();
+    }
+
+    batch.fragColor = BatchVec4(ambientColor + diffuseColor + specularColor + emissiveColor, baseColor.w);
+  }
 };
 
 }
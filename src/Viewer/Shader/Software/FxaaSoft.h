@@ -78,6 +78,10 @@ class FS : public ShaderFXAA {
     return glm::dot(rgb, glm::vec3(0.299, 0.587, 0.114));
   }
 
+  static BatchFloat rgb2luma(const BatchVec3 &rgb) {
+    return dot(rgb, BatchVec3(0.299f, 0.587f, 0.114f));
+  }
+
   glm::vec3 fxaa() {
     glm::vec2 inverseScreenSize = glm::vec2(1.0) / u->u_screenSize;
     glm::vec3 colorCenter = texture(u->u_screenTexture, v->v_texCoord);
@@ -264,6 +268,35 @@ class FS : public ShaderFXAA {
   void shaderMain() override {
     gl->FragColor = glm::vec4(fxaa(), 1.f);
   }
+
+  bool hasBatchMain() const override {
+    return true;
+  }
+
+  // local contrast test for the whole quad, only edge lanes run the (branchy) edge search
+  void shaderMainBatch(FragmentBatch &batch) override {
+    BatchVec2 texCoord = batch.varyingVec2(offsetof(ShaderVaryings, v_texCoord));
+    BatchVec3 colorCenter = texture(u->u_screenTexture, texCoord, batch.mask).xyz();
+
+    BatchFloat lumaCenter = rgb2luma(colorCenter);
+    BatchFloat lumaDown = rgb2luma(textureLodOffset(u->u_screenTexture, texCoord, 0.f, glm::ivec2(0, -1), batch.mask).xyz());
+    BatchFloat lumaUp = rgb2luma(textureLodOffset(u->u_screenTexture, texCoord, 0.f, glm::ivec2(0, 1), batch.mask).xyz());
+    BatchFloat lumaLeft = rgb2luma(textureLodOffset(u->u_screenTexture, texCoord, 0.f, glm::ivec2(-1, 0), batch.mask).xyz());
+    BatchFloat lumaRight = rgb2luma(textureLodOffset(u->u_screenTexture, texCoord, 0.f, glm::ivec2(1, 0), batch.mask).xyz());
+
+    BatchFloat lumaMin = min(lumaCenter, min(min(lumaDown, lumaUp), min(lumaLeft, lumaRight)));
+    BatchFloat lumaMax = max(lumaCenter, max(max(lumaDown, lumaUp), max(lumaLeft, lumaRight)));
+    BatchFloat lumaRange = lumaMax - lumaMin;
+
+    batch.fragColor = BatchVec4(colorCenter, 1.f);
+
+    int edgeMask = (lumaRange >= max(EDGE_THRESHOLD_MIN, lumaMax * EDGE_THRESHOLD_MAX)).bits() & batch.mask;
+    for (int i = 0; i < BatchLanes; i++) {
+      if ((edgeMask >> i) & 1) {
+        shaderMainLane(batch, i);
+      }
+    }
+  }
 };
 
 }
@@ -125,6 +125,15 @@ class VS : public ShaderPbrIBL {
       v->v_tangent = glm::normalize(T - glm::dot(T, N) * N);
     }
   }
+
+  // shadow map and depth prepass only need the position
+  bool hasPositionMain() const override {
+    return true;
+  }
+
+  void shaderMainPosition() override {
+    gl->Position = u->u_modelViewProjectionMatrix * glm::vec4(a->a_position, 1.0);
+  }
 };
 
 class FS : public ShaderPbrIBL {
@@ -165,6 +174,20 @@ class FS : public ShaderPbrIBL {
     }
   }
 
+  BatchVec3 GetNormalFromMap(FragmentBatch &batch, const BatchVec2 &texCoord) {
+    if (def->NORMAL_MAP) {
+      BatchVec3 N = normalize(batch.varyingVec3(offsetof(ShaderVaryings, v_normal)));
+      BatchVec3 T = normalize(batch.varyingVec3(offsetof(ShaderVaryings, v_tangent)));
+      T = normalize(T - dot(T, N) * N);
+      BatchVec3 B = cross(T, N);
+
+      BatchVec3 tangentNormal = texture(u->u_normalMap, texCoord, batch.mask).xyz() * 2.0f - 1.0f;
+      return normalize(T * tangentNormal.x + B * tangentNormal.y + N * tangentNormal.z);
+    } else {
+      return normalize(batch.varyingVec3(offsetof(ShaderVaryings, v_normalVector)));
+    }
+  }
+
   static float DistributionGGX(glm::vec3 N, glm::vec3 H, float roughness) {
     float a = roughness * roughness;
     float a2 = a * a;
@@ -222,6 +245,62 @@ class FS : public ShaderPbrIBL {
     return SpecularColor * AB.x + AB.y;
   }
 
+  // batch versions of the BRDF helpers above
+  static BatchFloat DistributionGGX(const BatchVec3 &N, const BatchVec3 &H, const BatchFloat &roughness) {
+    BatchFloat a = roughness * roughness;
+    BatchFloat a2 = a * a;
+    BatchFloat NdotH = max(dot(N, H), 0.0f);
+    BatchFloat NdotH2 = NdotH * NdotH;
+
+    BatchFloat nom = a2;
+    BatchFloat denom = (NdotH2 * (a2 - 1.0f) + 1.0f);
+    denom = PI * denom * denom;
+
+    return nom / denom;
+  }
+
+  static BatchFloat GeometrySchlickGGX(const BatchFloat &NdotV, const BatchFloat &roughness) {
+    BatchFloat r = (roughness + 1.0f);
+    BatchFloat k = (r * r) / 8.0f;
+
+    BatchFloat nom = NdotV;
+    BatchFloat denom = NdotV * (1.0f - k) + k;
+
+    return nom / denom;
+  }
+
+  static BatchFloat GeometrySmith(const BatchVec3 &N, const BatchVec3 &V, const BatchVec3 &L, const BatchFloat &roughness) {
+    BatchFloat NdotV = max(dot(N, V), 0.0f);
+    BatchFloat NdotL = max(dot(N, L), 0.0f);
+    BatchFloat ggx2 = GeometrySchlickGGX(NdotV, roughness);
+    BatchFloat ggx1 = GeometrySchlickGGX(NdotL, roughness);
+
+    return ggx1 * ggx2;
+  }
+
+  static BatchVec3 FresnelSchlick(const BatchFloat &cosTheta, const BatchVec3 &F0) {
+    return F0 + (1.0f - F0) * pow(clamp(1.0f - cosTheta, 0.0f, 1.0f), 5.0f);
+  }
+
+  static BatchVec3 FresnelSchlickRoughness(const BatchFloat &cosTheta, const BatchVec3 &F0, const BatchFloat &roughness) {
+    return F0 + (max(BatchVec3(1.0f - roughness), F0) - F0) * pow(clamp(1.0f - cosTheta, 0.0f, 1.0f), 5.0f);
+  }
+
+  static BatchVec3 EnvBRDFApprox(const BatchVec3 &SpecularColor, const BatchFloat &Roughness, const BatchFloat &NdotV) {
+    // r = Roughness * c0 + c1, c0 = (-1, -0.0275, -0.572, 0.022), c1 = (1, 0.0425, 1.04, -0.04)
+    BatchFloat rx = Roughness * -1.f + 1.f;
+    BatchFloat ry = Roughness * -0.0275f + 0.0425f;
+    BatchFloat rz = Roughness * -0.572f + 1.04f;
+    BatchFloat rw = Roughness * 0.022f - 0.04f;
+    BatchFloat a004 = min(rx * rx, exp2(-9.28f * NdotV)) * rx + ry;
+    BatchFloat ABx = -1.04f * a004 + rz;
+    BatchFloat ABy = 1.04f * a004 + rw;
+
+    ABy *= max(0.f, min(1.f, 50.0f * SpecularColor.y));
+
+    return SpecularColor * ABx + ABy;
+  }
+
   void shaderMain() override {
     float pointLightRangeInverse = 1.0f / 5.f;
 
@@ -320,6 +399,111 @@ class FS : public ShaderPbrIBL {
 
     gl->FragColor = glm::vec4(color + emissive, albedo_rgba.a);
   }
+
+  bool hasBatchMain() const override {
+    return true;
+  }
+
+  void shaderMainBatch(FragmentBatch &batch) override {
+    float pointLightRangeInverse = 1.0f / 5.f;
+
+    BatchVec2 texCoord = batch.varyingVec2(offsetof(ShaderVaryings, v_texCoord));
+
+    BatchVec4 albedo_rgba;
+    if (def->ALBEDO_MAP) {
+      albedo_rgba = texture(u->u_albedoMap, texCoord, batch.mask);
+    } else {
+      albedo_rgba = u->u_baseColor;
+    }
+
+    BatchVec3 albedo = pow(albedo_rgba.xyz(), 2.2f);
+
+    BatchFloat metallic = 0.0f;
+    BatchFloat roughness = 1.0f;
+    if (def->METALROUGHNESS_MAP) {
+      BatchVec4 metalRoughness = texture(u->u_metalRoughnessMap, texCoord, batch.mask);
+      metallic = metalRoughness.z;
+      roughness = metalRoughness.y;
+    }
+
+    BatchFloat ao = 1.f;
+    if (def->AO_MAP) {
+      ao = texture(u->u_aoMap, texCoord, batch.mask).x;
+    }
+
+    BatchVec3 N = GetNormalFromMap(batch, texCoord);
+    BatchVec3 V = normalize(batch.varyingVec3(offsetof(ShaderVaryings, v_cameraDirection)));
+    BatchVec3 R = reflect(-V, N);
+
+    BatchVec3 F0(0.04f);
+    F0 = mix(F0, albedo, metallic);
+
+    // reflectance equation
+    BatchVec3 Lo(0.0f);
+
+    // Light begin ---------------------------------------------------------------
+    if (u->u_enableLight) {
+      // calculate per-light radiance
+      BatchVec3 lightDir = batch.varyingVec3(offsetof(ShaderVaryings, v_lightDirection));
+      BatchVec3 L = normalize(lightDir);
+      BatchVec3 H = normalize(V + L);
+
+      BatchVec3 lDir = lightDir * pointLightRangeInverse;
+      BatchFloat attenuation = clamp(1.0f - dot(lDir, lDir), 0.0f, 1.0f);
+      BatchVec3 radiance = BatchVec3(u->u_pointLightColor) * attenuation;
+
+      // Cook-Torrance BRDF
+      BatchFloat NDF = DistributionGGX(N, H, roughness);
+      BatchFloat G = GeometrySmith(N, V, L, roughness);
+      BatchVec3 F = FresnelSchlick(max(dot(H, V), 0.0f), F0);
+
+      BatchVec3 numerator = NDF * G * F;
+      // + 0.0001 to prevent divide by zero
+      BatchFloat denominator = 4.0f * max(dot(N, V), 0.0f) * max(dot(N, L), 0.0f) + 0.0001f;
+      BatchVec3 specular = numerator / denominator;
+
+      BatchVec3 kS = F;
+      BatchVec3 kD = 1.0f - kS;
+      kD *= 1.0f - metallic;
+
+      BatchFloat NdotL = max(dot(N, L), 0.0f);
+      Lo += (kD * albedo / PI + specular) * radiance * NdotL;
+    }
+    // Light end ---------------------------------------------------------------
+
+    // Ambient begin ---------------------------------------------------------------
+    BatchVec3 ambient(0.f);
+    if (u->u_enableIBL) {
+      BatchVec3 F = FresnelSchlickRoughness(max(dot(N, V), 0.0f), F0, roughness);
+
+      BatchVec3 kS = F;
+      BatchVec3 kD = 1.0f - kS;
+      kD *= (1.0f - metallic);
+
+      BatchVec3 irradiance = texture(u->u_irradianceMap, N, batch.mask).xyz();
+      BatchVec3 diffuse = irradiance * albedo;
+
+      const float MAX_REFLECTION_LOD = 4.0f;
+      BatchVec3 prefilteredColor = textureLod(u->u_prefilterMap, R, roughness * MAX_REFLECTION_LOD, batch.mask).xyz();
+      BatchVec3 specular = prefilteredColor * EnvBRDFApprox(F, roughness, max(dot(N, V), 0.0f));
+      ambient = (kD * diffuse + specular) * ao;
+    } else {
+      ambient = BatchVec3(u->u_ambientColor) * albedo * ao;
+    }
+    // Ambient end ---------------------------------------------------------------
+
+    BatchVec3 color = ambient + Lo;
+    // gamma correct
+    color = pow(color, 1.0f / 2.2f);
+
+    // emissive
+    BatchVec3 emissive(0.f);
+    if (def->EMISSIVE_MAP) {
+      emissive = texture(u->u_emissiveMap, texCoord, batch.mask).xyz();
+    }
+
+    batch.fragColor = BatchVec4(color + emissive, albedo_rgba.w);
+  }
 };
 
 }
@@ -87,6 +87,13 @@ class FS : public ShaderSkybox {
     return uv;
   }
 
+  static BatchVec2 SampleSphericalMap(const BatchVec3 &dir) {
+    BatchVec2 uv = BatchVec2(atan(dir.z, dir.x), asin(-dir.y));
+    uv = uv * BatchVec2(0.1591f, 0.3183f);
+    uv = uv + 0.5f;
+    return uv;
+  }
+
   void shaderMain() override {
     if (def->EQUIRECTANGULAR_MAP) {
       glm::vec2 uv = SampleSphericalMap(normalize(v->v_worldPos));
@@ -95,6 +102,20 @@ class FS : public ShaderSkybox {
       gl->FragColor = texture(u->u_cubeMap, v->v_worldPos);
     }
   }
+
+  bool hasBatchMain() const override {
+    return true;
+  }
+
+  void shaderMainBatch(FragmentBatch &batch) override {
+    BatchVec3 worldPos = batch.varyingVec3(offsetof(ShaderVaryings, v_worldPos));
+    if (def->EQUIRECTANGULAR_MAP) {
+      BatchVec2 uv = SampleSphericalMap(normalize(worldPos));
+      batch.fragColor = texture(u->u_equirectangularMap, uv, batch.mask);
+    } else {
+      batch.fragColor = texture(u->u_cubeMap, worldPos, batch.mask);
+    }
+  }
 };
 
 }
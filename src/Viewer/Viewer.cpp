@@ -2,6 +2,7 @@
 #include <algorithm>
 #include "Utils/Logger.h"
 #include "Utils/Hash.h"
+#include "Utils/ThreadPool.h"
 #include "Environment.h"
 
 namespace Learn
@@ -839,6 +840,9 @@ namespace Learn
                 return true;
             }
 
+            // precompute work queues behind frame and loading tasks of the shared scheduler
+            ThreadPool::LaneScope lane(TaskLane_IBL);
+
             auto &skybox = scene_->skybox;
             if (skybox.material->textures.empty())
             {
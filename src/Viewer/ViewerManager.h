@@ -84,6 +84,7 @@ namespace Learn
                                                { dumpFrame_ = true; });
                 configPanel_->setUpdateLightFunc([&](glm::vec3 &position, glm::vec3 &color) -> void
                                                  {
+      waitRenderIdle();
       auto &scene = modelLoader_->getScene();
       scene.pointLight.vertexes[0].a_position = position;
       scene.pointLight.UpdataVertexes();
@@ -25,12 +25,25 @@ namespace Learn
             {
                 camera_->setReverseZ(config_.reverseZ);
                 cameraDepth_->setReverseZ(config_.reverseZ);
+
+                auto *rendererSoft = dynamic_cast<RendererSoft *>(renderer_.get());
+                if (rendererSoft)
+                {
+                    rendererSoft->setEnableVisibilityBuffer(config_.visibilityBuffer);
+                    rendererSoft->setEnableCommandList(config_.commandList);
+                }
             }
 
             int swapBuffer() override
             {
-                auto *texOut = dynamic_cast<TextureSoft<RGBA> *>(texColorMain_.get());
-                auto buffer = texOut->getImage().getBuffer()->buffer;
+                // shows the latest completed frame, the one just recorded may still be rendering
+                auto *rendererSoft = dynamic_cast<RendererSoft *>(renderer_.get());
+                rendererSoft->present(texColorMain_);
+                auto buffer = rendererSoft->acquirePresentBuffer();
+                if (!buffer)
+                {
+                    return outTexId_;
+                }
                 GL_CHECK(glBindTexture(GL_TEXTURE_2D, outTexId_));
                 GL_CHECK(glTexSubImage2D(GL_TEXTURE_2D,
                                          0,
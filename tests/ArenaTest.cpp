@@ -0,0 +1,50 @@
+#include <gtest/gtest.h>
+#include "Utils/Arena.h"
+
+using namespace Learn;
+
+// 测试分配结果对齐且互不重叠
+TEST(ArenaTest, AllocAligned) {
+    Arena arena(1024);
+    EXPECT_EQ(arena.alloc<float>(0), nullptr);
+
+    float *a = arena.alloc<float>(3);
+    uint8_t *b = arena.alloc<uint8_t>(1);
+    float *c = arena.alloc<float>(10);
+    ASSERT_NE(a, nullptr);
+    ASSERT_NE(b, nullptr);
+    ASSERT_NE(c, nullptr);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(a) % ALIGNED_MEMORY_ALIGNMENT, 0);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(b) % ALIGNED_MEMORY_ALIGNMENT, 0);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(c) % ALIGNED_MEMORY_ALIGNMENT, 0);
+    EXPECT_GE(reinterpret_cast<uint8_t *>(b), reinterpret_cast<uint8_t *>(a + 3));
+    EXPECT_GE(reinterpret_cast<uint8_t *>(c), b + 1);
+    EXPECT_EQ(arena.getBlockCnt(), 1);
+}
+
+// 测试超出块大小时追加新块，reset 后合并为一个块
+TEST(ArenaTest, ResetMergesBlocks) {
+    Arena arena(256);
+    for (int i = 0; i < 8; i++) {
+        uint8_t *ptr = arena.alloc<uint8_t>(200);
+        ASSERT_NE(ptr, nullptr);
+        memset(ptr, i, 200);
+    }
+    EXPECT_EQ(arena.getBlockCnt(), 8);
+
+    // 大于块大小的分配
+    EXPECT_NE(arena.alloc<uint8_t>(1000), nullptr);
+    EXPECT_EQ(arena.getBlockCnt(), 9);
+    size_t capacity = arena.getCapacity();
+
+    arena.reset();
+    EXPECT_EQ(arena.getBlockCnt(), 1);
+    EXPECT_EQ(arena.getCapacity(), capacity);
+
+    // 相同的分配序列不再需要新块
+    for (int i = 0; i < 8; i++) {
+        EXPECT_NE(arena.alloc<uint8_t>(200), nullptr);
+    }
+    EXPECT_NE(arena.alloc<uint8_t>(1000), nullptr);
+    EXPECT_EQ(arena.getBlockCnt(), 1);
+}
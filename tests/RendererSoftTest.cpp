@@ -0,0 +1,1722 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include "Render/Soft/RendererSoft.h"
+#include "Render/Soft/TextureSoft.h"
+#include "Render/Soft/ShaderProgramSoft.h"
+
+// 统计堆分配次数
+static std::atomic<size_t> heapAllocCnt{0};
+
+void *operator new(size_t size) {
+  heapAllocCnt++;
+  void *ptr = malloc(size > 0 ? size : 1);
+  if (!ptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+  free(ptr);
+}
+
+namespace Learn {
+namespace Test {
+
+// 测试用着色器：插值顶点颜色
+namespace ShaderTestColor {
+
+struct ShaderDefines {
+};
+
+struct ShaderAttributes {
+  glm::vec3 a_position;
+  glm::vec4 a_color;
+};
+
+struct ShaderUniforms {
+  glm::mat4 u_mvp;
+};
+
+struct ShaderVaryings {
+  glm::vec4 v_color;
+};
+
+class ShaderTestColor : public ShaderSoft {
+ public:
+  CREATE_SHADER_OVERRIDE
+
+  std::vector<std::string> &getDefines() override {
+    static std::vector<std::string> defines;
+    return defines;
+  }
+
+  std::vector<UniformDesc> &getUniformsDesc() override {
+    static std::vector<UniformDesc> desc = {
+        {"UniformsTest", offsetof(ShaderUniforms, u_mvp)},
+    };
+    return desc;
+  };
+};
+
+// 完整顶点着色入口的调用次数
+static std::atomic<size_t> vertexMainCalls{0};
+
+class VS : public ShaderTestColor {
+ public:
+  CREATE_SHADER_CLONE(VS)
+
+  void shaderMain() override {
+    gl->Position = u->u_mvp * glm::vec4(a->a_position, 1.0);
+    v->v_color = a->a_color;
+    vertexMainCalls++;
+  }
+
+  bool hasPositionMain() const override {
+    return true;
+  }
+
+  void shaderMainPosition() override {
+    gl->Position = u->u_mvp * glm::vec4(a->a_position, 1.0);
+  }
+};
+
+class FS : public ShaderTestColor {
+ public:
+  CREATE_SHADER_CLONE(FS)
+
+  void shaderMain() override {
+    gl->FragColor = v->v_color;
+  }
+
+  bool hasBatchMain() const override {
+    return true;
+  }
+
+  void shaderMainBatch(FragmentBatch &batch) override {
+    batch.fragColor = batch.varyingVec4(offsetof(ShaderVaryings, v_color));
+  }
+};
+
+}
+
+// 测试用着色器：输出纹理中心的颜色
+namespace ShaderTestTexture {
+
+struct ShaderDefines {
+};
+
+struct ShaderAttributes {
+  glm::vec3 a_position;
+  glm::vec4 a_color;
+};
+
+struct ShaderUniforms {
+  glm::mat4 u_mvp;
+  Sampler2DSoft<RGBA> *u_tex;
+};
+
+struct ShaderVaryings {
+  glm::vec4 v_color;
+};
+
+class ShaderTestTexture : public ShaderSoft {
+ public:
+  CREATE_SHADER_OVERRIDE
+
+  std::vector<std::string> &getDefines() override {
+    static std::vector<std::string> defines;
+    return defines;
+  }
+
+  std::vector<UniformDesc> &getUniformsDesc() override {
+    static std::vector<UniformDesc> desc = {
+        {"UniformsTest", offsetof(ShaderUniforms, u_mvp)},
+        {"u_tex", offsetof(ShaderUniforms, u_tex)},
+    };
+    return desc;
+  };
+};
+
+class VS : public ShaderTestTexture {
+ public:
+  CREATE_SHADER_CLONE(VS)
+
+  void shaderMain() override {
+    gl->Position = u->u_mvp * glm::vec4(a->a_position, 1.0);
+    v->v_color = a->a_color;
+  }
+};
+
+class FS : public ShaderTestTexture {
+ public:
+  CREATE_SHADER_CLONE(FS)
+
+  void shaderMain() override {
+    gl->FragColor = texture(u->u_tex, glm::vec2(0.5f));
+  }
+};
+
+}
+
+struct TestVertex {
+  glm::vec3 position;
+  glm::vec4 color;
+};
+
+class RendererSoftTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        renderer = std::make_shared<RendererSoft>();
+    }
+
+    void createTargets(int w, int h, bool multiSample = false, int sampleCount = SOFT_MS_CNT) {
+        width = w;
+        height = h;
+
+        TextureDesc colorDesc;
+        colorDesc.width = w;
+        colorDesc.height = h;
+        colorDesc.format = TextureFormat_RGBA8;
+        colorDesc.usage = TextureUsage_AttachmentColor;
+        colorDesc.multiSample = multiSample;
+        colorDesc.sampleCount = sampleCount;
+        colorTex = renderer->createTexture(colorDesc);
+        colorTex->initImageData();
+
+        TextureDesc depthDesc = colorDesc;
+        depthDesc.format = TextureFormat_FLOAT32;
+        depthDesc.usage = TextureUsage_AttachmentDepth;
+        depthTex = renderer->createTexture(depthDesc);
+        depthTex->initImageData();
+
+        fbo = renderer->createFrameBuffer(true);
+        fbo->setColorAttachment(colorTex, 0);
+        fbo->setDepthAttachment(depthTex);
+
+        program = renderer->createShaderProgram();
+        auto *programSoft = dynamic_cast<ShaderProgramSoft *>(program.get());
+        programSoft->SetShaders(std::make_shared<ShaderTestColor::VS>(), std::make_shared<ShaderTestColor::FS>());
+
+        uniformBlock = renderer->createUniformBlock("UniformsTest", sizeof(glm::mat4));
+        glm::mat4 mvp(1.f);
+        uniformBlock->setData(&mvp, sizeof(glm::mat4));
+        resources = std::make_shared<ShaderResources>();
+        resources->blocks[0] = uniformBlock;
+    }
+
+    void beginPass(const glm::vec4 &clearColor = glm::vec4(0.f), bool clearDepth = true, float depth = 1.f) {
+        ClearStates clearStates{};
+        clearStates.colorFlag = true;
+        clearStates.depthFlag = clearDepth;
+        clearStates.clearColor = clearColor;
+        clearStates.clearDepth = depth;
+        renderer->beginRenderPass(fbo, clearStates);
+        renderer->setViewPort(0, 0, width, height);
+    }
+
+    std::shared_ptr<VertexArrayObject> createVao(std::vector<TestVertex> &vertexes, std::vector<int32_t> &indices) {
+        VertexArray vertexArray;
+        vertexArray.vertexSize = sizeof(TestVertex);
+        vertexArray.vertexesDesc = {{3, sizeof(TestVertex), 0}, {4, sizeof(TestVertex), offsetof(TestVertex, color)}};
+        vertexArray.vertexesBuffer = reinterpret_cast<uint8_t *>(vertexes.data());
+        vertexArray.vertexesBufferLength = vertexes.size() * sizeof(TestVertex);
+        vertexArray.indexBuffer = indices.data();
+        vertexArray.indexBufferLength = indices.size() * sizeof(int32_t);
+        return renderer->createVertexArrayObject(vertexArray);
+    }
+
+    void draw(std::vector<TestVertex> &vertexes, std::vector<int32_t> &indices, const RenderStates &rs) {
+        auto vao = createVao(vertexes, indices);
+        auto states = renderer->createPipelineStates(rs);
+        renderer->setVertexArrayObject(vao);
+        renderer->setShaderProgram(program);
+        renderer->setShaderResources(resources);
+        renderer->setPipelineStates(states);
+        renderer->draw();
+    }
+
+    void endPass() {
+        renderer->endRenderPass();
+        renderer->waitIdle();
+    }
+
+    static void appendQuad(std::vector<TestVertex> &vertexes, std::vector<int32_t> &indices,
+                           glm::vec2 min, glm::vec2 max, float z, const glm::vec4 &color) {
+        auto base = (int32_t) vertexes.size();
+        vertexes.push_back({{min.x, min.y, z}, color});
+        vertexes.push_back({{max.x, min.y, z}, color});
+        vertexes.push_back({{max.x, max.y, z}, color});
+        vertexes.push_back({{min.x, max.y, z}, color});
+        indices.insert(indices.end(), {base, base + 1, base + 2, base, base + 2, base + 3});
+    }
+
+    RGBA pixel(int x, int y) {
+        auto *tex = dynamic_cast<TextureSoft<RGBA> *>(colorTex.get());
+        return *tex->getImage().getBuffer()->buffer->get(x, y);
+    }
+
+    static bool colorNear(const RGBA &a, const RGBA &b, int tolerance = 1) {
+        for (int i = 0; i < 4; i++) {
+            if (std::abs((int) a[i] - (int) b[i]) > tolerance) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::vector<RGBA> snapshot() {
+        auto *tex = dynamic_cast<TextureSoft<RGBA> *>(colorTex.get());
+        auto &buffer = tex->getImage().getBuffer()->buffer;
+        return {buffer->getRawDataPtr(), buffer->getRawDataPtr() + buffer->getRawDataSize()};
+    }
+
+    // 仅有深度附件的帧缓冲，与 fbo 共享深度纹理
+    std::shared_ptr<FrameBuffer> createDepthOnlyFbo() {
+        auto ret = renderer->createFrameBuffer(true);
+        ret->setDepthAttachment(depthTex);
+        return ret;
+    }
+
+    std::vector<float> depthSnapshot() {
+        auto *tex = dynamic_cast<TextureSoft<float> *>(depthTex.get());
+        auto image = tex->getImage().getBuffer();
+        if (image->multiSample) {
+            image->expandAll();
+            auto &buffer = image->bufferMs;
+            return {buffer->getRawDataPtr(), buffer->getRawDataPtr() + buffer->getRawDataSize()};
+        }
+        auto &buffer = image->buffer;
+        return {buffer->getRawDataPtr(), buffer->getRawDataPtr() + buffer->getRawDataSize()};
+    }
+
+    // 深度倾斜、相互穿插的三角形
+    static void appendSlopedTriangles(std::vector<TestVertex> &vertexes, std::vector<int32_t> &indices, int count) {
+        uint32_t seed = 7;
+        auto random = [&seed]() {
+            seed = seed * 1664525u + 1013904223u;
+            return (float) (seed >> 8) / (float) (1 << 24);
+        };
+        for (int i = 0; i < count; i++) {
+            glm::vec4 color(random(), random(), random(), 1.f);
+            for (int k = 0; k < 3; k++) {
+                indices.push_back((int32_t) vertexes.size());
+                vertexes.push_back({{random() * 2.4f - 1.2f, random() * 2.4f - 1.2f, random() * 1.2f - 0.1f}, color});
+            }
+        }
+    }
+
+    std::shared_ptr<RendererSoft> renderer;
+    std::shared_ptr<Texture> colorTex;
+    std::shared_ptr<Texture> depthTex;
+    std::shared_ptr<FrameBuffer> fbo;
+    std::shared_ptr<ShaderProgram> program;
+    std::shared_ptr<UniformBlock> uniformBlock;
+    std::shared_ptr<ShaderResources> resources;
+    int width = 0;
+    int height = 0;
+};
+
+// 测试全屏绘制覆盖所有 tile（包括非对齐的边缘 tile）
+TEST_F(RendererSoftTest, FullscreenQuadCoversAllTiles) {
+    createTargets(75, 41);
+    std::vector<TestVertex> vertexes;
+    std::vector<int32_t> indices;
+    appendQuad(vertexes, indices, {-1.f, -1.f}, {1.f, 1.f}, 0.f, {1.f, 0.f, 0.f, 1.f});
+
+    RenderStates rs;
+    rs.depthTest = true;
+    beginPass();
+    draw(vertexes, indices, rs);
+    endPass();
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            ASSERT_TRUE(colorNear(pixel(x, y), RGBA(255, 0, 0, 255))) << "x=" << x << " y=" << y;
+        }
+    }
+}
+
+// 测试深度测试与提交顺序无关
+TEST_F(RendererSoftTest, DepthTestResolvesOverlap) {
+    createTargets(64, 64);
+    RenderStates rs;
+    rs.depthTest = true;
+
+    for (int order = 0; order < 2; order++) {
+        std::vector<TestVertex> vertexes;
+        std::vector<int32_t> indices;
+        glm::vec4 far = {1.f, 0.f, 0.f, 1.f};
+        glm::vec4 near = {0.f, 1.f, 0.f, 1.f};
+        if (order == 0) {
+            appendQuad(vertexes, indices, {-1.f, -1.f}, {1.f, 1.f}, 0.5f, far);
+            appendQuad(vertexes, indices, {-0.5f, -0.5f}, {0.5f, 0.5f}, 0.2f, near);
+        } else {
+            appendQuad(vertexes, indices, {-0.5f, -0.5f}, {0.5f, 0.5f}, 0.2f, near);
+            appendQuad(vertexes, indices, {-1.f, -1.f}, {1.f, 1.f}, 0.5f, far);
+        }
+
+        beginPass();
+        draw(vertexes, indices, rs);
+        endPass();
+
+        EXPECT_TRUE(colorNear(pixel(32, 32), RGBA(0, 255, 0, 255)));
+        EXPECT_TRUE(colorNear(pixel(2, 2), RGBA(255, 0, 0, 255)));
+        EXPECT_TRUE(colorNear(pixel(61, 61), RGBA(255, 0, 0, 255)));
+    }
+}
+
+// 测试混合结果确定（同一 tile 内按提交顺序光栅化）
+TEST_F(RendererSoftTest, BlendingIsDeterministic) {
+    createTargets(128, 96);
+    std::vector<TestVertex> vertexes;
+    std::vector<int32_t> indices;
+    for (int i = 0; i < 64; i++) {
+        float offset = (float) (i % 8) * 0.1f - 0.8f;
+        glm::vec4 color = {(float) (i % 3) * 0.5f, (float) (i % 5) * 0.25f, (float) (i % 7) / 6.f, 0.5f};
+        appendQuad(vertexes, indices, {offset, offset}, {offset + 0.9f, offset + 0.7f}, 0.f, color);
+    }
+
+    RenderStates rs;
+    rs.blend = true;
+    rs.blendParams.setBlendFactor(BlendFactor::SRC_ALPHA, BlendFactor::ONE_MINUS_SRC_ALPHA);
+
+    beginPass();
+    draw(vertexes, indices, rs);
+    endPass();
+    auto reference = snapshot();
+
+    for (int run = 0; run < 4; run++) {
+        beginPass();
+        draw(vertexes, indices, rs);
+        endPass();
+        ASSERT_EQ(snapshot(), reference);
+    }
+}
+
+// 测试共享边只被一个三角形覆盖（对角线穿过像素中心）
+TEST_F(RendererSoftTest, SharedEdgeCoveredOnce) {
+    createTargets(64, 64);
+    std::vector<TestVertex> vertexes;
+    std::vector<int32_t> indices;
+    appendQuad(vertexes, indices, {-1.f, -1.f}, {1.f, 1.f}, 0.f, {0.25f, 0.25f, 0.25f, 1.f});
+
+    RenderStates rs;
+    rs.blend = true;
+    rs.blendParams.setBlendFactor(BlendFactor::ONE, BlendFactor::ONE);
+    beginPass();
+    draw(vertexes, indices, rs);
+    endPass();
+
+    RGBA expect = pixel(0, 63);
+    EXPECT_GT(expect.r, 0);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            ASSERT_EQ(pixel(x, y), expect) << "x=" << x << " y=" << y;
+        }
+    }
+}
+
+// 测试 4x MSAA 边缘覆盖：边界穿过像素中间，一半采样点被覆盖
+TEST_F(RendererSoftTest, MultiSampleEdgeCoverage) {
+    createTargets(64, 64, true);
+    std::vector<TestVertex> vertexes;
+    std::vector<int32_t> indices;
+    // x 范围 [0, 10.5] 像素
+    appendQuad(vertexes, indices, {-1.f, -1.f}, {10.5f / 32.f - 1.f, 1.f}, 0.f, {1.f, 0.f, 0.f, 1.f});
+
+    RenderStates rs;
+    rs.depthTest = true;
+    beginPass();
+    draw(vertexes, indices, rs);
+    endPass();
+
+    for (int y = 0; y < height; y++) {
+        ASSERT_TRUE(colorNear(pixel(5, y), RGBA(255, 0, 0, 255))) << "y=" << y;
+        ASSERT_TRUE(colorNear(pixel(10, y), RGBA(127, 0, 0, 127))) << "y=" << y;
+        ASSERT_EQ(pixel(11, y), RGBA(0, 0, 0, 0)) << "y=" << y;
+    }
+}
+
+// 测试分块快速接受/拒绝：大三角形与细长三角形的覆盖与像素中心参考结果一致
+TEST_F(RendererSoftTest, BlockCoverageMatchesReference) {
+    createTargets(160, 96);
+    std::vector<glm::vec2> triangles = {
+        {-0.9f, -0.95f}, {0.95f, -0.7f}, {0.1f, 0.9f},      // 大三角形，覆盖多个完整 block
+        {-1.f, 0.98f}, {1.f, -0.99f}, {1.f, -0.96f},       // 细长三角形，跨越对角线上的 tile
+    };
+
+    std::vector<TestVertex> vertexes;
+    std::vector<int32_t> indices;
+    for (auto &pos : triangles) {
+        indices.push_back((int32_t) vertexes.size());
+        vertexes.push_back({{pos.x, pos.y, 0.f}, {1.f, 1.f, 1.f, 1.f}});
+    }
+
+    RenderStates rs;
+    beginPass();
+    draw(vertexes, indices, rs);
+    endPass();
+
+    auto edge = [](const glm::vec2 &a, const glm::vec2 &b, const glm::vec2 &p) {
+      return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+    };
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            glm::vec2 p(x + 0.5f, y + 0.5f);
+            bool inside = false;
+            bool nearEdge = false;
+            for (size_t t = 0; t < triangles.size(); t += 3) {
+                glm::vec2 v[3];
+                for (int i = 0; i < 3; i++) {
+                    v[i] = (triangles[t + i] * 0.5f + 0.5f) * glm::vec2(width, height);
+                }
+                float area = edge(v[0], v[1], v[2]);
+                float e[3] = {edge(v[1], v[2], p) / area, edge(v[2], v[0], p) / area, edge(v[0], v[1], p) / area};
+                float minE = std::min(std::min(e[0], e[1]), e[2]);
+                inside |= minE > 0.f;
+                nearEdge |= std::abs(e[0]) < 0.02f || std::abs(e[1]) < 0.02f || std::abs(e[2]) < 0.02f;
+            }
+            if (nearEdge) {
+                continue;
+            }
+            ASSERT_EQ(pixel(x, y).r > 0, inside) << "x=" << x << " y=" << y;
+        }
+    }
+}
+
+// 测试 HiZ 粗粒度剔除不影响结果：跨 pass 保留深度、相等深度重绘、GREATER 比较
+TEST_F(RendererSoftTest, HiZOcclusionKeepsDepthOrder) {
+    createTargets(96, 64);
+    glm::vec4 red = {1.f, 0.f, 0.f, 1.f};
+    glm::vec4 green = {0.f, 1.f, 0.f, 1.f};
+    glm::vec4 blue = {0.f, 0.f, 1.f, 1.f};
+
+    RenderStates rs;
+    rs.depthTest = true;
+    rs.depthFunc = LEQUAL;
+
+    std::vector<TestVertex> vertexes;
+    std::vector<int32_t> indices;
+    appendQuad(vertexes, indices, {-0.5f, -0.5f}, {0.5f, 0.5f}, 0.2f, green);
+    appendQuad(vertexes, indices, {-1.f, -1.f}, {1.f, 1.f}, 0.5f, red);
+    beginPass();
+    draw(vertexes, indices, rs);
+    endPass();
+    EXPECT_TRUE(colorNear(pixel(48, 32), RGBA(0, 255, 0, 255)));
+    EXPECT_TRUE(colorNear(pixel(2, 2), RGBA(255, 0, 0, 255)));
+
+    // 不清除深度，HiZ 需要从深度缓冲重建
+    vertexes.clear();
+    indices.clear();
+    appendQuad(vertexes, indices, {-1.f, -1.f}, {1.f, 1.f}, 0.3f, blue);
+    appendQuad(vertexes, indices, {-0.5f, -0.5f}, {0.5f, 0.5f}, 0.2f, red);
+    beginPass(glm::vec4(0.f), false);
+    draw(vertexes, indices, rs);
+    endPass();
+    EXPECT_TRUE(colorNear(pixel(48, 32), RGBA(255, 0, 0, 255)));
+    EXPECT_TRUE(colorNear(pixel(2, 2), RGBA(0, 0, 255, 255)));
+
+    // GREATER：清除深度为 0，远处的图元覆盖近处
+    rs.depthFunc = GREATER;
+    vertexes.clear();
+    indices.clear();
+    appendQuad(vertexes, indices, {-1.f, -1.f}, {1.f, 1.f}, 0.5f, red);
+    appendQuad(vertexes, indices, {-0.5f, -0.5f}, {0.5f, 0.5f}, 0.2f, green);
+    appendQuad(vertexes, indices, {-0.25f, -0.25f}, {0.25f, 0.25f}, 0.8f, blue);
+    beginPass(glm::vec4(0.f), true, 0.f);
+    draw(vertexes, indices, rs);
+    endPass();
+    EXPECT_TRUE(colorNear(pixel(48, 32), RGBA(0, 0, 255, 255)));
+    EXPECT_TRUE(colorNear(pixel(30, 32), RGBA(255, 0, 0, 255)));
+    EXPECT_TRUE(colorNear(pixel(2, 2), RGBA(255, 0, 0, 255)));
+}
+
+// 测试可见性缓冲模式与直接着色结果一致（每次绘制的 uniform 不同，中间插入混合绘制）
+TEST_F(RendererSoftTest, VisibilityBufferMatchesForward) {
+    createTargets(100, 70);
+
+    auto renderScene = [&](bool visibility) {
+      renderer->setEnableVisibilityBuffer(visibility);
+      RenderStates opaque;
+      opaque.depthTest = true;
+      RenderStates blend;
+      blend.blend = true;
+      blend.blendParams.setBlendFactor(BlendFactor::SRC_ALPHA, BlendFactor::ONE_MINUS_SRC_ALPHA);
+
+      beginPass();
+      for (int i = 0; i < 6; i++) {
+          std::vector<TestVertex> vertexes;
+          std::vector<int32_t> indices;
+          appendQuad(vertexes, indices, {-0.6f, -0.5f}, {0.4f, 0.6f}, 0.8f - (float) i * 0.1f,
+                     {(float) (i % 2), (float) (i % 3) * 0.5f, (float) i / 5.f, 1.f});
+          // 每次绘制使用不同的变换
+          glm::mat4 mvp = glm::translate(glm::mat4(1.f), glm::vec3((float) i * 0.08f, (float) i * -0.05f, 0.f));
+          mvp = glm::rotate(mvp, (float) i * 0.3f, glm::vec3(0.f, 0.f, 1.f));
+          uniformBlock->setData(&mvp, sizeof(glm::mat4));
+          draw(vertexes, indices, i == 3 ? blend : opaque);
+      }
+      endPass();
+      return snapshot();
+    };
+
+    auto forward = renderScene(false);
+    auto visibility = renderScene(true);
+    ASSERT_EQ(forward.size(), visibility.size());
+    size_t diffCnt = 0;
+    for (size_t i = 0; i < forward.size(); i++) {
+        if (!colorNear(forward[i], visibility[i])) {
+            diffCnt++;
+        }
+    }
+    EXPECT_EQ(diffCnt, 0);
+}
+
+// 测试同一 pass 内两次可见性缓冲绘制之间缩小视口，先前绘制的像素仍被着色
+TEST_F(RendererSoftTest, VisibilityBufferViewportChange) {
+    createTargets(100, 70);
+
+    auto renderScene = [&](bool visibility) {
+        renderer->setEnableVisibilityBuffer(visibility);
+        RenderStates rs;
+        rs.depthTest = true;
+        glm::mat4 mvp(1.f);
+        uniformBlock->setData(&mvp, sizeof(glm::mat4));
+
+        beginPass();
+        std::vector<TestVertex> vertexes;
+        std::vector<int32_t> indices;
+        appendQuad(vertexes, indices, {-0.9f, -0.9f}, {0.9f, 0.9f}, 0.5f, {1.f, 0.f, 0.f, 1.f});
+        draw(vertexes, indices, rs);
+
+        // 第二次绘制只覆盖左下四分之一
+        renderer->setViewPort(0, 0, width / 2, height / 2);
+        vertexes.clear();
+        indices.clear();
+        appendQuad(vertexes, indices, {-0.5f, -0.5f}, {0.5f, 0.5f}, 0.2f, {0.f, 0.f, 1.f, 1.f});
+        draw(vertexes, indices, rs);
+        endPass();
+        return snapshot();
+    };
+
+    auto forward = renderScene(false);
+    EXPECT_EQ(glm::ivec4(forward[60 * width + 80]), glm::ivec4(255, 0, 0, 255));
+    auto visibility = renderScene(true);
+    ASSERT_EQ(forward.size(), visibility.size());
+    size_t diffCnt = 0;
+    for (size_t i = 0; i < forward.size(); i++) {
+        if (!colorNear(forward[i], visibility[i])) {
+            diffCnt++;
+        }
+    }
+    EXPECT_EQ(diffCnt, 0);
+}
+
+// 测试批量片元着色与逐像素着色结果一致（单采样与 4x MSAA）
+TEST_F(RendererSoftTest, BatchShadingMatchesScalar) {
+    for (bool multiSample : {false, true}) {
+        createTargets(70, 50, multiSample);
+        std::vector<TestVertex> vertexes = {
+            {{-0.9f, -0.8f, 0.3f}, {1.f, 0.f, 0.f, 1.f}},
+            {{0.85f, -0.6f, 0.5f}, {0.f, 1.f, 0.f, 0.5f}},
+            {{-0.2f, 0.9f, 0.4f}, {0.f, 0.f, 1.f, 1.f}},
+        };
+        std::vector<int32_t> indices = {0, 1, 2};
+
+        RenderStates rs;
+        rs.depthTest = true;
+        rs.blend = true;
+        rs.blendParams.setBlendFactor(BlendFactor::SRC_ALPHA, BlendFactor::ONE_MINUS_SRC_ALPHA);
+
+        renderer->setEnableBatchShading(false);
+        beginPass(glm::vec4(0.2f, 0.2f, 0.2f, 1.f));
+        draw(vertexes, indices, rs);
+        endPass();
+        auto scalar = snapshot();
+
+        renderer->setEnableBatchShading(true);
+        beginPass(glm::vec4(0.2f, 0.2f, 0.2f, 1.f));
+        draw(vertexes, indices, rs);
+        endPass();
+        auto batched = snapshot();
+
+        ASSERT_EQ(scalar.size(), batched.size());
+        for (size_t i = 0; i < scalar.size(); i++) {
+            ASSERT_EQ(scalar[i], batched[i]) << "index=" << i << " multiSample=" << multiSample;
+        }
+    }
+}
+
+// 测试顶点数超过分块大小时多线程顶点着色的结果（每个格子颜色由其位置决定）
+TEST_F(RendererSoftTest, ChunkedVertexShadingLargeMesh) {
+    const int cells = 64;
+    createTargets(cells * 2, cells * 2);
+    std::vector<TestVertex> vertexes;
+    std::vector<int32_t> indices;
+    auto cellColor = [](int cx, int cy) {
+        return glm::vec4((float) cx / 63.f, (float) cy / 63.f, (float) ((cx + cy) % 2), 1.f);
+    };
+    float step = 2.f / cells;
+    for (int cy = 0; cy < cells; cy++) {
+        for (int cx = 0; cx < cells; cx++) {
+            glm::vec2 min(-1.f + cx * step, -1.f + cy * step);
+            appendQuad(vertexes, indices, min, min + glm::vec2(step), 0.5f, cellColor(cx, cy));
+        }
+    }
+    ASSERT_GT(vertexes.size(), 4096u * 3);
+
+    RenderStates rs;
+    rs.depthTest = true;
+    beginPass();
+    draw(vertexes, indices, rs);
+    endPass();
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            RGBA expected = glm::clamp(cellColor(x / 2, y / 2), 0.f, 1.f) * 255.f;
+            ASSERT_TRUE(colorNear(pixel(x, y), expected)) << "x=" << x << " y=" << y;
+        }
+    }
+}
+
+// 测试仅深度绘制（无颜色附件）写入的深度与着色路径完全一致（单采样与 4x MSAA）
+TEST_F(RendererSoftTest, DepthOnlyMatchesShadedDepth) {
+    for (bool multiSample : {false, true}) {
+        createTargets(75, 41, multiSample);
+        std::vector<TestVertex> vertexes;
+        std::vector<int32_t> indices;
+        appendSlopedTriangles(vertexes, indices, 24);
+
+        RenderStates rs;
+        rs.depthTest = true;
+        rs.depthFunc = LESS;
+        beginPass();
+        draw(vertexes, indices, rs);
+        endPass();
+        auto shaded = depthSnapshot();
+
+        auto colorFbo = fbo;
+        fbo = createDepthOnlyFbo();
+        beginPass();
+        draw(vertexes, indices, rs);
+        endPass();
+        auto depthOnly = depthSnapshot();
+
+        // 关闭深度写入时不应修改深度
+        rs.depthMask = false;
+        std::vector<TestVertex> cover;
+        std::vector<int32_t> coverIndices;
+        appendQuad(cover, coverIndices, {-1.f, -1.f}, {1.f, 1.f}, 0.f, glm::vec4(1.f));
+        beginPass(glm::vec4(0.f), false);
+        draw(cover, coverIndices, rs);
+        endPass();
+        fbo = colorFbo;
+
+        ASSERT_EQ(shaded.size(), depthOnly.size());
+        size_t written = 0;
+        for (size_t i = 0; i < shaded.size(); i++) {
+            ASSERT_EQ(shaded[i], depthOnly[i]) << "index=" << i << " multiSample=" << multiSample;
+            written += shaded[i] < 1.f ? 1 : 0;
+        }
+        EXPECT_GT(written, shaded.size() / 2);
+        EXPECT_EQ(depthSnapshot(), depthOnly);
+    }
+}
+
+// 测试深度预pass + EQUAL 着色与直接 LESS 着色结果一致
+TEST_F(RendererSoftTest, DepthPrepassEqualMatchesForward) {
+    for (bool multiSample : {false, true}) {
+        createTargets(64, 48, multiSample);
+        std::vector<TestVertex> vertexes;
+        std::vector<int32_t> indices;
+        appendSlopedTriangles(vertexes, indices, 24);
+
+        RenderStates rs;
+        rs.depthTest = true;
+        rs.depthFunc = LESS;
+        beginPass();
+        draw(vertexes, indices, rs);
+        endPass();
+        auto forward = snapshot();
+
+        auto colorFbo = fbo;
+        fbo = createDepthOnlyFbo();
+        beginPass();
+        draw(vertexes, indices, rs);
+        endPass();
+        fbo = colorFbo;
+
+        rs.depthFunc = EQUAL;
+        rs.depthMask = false;
+        beginPass(glm::vec4(0.f), false);
+        draw(vertexes, indices, rs);
+        endPass();
+        auto prepass = snapshot();
+
+        ASSERT_EQ(forward.size(), prepass.size());
+        for (size_t i = 0; i < forward.size(); i++) {
+            ASSERT_TRUE(colorNear(forward[i], prepass[i])) << "index=" << i << " multiSample=" << multiSample;
+        }
+    }
+}
+
+// 测试仅深度绘制只运行顶点着色的位置入口（包括裁剪产生的新顶点）
+TEST_F(RendererSoftTest, DepthOnlyRunsPositionEntry) {
+    createTargets(64, 48);
+    std::vector<TestVertex> vertexes;
+    std::vector<int32_t> indices;
+    appendSlopedTriangles(vertexes, indices, 24);
+
+    RenderStates rs;
+    rs.depthTest = true;
+
+    auto colorFbo = fbo;
+    fbo = createDepthOnlyFbo();
+    ShaderTestColor::vertexMainCalls = 0;
+    beginPass();
+    draw(vertexes, indices, rs);
+    endPass();
+    EXPECT_EQ(ShaderTestColor::vertexMainCalls, 0);
+    auto depthOnly = depthSnapshot();
+
+    fbo = colorFbo;
+    beginPass();
+    draw(vertexes, indices, rs);
+    endPass();
+    EXPECT_GE(ShaderTestColor::vertexMainCalls, vertexes.size());
+    EXPECT_EQ(depthSnapshot(), depthOnly);
+}
+
+// 测试稳定状态下绘制不再分配堆内存（裁剪、线框、多线程顶点着色、MSAA）
+TEST_F(RendererSoftTest, SteadyStateDrawDoesNotAllocate) {
+    for (bool multiSample : {false, true}) {
+        createTargets(96, 64, multiSample);
+        std::vector<TestVertex> vertexes;
+        std::vector<int32_t> indices;
+        appendSlopedTriangles(vertexes, indices, 32);
+        auto clippedVao = createVao(vertexes, indices);
+
+        std::vector<TestVertex> gridVertexes;
+        std::vector<int32_t> gridIndices;
+        const int cells = 48;
+        for (int cy = 0; cy < cells; cy++) {
+            for (int cx = 0; cx < cells; cx++) {
+                glm::vec2 min(-1.f + cx * 2.f / cells, -1.f + cy * 2.f / cells);
+                appendQuad(gridVertexes, gridIndices, min, min + glm::vec2(2.f / cells), 0.5f, glm::vec4(1.f));
+            }
+        }
+        ASSERT_GT(gridVertexes.size(), 4096u);
+        auto gridVao = createVao(gridVertexes, gridIndices);
+
+        RenderStates fill;
+        fill.depthTest = true;
+        RenderStates wireframe = fill;
+        wireframe.polygonMode = PolygonMode::LINE;
+        auto fillStates = renderer->createPipelineStates(fill);
+        auto wireframeStates = renderer->createPipelineStates(wireframe);
+
+        auto renderFrame = [&]() {
+            beginPass();
+            renderer->setShaderProgram(program);
+            renderer->setShaderResources(resources);
+            size_t allocCnt = heapAllocCnt;
+            renderer->setVertexArrayObject(clippedVao);
+            renderer->setPipelineStates(fillStates);
+            renderer->draw();
+            renderer->setPipelineStates(wireframeStates);
+            renderer->draw();
+            renderer->setVertexArrayObject(gridVao);
+            renderer->setPipelineStates(fillStates);
+            renderer->draw();
+            allocCnt = heapAllocCnt - allocCnt;
+            endPass();
+            return allocCnt;
+        };
+
+        renderFrame();
+        renderFrame();
+        EXPECT_EQ(renderFrame(), 0) << "multiSample=" << multiSample;
+    }
+}
+
+// 测试保护带裁剪：只越过视口 x/y 的三角形不再生成裁剪顶点，结果与完整裁剪一致
+TEST_F(RendererSoftTest, GuardBandMatchesFullClipping) {
+    createTargets(80, 60);
+    std::vector<TestVertex> vertexes;
+    std::vector<int32_t> indices;
+    appendSlopedTriangles(vertexes, indices, 32);
+    // 深度限制在视锥内，只有 x/y 越界
+    for (auto &vertex : vertexes) {
+        vertex.position.z = glm::clamp(vertex.position.z, 0.f, 1.f);
+    }
+    // 远超视口的大三角形
+    TestVertex big[3] = {{{-40.f, -30.f, 0.9f}, {0.2f, 0.4f, 0.6f, 1.f}},
+                         {{50.f, -30.f, 0.9f}, {0.2f, 0.4f, 0.6f, 1.f}},
+                         {{0.f, 60.f, 0.9f}, {0.2f, 0.4f, 0.6f, 1.f}}};
+    for (auto &vertex : big) {
+        indices.push_back((int32_t) vertexes.size());
+        vertexes.push_back(vertex);
+    }
+
+    RenderStates rs;
+    rs.depthTest = true;
+    auto render = [&](bool guardBand) {
+      renderer->setEnableGuardBand(guardBand);
+      ShaderTestColor::vertexMainCalls = 0;
+      beginPass();
+      draw(vertexes, indices, rs);
+      endPass();
+      return snapshot();
+    };
+
+    auto clipped = render(false);
+    EXPECT_GT(ShaderTestColor::vertexMainCalls, vertexes.size());
+    auto guardBand = render(true);
+    EXPECT_EQ(ShaderTestColor::vertexMainCalls, vertexes.size());
+
+    ASSERT_EQ(clipped.size(), guardBand.size());
+    size_t diffCnt = 0;
+    for (size_t i = 0; i < clipped.size(); i++) {
+        if (!colorNear(clipped[i], guardBand[i], 2)) {
+            diffCnt++;
+        }
+    }
+    // 裁剪顶点吸附到子像素网格，边缘上的个别像素可能不同
+    EXPECT_LE(diffCnt, clipped.size() / 100);
+}
+
+// 测试剔除在裁剪前完成：同一三角形正反两种绕序各提交一次，开启剔除后只保留朝向相机的一个
+// 部分三角形跨过相机平面（w < 0），朝向以观察空间法线为参考
+TEST_F(RendererSoftTest, CullFaceBeforeClipping) {
+    createTargets(80, 60);
+    glm::mat4 view = glm::translate(glm::mat4(1.f), glm::vec3(0.f, 0.f, -2.f));
+    glm::mat4 mvp = glm::perspective(glm::radians(60.f), 80.f / 60.f, 0.1f, 10.f) * view;
+    uniformBlock->setData(&mvp, sizeof(glm::mat4));
+
+    // 37 个三角形，覆盖 8 个一组的批量路径和尾部的标量路径
+    std::vector<TestVertex> vertexes;
+    std::vector<int32_t> indices;
+    appendSlopedTriangles(vertexes, indices, 37);
+    for (auto &vertex : vertexes) {
+        vertex.position.z = vertex.position.z * 3.5f - 0.5f;
+    }
+
+    std::vector<int32_t> bothIndices;
+    std::vector<int32_t> frontIndices;
+    size_t crossingCnt = 0;
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        int32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+        glm::vec3 p0 = view * glm::vec4(vertexes[a].position, 1.f);
+        glm::vec3 p1 = view * glm::vec4(vertexes[b].position, 1.f);
+        glm::vec3 p2 = view * glm::vec4(vertexes[c].position, 1.f);
+        bool front = glm::dot(glm::cross(p1 - p0, p2 - p0), -p0) > 0.f;
+        if ((p0.z > 0.f) || (p1.z > 0.f) || (p2.z > 0.f)) {
+            crossingCnt++;
+        }
+
+        // 反向绕序使用另一组顶点（不同颜色）
+        auto reversedBase = (int32_t) vertexes.size();
+        for (int32_t idx : {a, c, b}) {
+            TestVertex vertex = vertexes[idx];
+            vertex.color = glm::vec4(1.f) - vertex.color;
+            vertex.color.a = 1.f;
+            vertexes.push_back(vertex);
+        }
+        bothIndices.insert(bothIndices.end(), {a, b, c, reversedBase, reversedBase + 1, reversedBase + 2});
+        if (front) {
+            frontIndices.insert(frontIndices.end(), {a, b, c});
+        } else {
+            frontIndices.insert(frontIndices.end(), {reversedBase, reversedBase + 1, reversedBase + 2});
+        }
+    }
+    ASSERT_GT(crossingCnt, 0);
+
+    auto render = [&](std::vector<int32_t> &drawIndices, bool cullFace) {
+      RenderStates rs;
+      rs.depthTest = true;
+      rs.cullFace = cullFace;
+      beginPass();
+      draw(vertexes, drawIndices, rs);
+      endPass();
+      return snapshot();
+    };
+
+    auto expected = render(frontIndices, false);
+    auto culled = render(bothIndices, true);
+    ASSERT_EQ(expected.size(), culled.size());
+    size_t diffCnt = 0;
+    for (size_t i = 0; i < expected.size(); i++) {
+        if (!colorNear(expected[i], culled[i])) {
+            diffCnt++;
+        }
+    }
+    EXPECT_EQ(diffCnt, 0);
+}
+
+
+// 测试微小三角形路径：密集网格（每个三角形不超过一个 2x2 quad）与分块光栅化结果一致
+TEST_F(RendererSoftTest, MicroTrianglesMatchBlockPath) {
+    for (bool multiSample : {false, true}) {
+        createTargets(80, 60, multiSample);
+
+        // 0.75 像素的网格，顶点颜色与深度随机，网格外再加一个大三角形打断合并
+        std::vector<TestVertex> vertexes;
+        std::vector<int32_t> indices;
+        uint32_t seed = 11;
+        auto random = [&seed]() {
+          seed = seed * 1664525u + 1013904223u;
+          return (float) (seed >> 8) / (float) (1 << 24);
+        };
+        const int cellsX = 100;
+        const int cellsY = 72;
+        for (int y = 0; y <= cellsY; y++) {
+            for (int x = 0; x <= cellsX; x++) {
+                glm::vec3 pos((float) x * 1.5f / 80.f - 0.95f, (float) y * 1.5f / 60.f - 0.95f, random() * 0.5f);
+                vertexes.push_back({pos, glm::vec4(random(), random(), random(), 1.f)});
+            }
+        }
+        for (int y = 0; y < cellsY; y++) {
+            for (int x = 0; x < cellsX; x++) {
+                int32_t i0 = y * (cellsX + 1) + x;
+                int32_t i1 = i0 + 1;
+                int32_t i2 = i0 + cellsX + 1;
+                int32_t i3 = i2 + 1;
+                indices.insert(indices.end(), {i0, i1, i3, i0, i3, i2});
+            }
+        }
+        std::vector<TestVertex> bigVertexes = {{{-0.5f, -0.5f, 0.2f}, {1.f, 0.f, 0.f, 1.f}},
+                                               {{0.5f, -0.5f, 0.2f}, {0.f, 1.f, 0.f, 1.f}},
+                                               {{0.f, 0.5f, 0.2f}, {0.f, 0.f, 1.f, 1.f}}};
+        std::vector<int32_t> bigIndices = {0, 1, 2};
+
+        RenderStates rs;
+        rs.depthTest = true;
+        auto render = [&](bool microTriangle) {
+          renderer->setEnableMicroTriangle(microTriangle);
+          beginPass();
+          draw(vertexes, indices, rs);
+          draw(bigVertexes, bigIndices, rs);
+          draw(vertexes, indices, rs);
+          endPass();
+          return std::make_pair(snapshot(), depthSnapshot());
+        };
+
+        auto block = render(false);
+        auto micro = render(true);
+        ASSERT_EQ(block.first.size(), micro.first.size());
+        for (size_t i = 0; i < block.first.size(); i++) {
+            ASSERT_TRUE(colorNear(block.first[i], micro.first[i])) << "multiSample=" << multiSample << " pixel=" << i;
+        }
+        ASSERT_EQ(block.second, micro.second) << "multiSample=" << multiSample;
+    }
+}
+
+// 测试线段分 tile 并行光栅化：跨 tile 的陡峭/平缓线段与串行 Bresenham 结果一致（后提交的覆盖先提交的）
+TEST_F(RendererSoftTest, LinesMatchSerialBresenham) {
+    createTargets(80, 60);
+    const glm::vec2 endpoints[][2] = {
+        {{1.3f, 2.3f}, {78.3f, 57.3f}},
+        {{75.3f, 3.3f}, {4.3f, 50.3f}},
+        {{40.3f, 0.3f}, {45.3f, 59.3f}},
+        {{0.3f, 31.3f}, {79.3f, 28.3f}},
+        {{60.3f, 40.3f}, {10.3f, 41.3f}},
+        {{20.3f, 20.3f}, {20.3f, 20.3f}},
+        {{33.3f, 10.3f}, {33.3f, 45.3f}},
+    };
+
+    std::vector<TestVertex> vertexes;
+    std::vector<int32_t> indices;
+    std::vector<RGBA> expected(width * height, RGBA(0, 0, 0, 0));
+    int lineIdx = 0;
+    for (auto &line : endpoints) {
+        lineIdx++;
+        glm::vec4 color((float) lineIdx / 8.f, 1.f - (float) lineIdx / 8.f, 0.5f, 1.f);
+        for (auto &p : line) {
+            indices.push_back((int32_t) vertexes.size());
+            vertexes.push_back({{p.x / 40.f - 1.f, p.y / 30.f - 1.f, 0.f}, color});
+        }
+
+        // 串行参考：与原实现相同的 Bresenham
+        int x0 = (int) line[0].x, y0 = (int) line[0].y;
+        int x1 = (int) line[1].x, y1 = (int) line[1].y;
+        bool steep = std::abs(x0 - x1) < std::abs(y0 - y1);
+        if (steep) {
+            std::swap(x0, y0);
+            std::swap(x1, y1);
+        }
+        if (x0 > x1) {
+            std::swap(x0, x1);
+            std::swap(y0, y1);
+        }
+        int dx = x1 - x0, dy = y1 - y0, error = 0, y = y0;
+        RGBA rgba(color * 255.f);
+        for (int x = x0; x <= x1; x++) {
+            int px = steep ? y : x;
+            int py = steep ? x : y;
+            expected[py * width + px] = rgba;
+            error += 2 * std::abs(dy);
+            if (error > dx) {
+                y += (y1 > y0 ? 1 : -1);
+                error -= 2 * dx;
+            }
+        }
+    }
+
+    RenderStates rs;
+    rs.primitiveType = Primitive_LINE;
+    beginPass();
+    draw(vertexes, indices, rs);
+    endPass();
+
+    auto result = snapshot();
+    for (int i = 0; i < width * height; i++) {
+        ASSERT_TRUE(colorNear(result[i], expected[i])) << "x=" << i % width << " y=" << i / width;
+    }
+}
+
+// 测试线框模式：两个三角形的公共边只绘制一次（加法混合下不会叠加两次）
+TEST_F(RendererSoftTest, WireframeDrawsSharedEdgeOnce) {
+    createTargets(80, 60);
+    std::vector<TestVertex> vertexes;
+    std::vector<int32_t> indices;
+    appendQuad(vertexes, indices, {-0.8f, -0.8f}, {0.8f, 0.8f}, 0.f, glm::vec4(0.25f, 0.25f, 0.25f, 1.f));
+
+    RenderStates rs;
+    rs.polygonMode = PolygonMode::LINE;
+    rs.blend = true;
+    rs.blendParams.setBlendFactor(BlendFactor::ONE, BlendFactor::ONE);
+    beginPass();
+    draw(vertexes, indices, rs);
+    endPass();
+
+    // 对角线与四条外边都被绘制，除顶点（相邻边的端点）外没有像素被叠加
+    int litCnt = 0;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            RGBA c = pixel(x, y);
+            if (c.r == 0) {
+                continue;
+            }
+            litCnt++;
+            bool corner = (x == 8 || x == 72) && (y == 6 || y == 54);
+            EXPECT_LE(c.r, corner ? 192 : 64) << "x=" << x << " y=" << y;
+        }
+    }
+    // 外框 + 对角线
+    EXPECT_GT(litCnt, 2 * 64 + 2 * 48 + 40);
+    EXPECT_GT(pixel(40, 30).r, 0);
+}
+
+// 测试多重采样在 pass 结束时统一 resolve：结果为各采样的整数平均，且只 resolve 被写入的 tile
+TEST_F(RendererSoftTest, MultiSampleResolveDirtyTiles) {
+    createTargets(80, 60, true);
+    auto *tex = dynamic_cast<TextureSoft<RGBA> *>(colorTex.get());
+    auto image = tex->getImage().getBuffer();
+
+    std::vector<TestVertex> vertexes;
+    std::vector<int32_t> indices;
+    appendSlopedTriangles(vertexes, indices, 16);
+    RenderStates rs;
+    rs.depthTest = true;
+    rs.blend = true;
+    rs.blendParams.setBlendFactor(BlendFactor::SRC_ALPHA, BlendFactor::ONE_MINUS_SRC_ALPHA);
+    for (auto &vertex : vertexes) {
+        vertex.color.a = 0.6f;
+    }
+
+    beginPass(glm::vec4(0.1f, 0.2f, 0.3f, 1.f));
+    draw(vertexes, indices, rs);
+    draw(vertexes, indices, rs);
+    endPass();
+
+    auto checkResolved = [&](int x, int y) {
+      glm::ivec4 sum(0);
+      for (int i = 0; i < 4; i++) {
+          sum += glm::ivec4(image->getSample(x, y, i));
+      }
+      RGBA expected(sum / 4);
+      RGBA c = pixel(x, y);
+      ASSERT_EQ(glm::ivec4(c), glm::ivec4(expected)) << "x=" << x << " y=" << y;
+    };
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            checkResolved(x, y);
+        }
+    }
+
+    // 不清屏，只在左下角 tile 内绘制，其它 tile 的 resolve 结果保持不变
+    const RGBA marker(1, 2, 3, 4);
+    *image->buffer->get(70, 50) = marker;
+    std::vector<TestVertex> small;
+    std::vector<int32_t> smallIndices;
+    appendQuad(small, smallIndices, {-0.9f, -0.9f}, {-0.5f, -0.5f}, 0.f, glm::vec4(1.f, 0.f, 0.f, 1.f));
+
+    ClearStates clearStates{};
+    renderer->beginRenderPass(fbo, clearStates);
+    renderer->setViewPort(0, 0, width, height);
+    draw(small, smallIndices, rs);
+    endPass();
+
+    EXPECT_EQ(glm::ivec4(pixel(70, 50)), glm::ivec4(marker));
+    for (int y = 0; y < 32; y++) {
+        for (int x = 0; x < 32; x++) {
+            checkResolved(x, y);
+        }
+    }
+}
+
+// 测试 2x/8x/16x 多重采样：边缘像素按采样点位置覆盖，内部像素以压缩（uniform）形式存储并 resolve
+TEST_F(RendererSoftTest, MultiSampleCountsAndUniformPixels) {
+    for (int sampleCount : {2, 8, 16}) {
+        createTargets(80, 60, true, sampleCount);
+        auto colorImage = dynamic_cast<TextureSoft<RGBA> *>(colorTex.get())->getImage().getBuffer();
+        auto depthImage = dynamic_cast<TextureSoft<float> *>(depthTex.get())->getImage().getBuffer();
+        ASSERT_EQ(colorImage->sampleCnt, sampleCount);
+
+        // 左边缘位于 x = 30.3 像素处
+        std::vector<TestVertex> vertexes;
+        std::vector<int32_t> indices;
+        const float edgeX = 30.3f;
+        appendQuad(vertexes, indices, {edgeX / 40.f - 1.f, -0.5f}, {0.5f, 0.5f}, 0.f, glm::vec4(1.f, 0.f, 0.f, 1.f));
+        RenderStates rs;
+        rs.depthTest = true;
+
+        beginPass(glm::vec4(0.f, 0.f, 1.f, 1.f));
+        draw(vertexes, indices, rs);
+        endPass();
+
+        // 内部与外部像素保持压缩
+        EXPECT_TRUE(colorImage->isUniform(50, 30)) << "sampleCount=" << sampleCount;
+        EXPECT_TRUE(depthImage->isUniform(50, 30)) << "sampleCount=" << sampleCount;
+        EXPECT_TRUE(colorImage->isUniform(10, 30)) << "sampleCount=" << sampleCount;
+        EXPECT_EQ(glm::ivec4(pixel(50, 30)), glm::ivec4(255, 0, 0, 255));
+        EXPECT_EQ(glm::ivec4(pixel(10, 30)), glm::ivec4(0, 0, 255, 255));
+
+        // 边缘像素：被覆盖的采样数与采样点位置一致（吸附到 1/16 网格，允许落在边上的采样点）
+        const float snappedX = std::floor(edgeX * 16.f + 0.5f) / 16.f - 30.f;
+        glm::vec2 *location = PixelContext::GetSampleLocation(sampleCount);
+        int strictCnt = 0;
+        int inclusiveCnt = 0;
+        for (int i = 0; i < sampleCount; i++) {
+            strictCnt += location[i].x > snappedX;
+            inclusiveCnt += location[i].x >= snappedX;
+        }
+        int coveredCnt = 0;
+        glm::ivec4 sum(0);
+        for (int i = 0; i < sampleCount; i++) {
+            RGBA sample = colorImage->getSample(30, 30, i);
+            coveredCnt += sample.r == 255;
+            sum += glm::ivec4(sample);
+        }
+        EXPECT_FALSE(colorImage->isUniform(30, 30));
+        EXPECT_TRUE(coveredCnt == strictCnt || coveredCnt == inclusiveCnt) << "sampleCount=" << sampleCount << " covered=" << coveredCnt;
+        EXPECT_EQ(glm::ivec4(pixel(30, 30)), sum / sampleCount) << "sampleCount=" << sampleCount;
+        EXPECT_GT(pixel(30, 30).r, 0);
+        EXPECT_GT(pixel(30, 30).b, 0);
+    }
+}
+
+// 测试按管线状态特化的 output merger 内核与通用深度测试、混合公式结果一致
+TEST_F(RendererSoftTest, OutputMergerKernelsMatchReference) {
+    std::vector<BlendParameters> blendSetups(4);
+    blendSetups[0].setBlendFactor(BlendFactor::SRC_ALPHA, BlendFactor::ONE_MINUS_SRC_ALPHA);
+    blendSetups[1].setBlendFactor(BlendFactor::ONE, BlendFactor::ONE);
+    blendSetups[2].setBlendFactor(BlendFactor::DST_COLOR, BlendFactor::ONE_MINUS_DST_ALPHA);
+    blendSetups[2].setBlendFunction(BlendFunction::REVERSE_SUBTRACT);
+    blendSetups[3].Src_Alpha = BlendFactor::ZERO;
+
+    const glm::vec4 src(0.8f, 0.3f, 0.6f, 0.7f);
+    const RGBA dst(40, 200, 120, 180);
+    const float storedDepth = 0.5f;
+    for (int sampleCount : {1, 4}) {
+        for (int func = LESS; func <= NEVER; func++) {
+            for (bool depthMask : {false, true}) {
+                for (bool blend : {false, true}) {
+                    for (auto &params : blendSetups) {
+                        RenderStates rs;
+                        rs.depthTest = true;
+                        rs.depthFunc = (DepthFunction) func;
+                        rs.depthMask = depthMask;
+                        rs.blend = blend;
+                        rs.blendParams = params;
+                        auto states = std::dynamic_pointer_cast<PipelineStatesSoft>(renderer->createPipelineStates(rs));
+                        ASSERT_NE(states, nullptr);
+                        OutputMergerFunc kernel = states->getOutputMerger(sampleCount).pixel;
+                        ASSERT_EQ(kernel, selectOutputMerger(rs, sampleCount).pixel);
+
+                        ImageBufferSoft<RGBA> color(2, 2, sampleCount);
+                        ImageBufferSoft<float> depth(2, 2, sampleCount);
+                        if (sampleCount > 1) {
+                            color.clearSamples(dst);
+                            depth.clearSamples(storedDepth);
+                        } else {
+                            color.buffer->setAll(dst);
+                            depth.buffer->setAll(storedDepth);
+                        }
+                        OutputMergerContext ctx;
+                        ctx.color = &color;
+                        ctx.depth = &depth;
+                        ctx.blendParams = &rs.blendParams;
+
+                        // 每个采样深度不同，部分采样通过
+                        float z[4] = {0.25f, 0.5f, 0.75f, 0.4f};
+                        kernel(ctx, 1, 1, z, (1u << sampleCount) - 1, src);
+
+                        for (int i = 0; i < sampleCount; i++) {
+                            float a = z[i];
+                            float b = storedDepth;
+                            bool pass = DepthTest(a, b, rs.depthFunc);
+                            glm::vec4 srcColor = src;
+                            glm::vec4 dstColor = glm::vec4(dst) / 255.f;
+                            glm::vec4 blended = blend ? glm::clamp(calcBlendColor(srcColor, dstColor, params), 0.f, 1.f) : src;
+                            RGBA expectedColor = pass ? RGBA(blended * 255.f) : dst;
+                            float expectedDepth = pass && depthMask ? z[i] : storedDepth;
+
+                            RGBA c = sampleCount > 1 ? color.getSample(1, 1, i) : *color.buffer->get(1, 1);
+                            float d = sampleCount > 1 ? depth.getSample(1, 1, i) : *depth.buffer->get(1, 1);
+                            ASSERT_TRUE(glm::all(glm::lessThanEqual(glm::abs(glm::ivec4(c) - glm::ivec4(expectedColor)), glm::ivec4(1))))
+                                << "func=" << func << " blend=" << blend << " sample=" << i;
+                            ASSERT_EQ(d, expectedDepth) << "func=" << func << " depthMask=" << depthMask << " sample=" << i;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// 测试 SIMD quad output merger 与逐像素内核结果一致（含部分覆盖、uniform 像素与边界 quad）
+TEST_F(RendererSoftTest, QuadOutputMergerMatchesPixelKernel) {
+    uint32_t seed = 11;
+    auto random = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return (float) (seed >> 8) / (float) (1 << 24);
+    };
+
+    std::vector<BlendParameters> blendSetups(3);
+    blendSetups[0].setBlendFactor(BlendFactor::SRC_ALPHA, BlendFactor::ONE_MINUS_SRC_ALPHA);
+    blendSetups[1].setBlendFactor(BlendFactor::ONE, BlendFactor::ONE);
+    blendSetups[2].setBlendFactor(BlendFactor::ONE, BlendFactor::ONE_MINUS_SRC_ALPHA);
+
+    const int size = 5;
+    for (int sampleCount : {1, 2, 4, 8, 16}) {
+        for (int func : {LESS, GEQUAL, ALWAYS}) {
+            for (bool depthMask : {false, true}) {
+                for (int blendIdx = -1; blendIdx < (int) blendSetups.size(); blendIdx++) {
+                    RenderStates rs;
+                    rs.depthTest = true;
+                    rs.depthFunc = (DepthFunction) func;
+                    rs.depthMask = depthMask;
+                    rs.blend = blendIdx >= 0;
+                    if (rs.blend) {
+                        rs.blendParams = blendSetups[blendIdx];
+                    }
+                    OutputMergerKernels kernels = selectOutputMerger(rs, sampleCount);
+
+                    ImageBufferSoft<RGBA> color[2] = {{size, size, sampleCount}, {size, size, sampleCount}};
+                    ImageBufferSoft<float> depth[2] = {{size, size, sampleCount}, {size, size, sampleCount}};
+                    OutputMergerContext ctx[2];
+                    for (int k = 0; k < 2; k++) {
+                        // 一半像素为 uniform，其余像素各采样取随机值
+                        uint32_t fill = seed;
+                        for (int y = 0; y < size; y++) {
+                            for (int x = 0; x < size; x++) {
+                                for (int i = 0; i < sampleCount; i++) {
+                                    RGBA c(random() * 255.f, random() * 255.f, random() * 255.f, random() * 255.f);
+                                    float d = random();
+                                    if (sampleCount == 1) {
+                                        *color[k].buffer->get(x, y) = c;
+                                        *depth[k].buffer->get(x, y) = d;
+                                    } else if ((x + y) % 2 == 0) {
+                                        color[k].setUniform(x, y, c);
+                                        depth[k].setUniform(x, y, d);
+                                    } else {
+                                        *color[k].getSampleForWrite(x, y, i) = c;
+                                        *depth[k].getSampleForWrite(x, y, i) = d;
+                                    }
+                                }
+                            }
+                        }
+                        if (k == 0) {
+                            seed = fill;
+                        }
+                        ctx[k].color = &color[k];
+                        ctx[k].depth = &depth[k];
+                        ctx[k].blendParams = &rs.blendParams;
+                        ctx[k].linear = true;
+                    }
+
+                    // 内部 quad 与越过右下边界的 quad
+                    for (glm::ivec2 origin : {glm::ivec2(2, 0), glm::ivec2(0, 2), glm::ivec2(4, 4)}) {
+                        float z[64];
+                        glm::vec4 src[4];
+                        uint64_t laneMask = 0;
+                        for (int i = 0; i < 4 * sampleCount; i++) {
+                            z[i] = random();
+                            laneMask |= (uint64_t) (random() < 0.8f) << i;
+                        }
+                        // 第一个像素全覆盖且深度相同
+                        for (int i = 0; i < sampleCount; i++) {
+                            z[i] = 0.01f;
+                            laneMask |= 1ull << i;
+                        }
+                        for (auto &c : src) {
+                            c = glm::vec4(random(), random(), random(), random());
+                        }
+
+                        kernels.quad(ctx[0], origin.x, origin.y, z, laneMask, src);
+                        for (int p = 0; p < 4; p++) {
+                            int x = origin.x + (p & 1);
+                            int y = origin.y + (p >> 1);
+                            uint32_t sampleMask = (uint32_t) (laneMask >> (p * sampleCount)) & ((1u << sampleCount) - 1);
+                            if (sampleMask && x < size && y < size) {
+                                kernels.pixel(ctx[1], x, y, z + p * sampleCount, sampleMask, src[p]);
+                            }
+                        }
+                    }
+
+                    for (int y = 0; y < size; y++) {
+                        for (int x = 0; x < size; x++) {
+                            if (sampleCount > 1) {
+                                ASSERT_EQ(color[0].isUniform(x, y), color[1].isUniform(x, y)) << "x=" << x << " y=" << y;
+                                ASSERT_EQ(depth[0].isUniform(x, y), depth[1].isUniform(x, y)) << "x=" << x << " y=" << y;
+                            }
+                            for (int i = 0; i < sampleCount; i++) {
+                                RGBA c0 = sampleCount > 1 ? color[0].getSample(x, y, i) : *color[0].buffer->get(x, y);
+                                RGBA c1 = sampleCount > 1 ? color[1].getSample(x, y, i) : *color[1].buffer->get(x, y);
+                                float d0 = sampleCount > 1 ? depth[0].getSample(x, y, i) : *depth[0].buffer->get(x, y);
+                                float d1 = sampleCount > 1 ? depth[1].getSample(x, y, i) : *depth[1].buffer->get(x, y);
+                                ASSERT_TRUE(glm::all(glm::lessThanEqual(glm::abs(glm::ivec4(c0) - glm::ivec4(c1)), glm::ivec4(1))))
+                                    << "samples=" << sampleCount << " func=" << func << " blend=" << blendIdx << " x=" << x << " y=" << y;
+                                ASSERT_EQ(d0, d1) << "samples=" << sampleCount << " x=" << x << " y=" << y << " sample=" << i;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+// 测试延迟清屏：只有绘制触及的 tile 才写入清屏值，其它 tile 直接以清屏值 resolve/输出
+TEST_F(RendererSoftTest, LazyClearMaterializesTouchedTiles) {
+    for (bool multiSample : {false, true}) {
+        createTargets(80, 60, multiSample);
+        auto colorImage = dynamic_cast<TextureSoft<RGBA> *>(colorTex.get())->getImage().getBuffer();
+        auto depthImage = dynamic_cast<TextureSoft<float> *>(depthTex.get())->getImage().getBuffer();
+        const RGBA clearColor(51, 102, 153, 255);
+        const RGBA red(255, 0, 0, 255);
+        const RGBA blue(0, 0, 255, 255);
+
+        RenderStates rs;
+        rs.depthTest = true;
+        std::vector<TestVertex> vertexes;
+        std::vector<int32_t> indices;
+        appendQuad(vertexes, indices, {-0.9f, -0.9f}, {-0.5f, -0.5f}, 0.f, glm::vec4(1.f, 0.f, 0.f, 1.f));
+
+        beginPass(glm::vec4(0.2f, 0.4f, 0.6f, 1.f));
+        draw(vertexes, indices, rs);
+        EXPECT_FALSE(colorImage->isClearPending(10, 10));
+        EXPECT_TRUE(colorImage->isClearPending(70, 50));
+        EXPECT_TRUE(depthImage->isClearPending(70, 50));
+        endPass();
+
+        // pass 结束后未触及的 tile 仍保持待清状态，读取时才写入
+        EXPECT_TRUE(colorImage->isClearPending(70, 50));
+        EXPECT_TRUE(depthImage->isClearPending(70, 50));
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                bool inside = x >= 4 && x < 20 && y >= 3 && y < 15;
+                bool edge = x >= 3 && x <= 20 && y >= 2 && y <= 15;
+                if (inside) {
+                    ASSERT_TRUE(colorNear(pixel(x, y), red)) << "x=" << x << " y=" << y;
+                } else if (!edge) {
+                    ASSERT_EQ(glm::ivec4(pixel(x, y)), glm::ivec4(clearColor)) << "x=" << x << " y=" << y;
+                }
+            }
+        }
+        if (multiSample) {
+            EXPECT_TRUE(colorImage->isClearPending(70, 50));
+            EXPECT_EQ(glm::ivec4(colorImage->getSample(70, 50, 3)), glm::ivec4(clearColor));
+            EXPECT_EQ(depthImage->getSample(70, 50, 1), 1.f);
+        } else {
+            EXPECT_FALSE(colorImage->clearPending);
+            EXPECT_TRUE(depthImage->isClearPending(70, 50));
+            auto depthRead = dynamic_cast<TextureSoft<float> *>(depthTex.get())->getImage().getBuffer();
+            EXPECT_FALSE(depthImage->clearPending);
+            EXPECT_EQ(*depthRead->buffer->get(70, 50), 1.f);
+        }
+
+        // 不清颜色、深度延迟清为 0.5：未触及 tile 中的深度测试使用清屏值，颜色保留上一 pass 的内容
+        std::vector<TestVertex> far;
+        std::vector<int32_t> farIndices;
+        appendQuad(far, farIndices, {0.5f, 0.5f}, {0.9f, 0.9f}, 0.9f, glm::vec4(0.f, 1.f, 0.f, 1.f));
+        std::vector<TestVertex> near;
+        std::vector<int32_t> nearIndices;
+        appendQuad(near, nearIndices, {-0.2f, 0.5f}, {0.2f, 0.9f}, 0.2f, glm::vec4(0.f, 0.f, 1.f, 1.f));
+
+        ClearStates clearStates{};
+        clearStates.depthFlag = true;
+        clearStates.clearDepth = 0.5f;
+        renderer->beginRenderPass(fbo, clearStates);
+        renderer->setViewPort(0, 0, width, height);
+        draw(far, farIndices, rs);
+        draw(near, nearIndices, rs);
+        endPass();
+
+        EXPECT_EQ(glm::ivec4(pixel(70, 50)), glm::ivec4(clearColor));
+        EXPECT_EQ(glm::ivec4(pixel(70, 40)), glm::ivec4(clearColor));
+        EXPECT_TRUE(colorNear(pixel(40, 50), blue));
+        EXPECT_TRUE(colorNear(pixel(10, 10), red));
+        EXPECT_EQ(glm::ivec4(pixel(10, 40)), glm::ivec4(clearColor));
+    }
+}
+
+// 测试命令列表模式：录制后在提交线程回放，结果与立即执行一致，uniform 在录制时被拷贝
+TEST_F(RendererSoftTest, CommandListMatchesImmediate) {
+    createTargets(96, 64);
+    std::vector<TestVertex> vertexes;
+    std::vector<int32_t> indices;
+    appendSlopedTriangles(vertexes, indices, 12);
+    RenderStates rs;
+    rs.depthTest = true;
+
+    auto renderFrame = [&]() {
+        beginPass(glm::vec4(0.1f, 0.2f, 0.3f, 1.f));
+        for (int i = 0; i < 3; i++) {
+            glm::mat4 mvp = glm::translate(glm::mat4(1.f), glm::vec3(0.2f * (float) i - 0.2f, 0.f, 0.f));
+            uniformBlock->setData(&mvp, sizeof(glm::mat4));
+            draw(vertexes, indices, rs);
+        }
+        endPass();
+    };
+
+    renderFrame();
+    auto expected = snapshot();
+
+    renderer->setEnableCommandList(true);
+    for (int frame = 0; frame < 3; frame++) {
+        renderFrame();
+        renderer->present(colorTex);
+    }
+    renderer->waitIdle();
+    EXPECT_EQ(snapshot(), expected);
+
+    auto presented = renderer->acquirePresentBuffer();
+    ASSERT_NE(presented, nullptr);
+    EXPECT_TRUE(std::equal(expected.begin(), expected.end(), presented->getRawDataPtr()));
+
+    // 交换链显示最近完成的一帧
+    beginPass(glm::vec4(1.f, 0.f, 0.f, 1.f));
+    endPass();
+    renderer->present(colorTex);
+    beginPass(glm::vec4(0.f, 1.f, 0.f, 1.f));
+    endPass();
+    renderer->present(colorTex);
+    renderer->waitIdle();
+    presented = renderer->acquirePresentBuffer();
+    EXPECT_EQ(glm::ivec4(*presented->get(5, 5)), glm::ivec4(0, 255, 0, 255));
+
+    renderer->setEnableCommandList(false);
+    renderFrame();
+    EXPECT_EQ(snapshot(), expected);
+}
+
+// 测试交替切换着色器程序时复用每线程克隆：结果与单一程序一致，稳定后不再分配
+TEST_F(RendererSoftTest, ProgramSwitchReusesThreadClones) {
+    createTargets(96, 64);
+    auto programB = renderer->createShaderProgram();
+    dynamic_cast<ShaderProgramSoft *>(programB.get())
+        ->SetShaders(std::make_shared<ShaderTestColor::VS>(), std::make_shared<ShaderTestColor::FS>());
+
+    std::vector<std::shared_ptr<VertexArrayObject>> vaos;
+    std::vector<std::vector<TestVertex>> vertexes(8);
+    std::vector<std::vector<int32_t>> indices(8);
+    for (int i = 0; i < 8; i++) {
+        glm::vec2 min(-0.9f + (float) i * 0.2f, -0.8f + (float) (i % 3) * 0.3f);
+        appendQuad(vertexes[i], indices[i], min, min + glm::vec2(0.5f), 0.9f - (float) i * 0.1f,
+                   {(float) (i % 2), (float) i / 8.f, 1.f - (float) i / 8.f, 1.f});
+        vaos.push_back(createVao(vertexes[i], indices[i]));
+    }
+    RenderStates rs;
+    rs.depthTest = true;
+    auto states = renderer->createPipelineStates(rs);
+
+    auto renderFrame = [&](bool alternate, size_t *allocCnt) {
+        beginPass();
+        renderer->setPipelineStates(states);
+        size_t cnt = heapAllocCnt;
+        for (int i = 0; i < 8; i++) {
+            renderer->setShaderProgram(alternate && (i % 2) ? programB : program);
+            renderer->setShaderResources(resources);
+            renderer->setVertexArrayObject(vaos[i]);
+            renderer->draw();
+        }
+        if (allocCnt) {
+            *allocCnt = heapAllocCnt - cnt;
+        }
+        endPass();
+        return snapshot();
+    };
+
+    auto reference = renderFrame(false, nullptr);
+    renderFrame(true, nullptr);
+    size_t allocCnt = 0;
+    auto alternated = renderFrame(true, &allocCnt);
+    EXPECT_EQ(allocCnt, 0);
+    ASSERT_EQ(reference.size(), alternated.size());
+    for (size_t i = 0; i < reference.size(); i++) {
+        ASSERT_TRUE(colorNear(reference[i], alternated[i])) << "pixel " << i;
+    }
+}
+
+// 测试 uniform 版本号：未变化的块不重复拷贝，setData 与替换资源中的块都会重新绑定，命令列表与立即模式一致
+TEST_F(RendererSoftTest, UniformVersionsRebindChangedBlocks) {
+    createTargets(96, 64);
+    auto *programSoft = dynamic_cast<ShaderProgramSoft *>(program.get());
+    auto *blockSoft = dynamic_cast<UniformBlockSoft *>(uniformBlock.get());
+    auto &data = blockSoft->getBuffer();
+    EXPECT_TRUE(programSoft->bindUniformBlockBuffer((void *) data.data(), data.size(), 0,
+                                                    blockSoft->getHash(), blockSoft->getVersion()));
+    EXPECT_FALSE(programSoft->bindUniformBlockBuffer((void *) data.data(), data.size(), 0,
+                                                     blockSoft->getHash(), blockSoft->getVersion()));
+    programSoft->bindUniformBlockBuffer((void *) data.data(), data.size(), 0);
+    EXPECT_TRUE(programSoft->bindUniformBlockBuffer((void *) data.data(), data.size(), 0,
+                                                    blockSoft->getHash(), blockSoft->getVersion()));
+
+    std::vector<TestVertex> vertexes;
+    std::vector<int32_t> indices;
+    appendSlopedTriangles(vertexes, indices, 12);
+    RenderStates rs;
+    rs.depthTest = true;
+
+    auto otherBlock = renderer->createUniformBlock("UniformsTest", sizeof(glm::mat4));
+    glm::mat4 otherMvp = glm::translate(glm::mat4(1.f), glm::vec3(0.f, 0.3f, 0.f));
+    otherBlock->setData(&otherMvp, sizeof(glm::mat4));
+
+    // freshResources 为 true 时每次绘制使用新的资源对象，作为不走缓存绑定表的参照
+    auto renderFrame = [&](bool freshResources) {
+        beginPass(glm::vec4(0.1f, 0.2f, 0.3f, 1.f));
+        for (int i = 0; i < 4; i++) {
+            glm::mat4 mvp = glm::translate(glm::mat4(1.f), glm::vec3(0.2f * (float) i - 0.3f, 0.f, 0.f));
+            if (i != 2) {
+                uniformBlock->setData(&mvp, sizeof(glm::mat4));
+            }
+            auto block = (i == 1) ? otherBlock : uniformBlock;
+            if (freshResources) {
+                resources = std::make_shared<ShaderResources>();
+            }
+            resources->blocks[0] = block;
+            draw(vertexes, indices, rs);
+            draw(vertexes, indices, rs);
+        }
+        endPass();
+        return snapshot();
+    };
+
+    auto expected = renderFrame(true);
+    EXPECT_EQ(renderFrame(false), expected);
+    EXPECT_EQ(renderFrame(false), expected);
+
+    renderer->setEnableCommandList(true);
+    for (int frame = 0; frame < 2; frame++) {
+        EXPECT_EQ(renderFrame(false), expected);
+    }
+    renderer->setEnableCommandList(false);
+    EXPECT_EQ(renderFrame(false), expected);
+}
+
+// 测试可见性缓冲：待着色的绘制之间切换采样器的纹理，先前的绘制仍使用切换前的纹理
+TEST_F(RendererSoftTest, VisibilityBufferSamplerRetarget) {
+    createTargets(64, 64);
+    program = renderer->createShaderProgram();
+    dynamic_cast<ShaderProgramSoft *>(program.get())
+        ->SetShaders(std::make_shared<ShaderTestTexture::VS>(), std::make_shared<ShaderTestTexture::FS>());
+
+    auto createTexture = [&](const RGBA &color) {
+        TextureDesc desc;
+        desc.width = 1;
+        desc.height = 1;
+        auto tex = renderer->createTexture(desc);
+        tex->initImageData();
+        *dynamic_cast<TextureSoft<RGBA> *>(tex.get())->getImage().getBuffer()->buffer->get(0, 0) = color;
+        return tex;
+    };
+    auto red = createTexture(RGBA(255, 0, 0, 255));
+    auto green = createTexture(RGBA(0, 255, 0, 255));
+    TextureDesc samplerDesc;
+    auto sampler = renderer->createUniformSampler("u_tex", samplerDesc);
+    resources->samplers[0] = sampler;
+
+    RenderStates rs;
+    rs.depthTest = true;
+    auto renderScene = [&](bool visibility) {
+        renderer->setEnableVisibilityBuffer(visibility);
+        beginPass();
+        for (int i = 0; i < 2; i++) {
+            std::vector<TestVertex> vertexes;
+            std::vector<int32_t> indices;
+            float x = -0.9f + (float) i;
+            appendQuad(vertexes, indices, {x, -0.5f}, {x + 0.8f, 0.5f}, 0.5f, glm::vec4(1.f));
+            sampler->setTexture(i == 0 ? red : green);
+            draw(vertexes, indices, rs);
+        }
+        endPass();
+        return snapshot();
+    };
+
+    auto forward = renderScene(false);
+    EXPECT_EQ(glm::ivec4(forward[32 * width + 16]), glm::ivec4(255, 0, 0, 255));
+    EXPECT_EQ(glm::ivec4(forward[32 * width + 48]), glm::ivec4(0, 255, 0, 255));
+    EXPECT_EQ(renderScene(true), forward);
+
+    renderer->setEnableCommandList(true);
+    EXPECT_EQ(renderScene(true), forward);
+    EXPECT_EQ(renderScene(true), forward);
+    renderer->setEnableCommandList(false);
+}
+
+// 测试延迟清屏跨 pass 保留：未被绘制触及的 tile 从不写入，present 与读取时使用清屏值
+TEST_F(RendererSoftTest, UntouchedTilesAreNeverWritten) {
+    createTargets(80, 60);
+    auto *tex = dynamic_cast<TextureSoft<RGBA> *>(colorTex.get());
+    auto colorImage = tex->getImage().getAttachmentBuffer();
+    const RGBA sentinel(1, 2, 3, 4);
+    const RGBA clearColor(51, 102, 153, 255);
+    auto &raw = colorImage->buffer;
+    std::fill(raw->getRawDataPtr(), raw->getRawDataPtr() + raw->getRawDataSize(), sentinel);
+
+    RenderStates rs;
+    rs.depthTest = true;
+    std::vector<TestVertex> vertexes;
+    std::vector<int32_t> indices;
+    appendQuad(vertexes, indices, {-0.9f, -0.9f}, {-0.5f, -0.5f}, 0.f, glm::vec4(1.f, 0.f, 0.f, 1.f));
+
+    for (int frame = 0; frame < 2; frame++) {
+        beginPass(glm::vec4(0.2f, 0.4f, 0.6f, 1.f));
+        draw(vertexes, indices, rs);
+        endPass();
+        renderer->present(colorTex);
+        renderer->waitIdle();
+
+        EXPECT_TRUE(colorImage->isClearPending(70, 50));
+        EXPECT_EQ(glm::ivec4(*raw->get(70, 50)), glm::ivec4(sentinel));
+        EXPECT_TRUE(colorNear(*raw->get(10, 10), RGBA(255, 0, 0, 255)));
+
+        auto presented = renderer->acquirePresentBuffer();
+        ASSERT_NE(presented, nullptr);
+        EXPECT_EQ(glm::ivec4(*presented->get(70, 50)), glm::ivec4(clearColor));
+        EXPECT_TRUE(colorNear(*presented->get(10, 10), RGBA(255, 0, 0, 255)));
+    }
+
+    // 读取纹理时才写入待清 tile
+    EXPECT_EQ(glm::ivec4(pixel(70, 50)), glm::ivec4(clearColor));
+    EXPECT_FALSE(colorImage->clearPending);
+}
+}
+}
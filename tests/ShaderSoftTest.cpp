@@ -0,0 +1,201 @@
+#include <gtest/gtest.h>
+#include "Render/Soft/RendererSoft.h"
+#include "Render/Soft/TextureSoft.h"
+#include "Viewer/Shader/Software/ShaderSoft.h"
+
+using namespace Learn;
+
+// 批量（SoA）片元着色与逐像素标量着色的结果应一致
+class ShaderSoftTest : public ::testing::Test {
+protected:
+    template <typename VS, typename FS, typename Uniforms>
+    void createProgram(const Uniforms &uniforms, const std::vector<std::string> &defines = {}) {
+        program = std::make_shared<ShaderProgramSoft>();
+        for (auto &def : defines) {
+            program->addDefine(def);
+        }
+        program->SetShaders(std::make_shared<VS>(), std::make_shared<FS>());
+        program->bindUniformBlockBuffer((void *) &uniforms, sizeof(Uniforms), 0);
+        program->prepareFragmentShader();
+
+        varyingsAlignedCnt = AlignedMemory::getAlignedSize(program->getShaderVaryingsSize()) / sizeof(float);
+        varyingsCnt = program->getShaderVaryingsSize() / sizeof(float);
+        pool = AlignedMemory::makeAlignedBuffer<float>(8 * varyingsAlignedCnt);
+        memset(pool.get(), 0, 8 * varyingsAlignedCnt * sizeof(float));
+        for (int i = 0; i < BatchLanes; i++) {
+            batch.laneVaryings[i] = pool.get() + i * varyingsAlignedCnt;
+        }
+        batch.varyings = pool.get() + 4 * varyingsAlignedCnt;
+
+        DerivativeContext &dfCtx = program->getShaderBuiltin().dfCtx;
+        dfCtx.p0 = batch.laneVaryings[0];
+        dfCtx.p1 = batch.laneVaryings[1];
+        dfCtx.p2 = batch.laneVaryings[2];
+        dfCtx.p3 = batch.laneVaryings[3];
+    }
+
+    template <typename Varyings>
+    Varyings &laneVaryings(int lane) {
+        return *reinterpret_cast<Varyings *>(batch.laneVaryings[lane]);
+    }
+
+    // 逐 lane 运行标量入口，再运行一次批量入口，比较输出
+    void expectBatchMatchesScalar(int mask = BatchLaneMask, float tolerance = 1e-4f) {
+        ASSERT_TRUE(program->hasFragmentShaderBatch());
+
+        glm::vec4 expected[BatchLanes];
+        auto &builtin = program->getShaderBuiltin();
+        for (int i = 0; i < BatchLanes; i++) {
+            builtin.FragCoord = glm::vec4(i % 2 + 0.5f, i / 2 + 0.5f, 0.5f, 1.f);
+            builtin.FrontFacing = true;
+            program->bindFragmentShaderVaryings(batch.laneVaryings[i]);
+            program->execFragmentShader();
+            expected[i] = builtin.FragColor;
+        }
+
+        batch.mask = mask;
+        batch.frontFacing = true;
+        batch.fragCoord = BatchVec4(BatchFloat::load(fragCoordX), BatchFloat::load(fragCoordY), 0.5f, 1.f);
+        batch.transposeVaryings(varyingsCnt);
+        program->execFragmentShaderBatch(batch);
+
+        for (int i = 0; i < BatchLanes; i++) {
+            if (!((mask >> i) & 1)) {
+                continue;
+            }
+            glm::vec4 color = batch.fragColor.get(i);
+            for (int c = 0; c < 4; c++) {
+                EXPECT_NEAR(color[c], expected[i][c], tolerance) << "lane=" << i << " channel=" << c;
+            }
+        }
+    }
+
+    std::shared_ptr<ShaderProgramSoft> program;
+    std::shared_ptr<float> pool;
+    size_t varyingsCnt = 0;
+    size_t varyingsAlignedCnt = 0;
+    FragmentBatch batch;
+
+    alignas(16) float fragCoordX[BatchLanes] = {0.5f, 1.5f, 0.5f, 1.5f};
+    alignas(16) float fragCoordY[BatchLanes] = {0.5f, 0.5f, 1.5f, 1.5f};
+};
+
+// 测试 SoA 基本运算与标量结果一致
+TEST_F(ShaderSoftTest, BatchMathMatchesScalar) {
+    alignas(16) float a[BatchLanes] = {-2.f, 0.25f, 3.f, 10.f};
+    alignas(16) float b[BatchLanes] = {1.f, 0.5f, -4.f, 10.f};
+    BatchFloat va = BatchFloat::load(a);
+    BatchFloat vb = BatchFloat::load(b);
+
+    BatchFloat sum = va + vb;
+    BatchFloat product = va * vb;
+    BatchFloat quotient = va / vb;
+    BatchFloat clamped = clamp(va, 0.f, 1.f);
+    BatchFloat selected = select(va < vb, va, vb);
+    for (int i = 0; i < BatchLanes; i++) {
+        EXPECT_FLOAT_EQ(sum.get(i), a[i] + b[i]);
+        EXPECT_FLOAT_EQ(product.get(i), a[i] * b[i]);
+        EXPECT_FLOAT_EQ(quotient.get(i), a[i] / b[i]);
+        EXPECT_FLOAT_EQ(clamped.get(i), glm::clamp(a[i], 0.f, 1.f));
+        EXPECT_FLOAT_EQ(selected.get(i), a[i] < b[i] ? a[i] : b[i]);
+    }
+    EXPECT_EQ((va < vb).bits(), 0b0011);
+    EXPECT_EQ((va >= vb).bits(), 0b1100);
+
+    BatchVec3 v(va, vb, 2.f);
+    BatchVec3 n = normalize(v);
+    BatchVec3 c = cross(v, BatchVec3(glm::vec3(0.f, 0.f, 1.f)));
+    for (int i = 0; i < BatchLanes; i++) {
+        glm::vec3 sv(a[i], b[i], 2.f);
+        glm::vec3 sn = glm::normalize(sv);
+        glm::vec3 sc = glm::cross(sv, glm::vec3(0.f, 0.f, 1.f));
+        for (int k = 0; k < 3; k++) {
+            EXPECT_NEAR(n.get(i)[k], sn[k], 1e-6f);
+            EXPECT_NEAR(c.get(i)[k], sc[k], 1e-6f);
+        }
+    }
+}
+
+// 测试 Blinn-Phong 批量入口（点光源、镜面高光）
+TEST_F(ShaderSoftTest, BlinnPhongBatchMatchesScalar) {
+    using namespace ShaderBlinnPhong;
+    ShaderUniforms uniforms{};
+    uniforms.u_ambientColor = glm::vec3(0.1f, 0.2f, 0.3f);
+    uniforms.u_pointLightColor = glm::vec3(1.f, 0.9f, 0.8f);
+    uniforms.u_enableLight = 1;
+    uniforms.u_kSpecular = 0.5f;
+    uniforms.u_baseColor = glm::vec4(0.8f, 0.6f, 0.4f, 0.7f);
+    createProgram<VS, FS>(uniforms);
+
+    for (int i = 0; i < BatchLanes; i++) {
+        auto &v = laneVaryings<ShaderVaryings>(i);
+        v.v_normalVector = glm::vec3(0.1f * i, 1.f, 0.2f);
+        v.v_lightDirection = glm::vec3(0.5f, 1.f + 0.3f * i, -0.2f);
+        v.v_cameraDirection = glm::vec3(0.3f, 1.2f, 0.1f * i);
+    }
+    expectBatchMatchesScalar();
+    expectBatchMatchesScalar(0b0110);
+}
+
+// 测试 PBR 批量入口（直接光照 + 环境光）
+TEST_F(ShaderSoftTest, PbrBatchMatchesScalar) {
+    using namespace ShaderPbrIBL;
+    ShaderUniforms uniforms{};
+    uniforms.u_ambientColor = glm::vec3(0.2f);
+    uniforms.u_pointLightColor = glm::vec3(2.f, 1.8f, 1.5f);
+    uniforms.u_enableLight = 1;
+    uniforms.u_baseColor = glm::vec4(0.9f, 0.5f, 0.3f, 1.f);
+    createProgram<VS, FS>(uniforms);
+
+    for (int i = 0; i < BatchLanes; i++) {
+        auto &v = laneVaryings<ShaderVaryings>(i);
+        v.v_normalVector = glm::vec3(0.2f, 1.f, 0.1f * i);
+        v.v_lightDirection = glm::vec3(-0.4f * i, 1.f, 0.6f);
+        v.v_cameraDirection = glm::vec3(0.f, 1.f, 1.f - 0.2f * i);
+    }
+    expectBatchMatchesScalar();
+}
+
+// 测试 FXAA 批量入口：平坦区域走 SIMD 路径，边缘像素回退到标量搜索
+TEST_F(ShaderSoftTest, FxaaBatchMatchesScalar) {
+    const int size = 16;
+    RendererSoft renderer;
+    TextureDesc desc;
+    desc.width = size;
+    desc.height = size;
+    desc.format = TextureFormat_RGBA8;
+    desc.usage = TextureUsage_Sampler;
+    auto texture = renderer.createTexture(desc);
+    SamplerDesc samplerDesc;
+    samplerDesc.filterMin = Filter_LINEAR;
+    samplerDesc.filterMag = Filter_LINEAR;
+    texture->setSamplerDesc(samplerDesc);
+
+    // 左半平坦，右半为斜向阶梯边缘
+    auto buffer = Buffer<RGBA>::makeDefault(size, size);
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            uint8_t value = x < size / 2 ? 64 : ((x + y / 2) % 4 < 2 ? 0 : 255);
+            *buffer->get(x, y) = RGBA(value, value, value, 255);
+        }
+    }
+    dynamic_cast<TextureSoft<RGBA> *>(texture.get())->setImageData({buffer});
+
+    std::shared_ptr<SamplerSoft> sampler = std::make_shared<Sampler2DSoft<RGBA>>();
+    sampler->setTexture(texture);
+
+    using namespace ShaderFXAA;
+    ShaderUniforms uniforms{};
+    uniforms.u_screenSize = glm::vec2(size);
+    createProgram<VS, FS>(uniforms);
+    program->bindUniformSampler(sampler, 1);
+
+    // 一个 quad 跨在边缘上，另一个在平坦区域
+    for (float baseX : {10.f, 2.f}) {
+        for (int i = 0; i < BatchLanes; i++) {
+            auto &v = laneVaryings<ShaderVaryings>(i);
+            v.v_texCoord = glm::vec2((baseX + i % 2 + 0.5f) / size, (5.f + i / 2 + 0.5f) / size);
+        }
+        expectBatchMatchesScalar();
+    }
+}
@@ -157,7 +157,7 @@ TEST_F(TextureSoftTest, MultiSampleTexture) {
     
     EXPECT_TRUE(buffer->multiSample);
     EXPECT_EQ(buffer->sampleCnt, SOFT_MS_CNT);
-    EXPECT_NE(buffer->bufferMs4x, nullptr);
+    EXPECT_NE(buffer->bufferMs, nullptr);
 }
 
 // 测试Float32格式纹理
@@ -6,6 +6,7 @@
 #include <vector>
 #include <mutex>
 #include <algorithm>
+#include <array>
 
 using namespace Learn;
 
@@ -29,6 +30,16 @@ TEST_F(ThreadPoolTest, InitializesCorrectThreadCount) {
     ASSERT_EQ(customPool.getThreadCnt(), requestedThreads);
 }
 
+// 测试线程数为 0（hardware_concurrency 未知）时至少保留一个工作线程
+TEST_F(ThreadPoolTest, ZeroThreadCountIsClamped) {
+    ThreadPool customPool(0);
+    ASSERT_EQ(customPool.getThreadCnt(), 1u);
+    std::atomic<int> counter{0};
+    customPool.pushTask([&](size_t) { counter++; });
+    customPool.waitTasksFinish();
+    ASSERT_EQ(counter, 1);
+}
+
 // 测试任务执行（使用正确的签名）
 TEST_F(ThreadPoolTest, ExecutesTasks) {
     std::atomic<int> counter{0};
@@ -187,7 +198,263 @@ TEST_F(ThreadPoolTest, HandlesConcurrentTaskSubmission) {
     ASSERT_EQ(counter, tasksPerThread * threadCount);
 }
 
+// 测试工作线程内提交的子任务进入本地队列并可被其它线程窃取，任务组等待会协助执行
+TEST_F(ThreadPoolTest, NestedTasksAreStolen) {
+    std::atomic<int> counter{0};
+    std::mutex mutex;
+    std::vector<size_t> threadIds;
+    const int children = 256;
+
+    pool->pushTask([&](size_t) {
+        ThreadPool::TaskGroup group(*pool);
+        for (int i = 0; i < children; ++i) {
+            group.pushTask([&](size_t id) {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                std::lock_guard<std::mutex> lock(mutex);
+                threadIds.push_back(id);
+                counter++;
+            });
+        }
+        group.wait();
+        ASSERT_EQ(counter, children);
+    });
+
+    pool->waitTasksFinish();
+    ASSERT_EQ(counter, children);
+    std::sort(threadIds.begin(), threadIds.end());
+    threadIds.erase(std::unique(threadIds.begin(), threadIds.end()), threadIds.end());
+    if (pool->getThreadCnt() > 1) {
+        ASSERT_GT(threadIds.size(), 1u);
+    }
+}
+
+// 测试空闲工作线程会休眠而不是自旋
+TEST_F(ThreadPoolTest, IdleWorkersPark) {
+    std::atomic<int> counter{0};
+    for (int i = 0; i < 100; ++i) {
+        pool->pushTask([&](size_t) { counter++; });
+    }
+    pool->waitTasksFinish();
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (pool->getParkedCnt() < pool->getThreadCnt() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_EQ(pool->getParkedCnt(), pool->getThreadCnt());
+
+    // 休眠的线程被新任务唤醒
+    pool->pushTask([&](size_t) { counter++; });
+    pool->waitTasksFinish();
+    ASSERT_EQ(counter, 101);
+}
+
+// 测试较大的可调用对象（超出内联存储）能正确执行并释放
+TEST_F(ThreadPoolTest, LargeCallablesAreReleased) {
+    auto shared = std::make_shared<int>(0);
+    std::atomic<int> sum{0};
+    for (int i = 0; i < 50; ++i) {
+        std::array<int, 32> values{};
+        values.fill(i);
+        pool->pushTask([&, shared, values](size_t) { sum += values[31]; });
+    }
+    pool->waitTasksFinish();
+    ASSERT_EQ(sum, 49 * 50 / 2);
+    ASSERT_EQ(shared.use_count(), 1);
+}
+
+// 测试 parallelFor 对区间的每个元素恰好执行一次
+TEST_F(ThreadPoolTest, ParallelForCoversRange) {
+    const size_t count = 10007;
+    for (size_t grain : {0u, 1u, 7u, 20000u}) {
+        std::vector<std::atomic<int>> hits(count);
+        pool->parallelFor(3, count, grain, [&](size_t begin, size_t end, size_t id) {
+            ASSERT_LT(id, pool->getThreadCnt());
+            ASSERT_LE(end, count);
+            if (grain > 0) {
+                ASSERT_LE(end - begin, grain);
+            }
+            for (size_t i = begin; i < end; ++i) {
+                hits[i]++;
+            }
+        });
+        for (size_t i = 0; i < count; ++i) {
+            ASSERT_EQ(hits[i], i < 3 ? 0 : 1);
+        }
+    }
+
+    // 空区间直接返回
+    pool->parallelFor(5, 5, 0, [&](size_t, size_t, size_t) { FAIL(); });
+}
+
+// 测试在任务内部嵌套调用 parallelFor 不会死锁
+TEST_F(ThreadPoolTest, NestedParallelForJoins) {
+    std::atomic<size_t> sum{0};
+    pool->parallelFor(0, 64, 1, [&](size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; ++i) {
+            pool->parallelFor(0, 100, 0, [&](size_t b, size_t e, size_t) {
+                for (size_t j = b; j < e; ++j) {
+                    sum += j;
+                }
+            });
+        }
+    });
+    ASSERT_EQ(sum, 64u * (99u * 100u / 2));
+
+    // 作用域等待只等待自己的任务，被阻塞的线程之外至少还有一个工作线程
+    ThreadPool customPool(4);
+    std::atomic<bool> release{false};
+    customPool.pushTask([&](size_t) {
+        while (!release) {
+            std::this_thread::yield();
+        }
+    });
+    std::atomic<int> counter{0};
+    customPool.parallelFor(0, 32, 1, [&](size_t begin, size_t end, size_t) { counter += (int)(end - begin); });
+    ASSERT_EQ(counter, 32);
+    release = true;
+    customPool.waitTasksFinish();
+}
+
+// 测试二维分块覆盖整个区域且分块不越界
+TEST_F(ThreadPoolTest, ParallelFor2DCoversTiles) {
+    const size_t width = 130, height = 67, tile = 32;
+    std::vector<std::atomic<int>> hits(width * height);
+    pool->parallelFor2D(width, height, tile, tile, [&](size_t x0, size_t y0, size_t x1, size_t y1, size_t) {
+        ASSERT_EQ(x0 % tile, 0u);
+        ASSERT_EQ(y0 % tile, 0u);
+        ASSERT_LE(x1 - x0, tile);
+        ASSERT_LE(y1 - y0, tile);
+        for (size_t y = y0; y < y1; ++y) {
+            for (size_t x = x0; x < x1; ++x) {
+                hits[y * width + x]++;
+            }
+        }
+    });
+    for (auto &hit : hits) {
+        ASSERT_EQ(hit, 1);
+    }
+}
+
+// 测试帧任务优先于后台任务执行，任务继承提交时的优先级
+TEST_F(ThreadPoolTest, FrameLaneRunsFirst) {
+    ThreadPool customPool(1);
+    std::mutex mutex;
+    std::vector<char> order;
+    auto record = [&](char tag, TaskLane lane) {
+        return [&, tag, lane](size_t) {
+            ASSERT_EQ(ThreadPool::currentLane(), lane);
+            std::lock_guard<std::mutex> lock(mutex);
+            order.push_back(tag);
+        };
+    };
+
+    customPool.paused = true;
+    {
+        ThreadPool::LaneScope lane(TaskLane_IBL);
+        customPool.pushTask(record('I', TaskLane_IBL));
+    }
+    {
+        ThreadPool::LaneScope lane(TaskLane_Loading);
+        customPool.pushTask(record('L', TaskLane_Loading));
+        customPool.pushTask(record('L', TaskLane_Loading));
+    }
+    ASSERT_EQ(ThreadPool::currentLane(), TaskLane_Frame);
+    customPool.pushTask(record('F', TaskLane_Frame));
+    customPool.paused = false;
+    customPool.waitTasksFinish();
+
+    ASSERT_EQ(order, (std::vector<char>{'F', 'L', 'L', 'I'}));
+}
+
+// 测试后台任务不会占满所有工作线程，帧任务总能执行
+TEST_F(ThreadPoolTest, BackgroundLeavesWorkerForFrame) {
+    ThreadPool customPool(4);
+    std::atomic<bool> release{false};
+    std::atomic<int> running{0};
+    std::atomic<int> maxRunning{0};
+    {
+        ThreadPool::LaneScope lane(TaskLane_Loading);
+        for (int i = 0; i < 8; ++i) {
+            customPool.pushTask([&](size_t) {
+                int cnt = ++running;
+                int prev = maxRunning;
+                while (cnt > prev && !maxRunning.compare_exchange_weak(prev, cnt)) {
+                }
+                while (!release) {
+                    std::this_thread::yield();
+                }
+                running--;
+            });
+        }
+    }
+
+    std::atomic<int> counter{0};
+    customPool.parallelFor(0, 100, 0, [&](size_t begin, size_t end, size_t) { counter += (int)(end - begin); });
+    ASSERT_EQ(counter, 100);
+
+    release = true;
+    customPool.waitTasksFinish();
+    ASSERT_LE(maxRunning, 3);
+}
+
+// 测试暂停期间工作线程休眠而不是轮询，恢复后被唤醒执行任务
+TEST_F(ThreadPoolTest, PausedWorkersPark) {
+    ThreadPool customPool(4);
+    std::atomic<bool> taskRan{false};
+    customPool.paused = true;
+    customPool.pushTask([&](size_t) { taskRan = true; });
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (customPool.getParkedCnt() < customPool.getThreadCnt() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_EQ(customPool.getParkedCnt(), customPool.getThreadCnt());
+    ASSERT_FALSE(taskRan);
+
+    customPool.paused = false;
+    customPool.waitTasksFinish();
+    ASSERT_TRUE(taskRan);
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
-}
\ No newline at end of file
+}
+
+// 测试任务组只等待自己提交的任务，不等待其它客户端仍在运行的任务
+TEST_F(ThreadPoolTest, TaskGroupIgnoresOtherClients) {
+    ThreadPool customPool(4);
+    std::atomic<bool> release{false};
+    std::atomic<bool> otherRunning{false};
+    customPool.pushTask([&](size_t) {
+        otherRunning = true;
+        while (!release) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+    while (!otherRunning) {
+        std::this_thread::yield();
+    }
+
+    std::atomic<int> counter{0};
+    std::atomic<bool> nestedJoined{false};
+    {
+        ThreadPool::TaskGroup group(customPool);
+        group.pushTask([&](size_t) {
+            // 工作线程内的任务组同样只等待自己的子任务
+            ThreadPool::TaskGroup nested(customPool);
+            for (int i = 0; i < 16; ++i) {
+                nested.pushTask([&](size_t) { counter++; });
+            }
+            nested.wait();
+            nestedJoined = counter == 16;
+        });
+        group.wait();
+    }
+    ASSERT_TRUE(nestedJoined);
+    ASSERT_FALSE(release);
+
+    release = true;
+    customPool.waitTasksFinish();
+    ASSERT_EQ(counter, 16);
+}